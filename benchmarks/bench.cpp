@@ -0,0 +1,697 @@
+#include <CNum.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <map>
+#include <cmath>
+#include <numeric>
+
+using namespace CNum::DataStructs;
+using namespace CNum::Data;
+
+/**
+ * @struct Benchmark
+ * @brief A named benchmark
+ *
+ * run performs the work once and returns the number of items it processed (cells,
+ * rows...), the harness reports the best throughput over a few repetitions and the
+ * detail (e.g. the accuracy reached) if there is one
+ */
+struct Benchmark {
+  ::std::string name;
+  ::std::string unit;
+  ::std::function<size_t()> run;
+  ::std::function<::std::string()> detail{};
+};
+
+/// @brief Keeps the optimizer from throwing away benchmark results
+static volatile size_t sink;
+
+// -------------
+// Fixtures
+// -------------
+
+constexpr size_t bench_rows = 1 << 20;
+constexpr size_t bench_cols = 16;
+
+static const Matrix<double> &bench_data() {
+  static Matrix<double> data = [] {
+    ::std::mt19937_64 rng(42);
+    ::std::normal_distribution<double> dist(0.0, 1.0);
+
+    auto ptr = ::std::make_unique<double[]>(bench_rows * bench_cols);
+    ::std::generate(ptr.get(), ptr.get() + bench_rows * bench_cols, [&] { return dist(rng); });
+
+    return Matrix<double>(bench_rows, bench_cols, ::std::move(ptr));
+  }();
+
+  return data;
+}
+
+static ::std::shared_ptr<Shelf[]> bench_shelves() {
+  static ::std::shared_ptr<Shelf[]> shelves = quantile_bin(bench_data(), 256);
+  return shelves;
+}
+
+// -------------
+// Bucketize
+// -------------
+
+/// @brief The linear scan apply_quantile used before the Bucketizer
+static size_t bucketize_linear_ref() {
+  const double *col = bench_data().begin();
+  const double *ranges = bench_shelves()[0].ranges.get();
+  constexpr size_t n_bounds = 255;
+  size_t acc{ 0 };
+
+  for (size_t i = 0; i < bench_rows; i++) {
+    double val = col[i * bench_cols];
+    size_t b = n_bounds;
+    for (size_t k = 0; k < n_bounds; k++) {
+      if (val < ranges[k]) {
+	b = k;
+	break;
+      }
+    }
+
+    acc += b;
+  }
+
+  sink = acc;
+  return bench_rows;
+}
+
+static size_t bucketize_scalar() {
+  const double *col = bench_data().begin();
+  Bucketizer bucketizer(bench_shelves()[0].ranges.get(), 255);
+  size_t acc{ 0 };
+
+  for (size_t i = 0; i < bench_rows; i++)
+    acc += bucketizer.bucketize(col[i * bench_cols]);
+
+  sink = acc;
+  return bench_rows;
+}
+
+static size_t bucketize_batch() {
+  static auto out = ::std::make_unique<uint8_t[]>(bench_rows);
+  Bucketizer bucketizer(bench_shelves()[0].ranges.get(), 255);
+
+  bucketizer.bucketize(bench_data().begin(), bench_rows, bench_cols, out.get(), 1);
+
+  sink = out[bench_rows - 1];
+  return bench_rows;
+}
+
+static size_t apply_quantile_full() {
+  auto binned = apply_quantile(bench_data(), bench_shelves());
+
+  sink = binned.get(0, 0);
+  return bench_rows * bench_cols;
+}
+
+// -------------
+// Binning
+// -------------
+
+static size_t quantile_bin_full() {
+  auto shelves = quantile_bin(bench_data(), 256);
+
+  sink = shelves[0].num_bins;
+  return bench_rows * bench_cols;
+}
+
+// -------------
+// Histograms
+// -------------
+
+/**
+ * @struct HistFixture
+ * @brief Random feature-major bins, gradients, and hessians of one shape
+ */
+struct HistFixture {
+  Matrix<uint8_t> bins;
+  ::std::shared_ptr<Shelf[]> shelves;
+  ::std::vector<GradientPair> gh;
+  ::std::vector<size_t> hist_bins;
+};
+
+static const HistFixture &hist_fixture(size_t rows, size_t cols) {
+  static ::std::map< ::std::pair<size_t, size_t>, HistFixture > fixtures;
+  auto it = fixtures.find({ rows, cols });
+  if (it != fixtures.end())
+    return it->second;
+
+  ::std::mt19937_64 rng(rows * 31 + cols);
+  ::std::uniform_int_distribution<int> bin_dist(0, 255);
+  ::std::normal_distribution<double> dist(0.0, 1.0);
+
+  HistFixture f;
+  auto ptr = ::std::make_unique<uint8_t[]>(rows * cols);
+  ::std::generate(ptr.get(), ptr.get() + rows * cols, [&] { return static_cast<uint8_t>(bin_dist(rng)); });
+  f.bins = Matrix<uint8_t>(cols, rows, ::std::move(ptr));
+
+  f.shelves = ::std::shared_ptr<Shelf[]>(new Shelf[cols]);
+  for (size_t i = 0; i < cols; i++) {
+    f.shelves[i] = Shelf(256);
+    ::std::iota(f.shelves[i].ranges.get(), f.shelves[i].ranges.get() + 255, 1.0);
+  }
+
+  f.gh.resize(rows);
+  ::std::generate(f.gh.begin(), f.gh.end(), [&] { return GradientPair{ dist(rng), 1.0 }; });
+  f.hist_bins.assign(cols, 256);
+
+  return fixtures.emplace(::std::make_pair(rows, cols), ::std::move(f)).first->second;
+}
+
+/// @brief Build and scan the root histograms of a shape
+template <size_t Rows, size_t Cols>
+static size_t hist_root() {
+  using namespace CNum::Model::Tree;
+  static arena_t *arena = arena_init(CNum::Multithreading::default_arena_init_block_ct);
+  const HistFixture &f = hist_fixture(Rows, Cols);
+
+  XGTreeBooster tree(arena);
+  arena_view_t idx = arena_malloc(arena, sizeof(size_t) * Rows, sizeof(size_t));
+  ::std::iota((size_t *) idx.ptr, (size_t *) idx.ptr + Rows, size_t{ 0 });
+
+  // the gradients are partitioned with the indeces so each run gets its own copy
+  arena_view_t gh = arena_malloc(arena, sizeof(GradientPair) * Rows, sizeof(GradientPair));
+  ::std::copy(f.gh.begin(), f.gh.end(), (GradientPair *) gh.ptr);
+
+  DataPartition partition{ &idx, 0, Rows };
+  arena_view_t hist_view = tree.init_hist_view(f.hist_bins);
+  Split s = TreeBoosterNode::find_best_split_hist(f.bins, f.shelves, (GradientPair *) gh.ptr,
+						  false, hist_view, partition);
+
+  sink = s.feature;
+  arena_clear(arena);
+  return Rows * Cols;
+}
+
+/// @brief Partition the root of a shape on a split at the middle bin
+template <size_t Rows, bool Parallel>
+static size_t partition_root() {
+  using namespace CNum::Model::Tree;
+  static arena_t *arena = arena_init(CNum::Multithreading::default_arena_init_block_ct);
+  const HistFixture &f = hist_fixture(Rows, 8);
+
+  arena_view_t idx = arena_malloc(arena, sizeof(size_t) * Rows, sizeof(size_t));
+  ::std::iota((size_t *) idx.ptr, (size_t *) idx.ptr + Rows, size_t{ 0 });
+  arena_view_t gh = arena_malloc(arena, sizeof(GradientPair) * Rows, sizeof(GradientPair));
+  ::std::copy(f.gh.begin(), f.gh.end(), (GradientPair *) gh.ptr);
+
+  DataPartition partition{ &idx, 0, Rows };
+  Split split{ 0, 128.0, 0.0, 127, { 0.0, 0.0 }, false };
+  sink = XGTreeBooster::partition_data(f.bins, (GradientPair *) gh.ptr, split, f.shelves[0], partition, nullptr, Parallel);
+
+  arena_clear(arena);
+  return Rows;
+}
+
+/// @brief Fit a tree on a subsample (in percent) of 4M rows, either indexing the whole
+/// bins or gathering the subsample into a compact block first (included in the time)
+template <int Percent, bool Compact>
+static size_t subsample_tree() {
+  using namespace CNum::Model::Tree;
+  constexpr size_t rows = 1 << 22;
+  static arena_t *arena = arena_init(CNum::Multithreading::default_arena_init_block_ct);
+  const HistFixture &f = hist_fixture(rows, 8);
+
+  // the same sorted sample for both layouts
+  static ::std::map< int, ::std::vector<size_t> > samples;
+  auto &sample = samples[Percent];
+  if (sample.empty()) {
+    sample.resize(rows);
+    ::std::iota(sample.begin(), sample.end(), size_t{ 0 });
+    ::std::shuffle(sample.begin(), sample.end(), ::std::mt19937_64(Percent));
+    sample.resize(rows * Percent / 100);
+    ::std::sort(sample.begin(), sample.end());
+  }
+
+  size_t n = sample.size();
+  arena_view_t idx = arena_malloc(arena, sizeof(size_t) * n, sizeof(size_t));
+  arena_view_t gh = arena_malloc(arena, sizeof(GradientPair) * n, sizeof(GradientPair));
+  for (size_t k = 0; k < n; k++)
+    ((GradientPair *) gh.ptr)[k] = f.gh[sample[k]];
+
+  Matrix<uint8_t> compact;
+  if (Compact) {
+    gather_bins(f.bins, sample.data(), n, compact);
+    ::std::iota((size_t *) idx.ptr, (size_t *) idx.ptr + n, size_t{ 0 });
+  } else {
+    ::std::copy(sample.begin(), sample.end(), (size_t *) idx.ptr);
+  }
+
+  DataPartition partition{ &idx, 0, n };
+  {
+    XGTreeBooster tree(arena, 6);
+    tree.fit(Compact ? DataMatrix(static_cast<const Matrix<uint8_t> *>(&compact)) : DataMatrix(&f.bins),
+	     f.shelves, (GradientPair *) gh.ptr, partition);
+  }
+
+  arena_clear(arena);
+  return n;
+}
+
+/**
+ * @struct UpdateFixture
+ * @brief A deep tree fit on every row of 1M raw rows, with the partition it left
+ */
+struct UpdateFixture {
+  Matrix<double> X;
+  Matrix<uint8_t> bins;
+  ::std::shared_ptr<Shelf[]> shelves;
+  ::std::vector<size_t> positions;
+  CNum::Model::Tree::XGTreeBooster tree;
+};
+
+static UpdateFixture &update_fixture() {
+  using namespace CNum::Model::Tree;
+  constexpr size_t rows = 1 << 20;
+  constexpr size_t cols = 8;
+  static arena_t *arena = arena_init(CNum::Multithreading::default_arena_init_block_ct);
+  static UpdateFixture f;
+  if (!f.positions.empty())
+    return f;
+
+  ::std::mt19937_64 rng(5);
+  ::std::normal_distribution<double> dist(0.0, 1.0);
+  auto x = ::std::make_unique<double[]>(rows * cols);
+  ::std::generate(x.get(), x.get() + rows * cols, [&] { return dist(rng); });
+
+  ::std::vector<GradientPair> gh(rows);
+  for (size_t i = 0; i < rows; i++)
+    gh[i] = { -(::std::sin(x[i * cols] * 2.0) + x[i * cols + 1] * x[i * cols + 2]), 1.0 };
+
+  f.X = Matrix<double>(rows, cols, ::std::move(x));
+  f.shelves = quantile_bin(f.X, 256);
+  f.bins = apply_quantile(f.X, f.shelves, true);
+  f.positions.resize(rows);
+  ::std::iota(f.positions.begin(), f.positions.end(), size_t{ 0 });
+
+  arena_view_t idx{ f.positions.data(), rows, sizeof(size_t) };
+  DataPartition partition{ &idx, 0, rows };
+  f.tree = XGTreeBooster(arena, 10);
+  f.tree.fit(DataMatrix(&f.bins), f.shelves, gh.data(), partition);
+
+  return f;
+}
+
+/// @brief Add a tree's predictions on its training rows to running predictions, by
+/// traversing the raw rows (Traverse), reading the leaf each row was partitioned into
+/// (LeafValues), or traversing the bins
+template <bool Traverse, bool LeafValues>
+static size_t update_predictions() {
+  UpdateFixture &f = update_fixture();
+  size_t rows = f.positions.size();
+  static auto fm = Matrix<double>::init_const(rows, 1, 0.0);
+  static ::std::vector<double> preds(rows);
+
+  if (Traverse) {
+    fm = fm + (f.tree.predict(f.X) * 0.1);
+  } else {
+    if (LeafValues)
+      f.tree.leaf_values(preds.data());
+    else
+      f.tree.predict_bins(CNum::Model::Tree::DataMatrix(&f.bins), f.shelves, f.positions.data(), rows, preds.data());
+
+    double *fm_ptr = fm.begin();
+    for (size_t k = 0; k < rows; k++)
+      fm_ptr[f.positions[k]] += preds[k] * 0.1;
+  }
+
+  return rows;
+}
+
+/// @brief The log loss gradients and hessians of 1M rows, with the profile's batch
+/// kernel (Batch) or its gradient and hessian functions one row at a time
+template <bool Batch>
+static size_t loss_gradients() {
+  constexpr size_t rows = 1 << 20;
+  static Matrix<double> y, y_pred;
+  static ::std::vector<size_t> positions;
+  static ::std::vector<GradientPair> gh(rows);
+  if (positions.empty()) {
+    ::std::mt19937_64 rng(6);
+    ::std::normal_distribution<double> dist(0.0, 2.0);
+    auto p = ::std::make_unique<double[]>(rows);
+    auto t = ::std::make_unique<double[]>(rows);
+    for (size_t i = 0; i < rows; i++) {
+      p[i] = dist(rng);
+      t[i] = p[i] + dist(rng) > 0.0 ? 1.0 : 0.0;
+    }
+
+    y = Matrix<double>(rows, 1, ::std::move(t));
+    y_pred = Matrix<double>(rows, 1, ::std::move(p));
+    positions.resize(rows);
+    ::std::iota(positions.begin(), positions.end(), size_t{ 0 });
+  }
+
+  auto profile = CNum::Model::Loss::get_loss_profile("BCE");
+  if (!Batch)
+    profile.gh_kernel = nullptr;
+
+  arena_view_t gh_view{ gh.data(), rows, sizeof(GradientPair) };
+  arena_view_t idx{ positions.data(), rows, sizeof(size_t) };
+  CNum::Model::Loss::get_gradients_hessians(y, y_pred, gh_view, idx, profile);
+
+  sink = sink + static_cast<size_t>(gh[rows / 2].h * 1000);
+  return rows;
+}
+
+/// @brief Random histograms with a missing value bin, shared by the scan benchmarks
+static const ::std::vector<CNum::Model::Tree::GradientPair> &scan_fixture(size_t n_bins) {
+  static ::std::map< size_t, ::std::vector<CNum::Model::Tree::GradientPair> > fixtures;
+  auto it = fixtures.find(n_bins);
+  if (it != fixtures.end())
+    return it->second;
+
+  ::std::mt19937_64 rng(n_bins);
+  ::std::normal_distribution<double> dist(0.0, 1.0);
+  ::std::vector<CNum::Model::Tree::GradientPair> bins(n_bins * 64);
+  ::std::generate(bins.begin(), bins.end(), [&] { return CNum::Model::Tree::GradientPair{ dist(rng), 1.0 }; });
+
+  return fixtures.emplace(n_bins, ::std::move(bins)).first->second;
+}
+
+/// @brief Scan 64 histograms of a size for their best threshold
+template <size_t NBins, bool Vectorized>
+static size_t scan_hist() {
+  using namespace CNum::Model::Tree;
+  const auto &bins = scan_fixture(NBins);
+  GradientPair missing{ 1.0, 8.0 };
+
+  for (size_t i = 0; i < 64; i++) {
+    const GradientPair *hist = bins.data() + i * NBins;
+    GradientPair sums{ missing.g, missing.h + NBins };
+    auto scan = Vectorized ? scan_bins : scan_bins_reference;
+
+    sink = scan(hist, NBins, sums, &missing, 1.0, 1.0, 0.0).bin;
+  }
+
+  return NBins * 64;
+}
+
+// -------------
+// Training
+// -------------
+
+constexpr size_t train_rows = 1 << 16;
+constexpr size_t train_cols = 8;
+
+/// @brief A smooth regression target with a sharp step so the bin resolution matters
+static double train_target(const double *row) {
+  return ::std::sin(row[0] * 2.0) + row[1] * row[2] + (row[3] > 0.3 ? 1.0 : 0.0);
+}
+
+static ::std::pair< Matrix<double>, Matrix<double> > train_data(uint64_t seed) {
+  ::std::mt19937_64 rng(seed);
+  ::std::normal_distribution<double> dist(0.0, 1.0);
+
+  auto x = ::std::make_unique<double[]>(train_rows * train_cols);
+  auto y = ::std::make_unique<double[]>(train_rows);
+  ::std::generate(x.get(), x.get() + train_rows * train_cols, [&] { return dist(rng); });
+  for (size_t i = 0; i < train_rows; i++)
+    y[i] = train_target(x.get() + i * train_cols) + dist(rng) * 0.1;
+
+  return { Matrix<double>(train_rows, train_cols, ::std::move(x)), Matrix<double>(train_rows, 1, ::std::move(y)) };
+}
+
+/// @brief The held-out MSE of the last model trained at each resolution
+static ::std::map<size_t, double> resolution_mse;
+
+/// @brief The held-out MSE of the last model trained at each gradient quantization level
+static ::std::map<int, double> quantized_mse;
+
+/// @brief Fit a model and get its MSE on held-out data
+static double held_out_mse(CNum::Model::Tree::GBModel<CNum::Model::Tree::XGTreeBooster> &model) {
+  static auto train = train_data(1);
+  static auto test = train_data(2);
+
+  model.fit(train.first, train.second, false);
+
+  auto preds = model.predict(test.first);
+  double se{ 0.0 };
+  for (size_t i = 0; i < train_rows; i++)
+    se += (preds[i] - test.second[i]) * (preds[i] - test.second[i]);
+
+  return se / train_rows;
+}
+
+/// @brief Train at a bin resolution and score on held-out data
+template <size_t NumBins>
+static size_t train_resolution() {
+  CNum::Model::Tree::GBModel<CNum::Model::Tree::XGTreeBooster> model("MSE", 50, 0.1, 0.5, 6);
+  model.set_num_bins(NumBins);
+
+  resolution_mse[NumBins] = held_out_mse(model);
+  return train_rows;
+}
+
+template <size_t NumBins>
+static ::std::string resolution_detail() {
+  return "held-out mse " + ::std::to_string(resolution_mse[NumBins]);
+}
+
+/// @brief Train on quantized gradients (0 levels is the double baseline) and score
+/// on held-out data
+template <int Levels>
+static size_t train_quantized() {
+  CNum::Model::Tree::GBModel<CNum::Model::Tree::XGTreeBooster> model("MSE", 50, 0.1, 0.5, 6);
+  model.set_quantized_gradients(Levels);
+
+  quantized_mse[Levels] = held_out_mse(model);
+  return train_rows;
+}
+
+template <int Levels>
+static ::std::string quantized_detail() {
+  return "held-out mse " + ::std::to_string(quantized_mse[Levels]);
+}
+
+/// @brief The held-out MSE of the last model trained at each depth
+static ::std::map<int, double> depth_mse;
+
+/// @brief Train deep trees (where the subtrees are built as tasks) and score on
+/// held-out data
+template <int Depth>
+static size_t train_depth() {
+  CNum::Model::Tree::GBModel<CNum::Model::Tree::XGTreeBooster> model("MSE", 20, 0.1, 1.0, Depth);
+
+  depth_mse[Depth] = held_out_mse(model);
+  return train_rows;
+}
+
+template <int Depth>
+static ::std::string depth_detail() {
+  return "held-out mse " + ::std::to_string(depth_mse[Depth]);
+}
+
+/// @brief The held-out MSE of the last level-wise model trained at each depth
+static ::std::map<int, double> level_wise_mse;
+
+/// @brief Train deep trees level by level and score on held-out data
+template <int Depth>
+static size_t train_level_wise() {
+  CNum::Model::Tree::GBModel<CNum::Model::Tree::XGTreeBooster> model("MSE", 20, 0.1, 1.0, Depth);
+  model.set_grow_policy(CNum::Model::Tree::LEVEL_WISE);
+
+  level_wise_mse[Depth] = held_out_mse(model);
+  return train_rows;
+}
+
+template <int Depth>
+static ::std::string level_wise_detail() {
+  return "held-out mse " + ::std::to_string(level_wise_mse[Depth]);
+}
+
+/// @brief The held-out MSE of the last model trained with each GOSS top rate (in
+/// percent, 0 is uniform subsampling)
+static ::std::map<int, double> goss_mse;
+
+/// @brief Train on GOSS samples (the top rate plus 10% of the rest) or on uniform
+/// subsamples of the same size, and score on held-out data
+template <int TopPercent>
+static size_t train_goss() {
+  CNum::Model::Tree::GBModel<CNum::Model::Tree::XGTreeBooster> model("MSE", 50, 0.1, 0.3, 6);
+  if (TopPercent > 0)
+    model.set_goss(TopPercent / 100.0, 0.1);
+
+  goss_mse[TopPercent] = held_out_mse(model);
+  return train_rows;
+}
+
+template <int TopPercent>
+static ::std::string goss_detail() {
+  return "held-out mse " + ::std::to_string(goss_mse[TopPercent]);
+}
+
+/// @brief The held-out MSE of the last leaf-wise model trained with each leaf budget
+static ::std::map<int, double> leaf_wise_mse;
+
+/// @brief Train best-first trees with a leaf budget and score on held-out data
+template <int Leaves>
+static size_t train_leaf_wise() {
+  CNum::Model::Tree::GBModel<CNum::Model::Tree::XGTreeBooster> model("MSE", 20, 0.1, 1.0, 14);
+  model.set_grow_policy(CNum::Model::Tree::LEAF_WISE);
+  model.set_max_leaves(Leaves);
+
+  leaf_wise_mse[Leaves] = held_out_mse(model);
+  return train_rows;
+}
+
+template <int Leaves>
+static ::std::string leaf_wise_detail() {
+  return "held-out mse " + ::std::to_string(leaf_wise_mse[Leaves]);
+}
+
+/// @brief The held-out MSE of the last model trained with each per-tree column rate
+static ::std::map<int, double> colsample_mse;
+
+/// @brief Train on a share of the features per tree and score on held-out data
+template <int Percent>
+static size_t train_colsample() {
+  CNum::Model::Tree::GBModel<CNum::Model::Tree::XGTreeBooster> model("MSE", 50, 0.1, 1.0, 6);
+  model.set_colsample(Percent / 100.0);
+
+  colsample_mse[Percent] = held_out_mse(model);
+  return train_rows;
+}
+
+template <int Percent>
+static ::std::string colsample_detail() {
+  return "held-out mse " + ::std::to_string(colsample_mse[Percent]);
+}
+
+/// @brief The held-out MSE and learners kept by the last model trained with and
+/// without early stopping
+static ::std::map<int, ::std::pair<double, int> > early_stopping_result;
+
+/// @brief Train up to 200 deep learners, stopping after Rounds learners without a
+/// held-out improvement (0 to train every learner)
+template <int Rounds>
+static size_t train_early_stopping() {
+  static auto train = train_data(1);
+  static auto test = train_data(2);
+  CNum::Model::Tree::GBModel<CNum::Model::Tree::XGTreeBooster> model("MSE", 200, 0.3, 1.0, 10);
+
+  if (Rounds > 0)
+    model.fit(train.first, train.second, test.first, test.second, Rounds, false);
+  else
+    model.fit(train.first, train.second, false);
+
+  auto preds = model.predict(test.first);
+  double se{ 0.0 };
+  for (size_t i = 0; i < train_rows; i++)
+    se += (preds[i] - test.second[i]) * (preds[i] - test.second[i]);
+
+  early_stopping_result[Rounds] = { se / train_rows, Rounds > 0 ? model.get_best_iteration() + 1 : 200 };
+  return train_rows;
+}
+
+template <int Rounds>
+static ::std::string early_stopping_detail() {
+  auto [mse, learners] = early_stopping_result[Rounds];
+  return "held-out mse " + ::std::to_string(mse) + ", " + ::std::to_string(learners) + " learners";
+}
+
+static ::std::vector<Benchmark> benchmarks{
+  { "bucketize/linear_ref", "cells", bucketize_linear_ref },
+  { "bucketize/scalar", "cells", bucketize_scalar },
+  { "bucketize/batch", "cells", bucketize_batch },
+  { "bucketize/apply_quantile", "cells", apply_quantile_full },
+  { "binning/quantile_bin", "cells", quantile_bin_full },
+  { "hist/rows_4k_cols_8", "cells", hist_root<1 << 12, 8> },
+  { "hist/rows_4k_cols_64", "cells", hist_root<1 << 12, 64> },
+  { "hist/rows_64k_cols_8", "cells", hist_root<1 << 16, 8> },
+  { "hist/rows_64k_cols_64", "cells", hist_root<1 << 16, 64> },
+  { "hist/rows_1m_cols_8", "cells", hist_root<1 << 20, 8> },
+  { "hist/rows_1m_cols_20", "cells", hist_root<1 << 20, 20> },
+  { "partition/rows_64k_serial", "rows", partition_root<1 << 16, false> },
+  { "partition/rows_64k_parallel", "rows", partition_root<1 << 16, true> },
+  { "partition/rows_1m_serial", "rows", partition_root<1 << 20, false> },
+  { "partition/rows_1m_parallel", "rows", partition_root<1 << 20, true> },
+  { "subsample/tree_10_gather", "rows", subsample_tree<10, false> },
+  { "subsample/tree_10_compact", "rows", subsample_tree<10, true> },
+  { "subsample/tree_25_gather", "rows", subsample_tree<25, false> },
+  { "subsample/tree_25_compact", "rows", subsample_tree<25, true> },
+  { "subsample/tree_50_gather", "rows", subsample_tree<50, false> },
+  { "subsample/tree_50_compact", "rows", subsample_tree<50, true> },
+  { "update/rows_1m_traverse", "rows", update_predictions<true, false> },
+  { "update/rows_1m_bins", "rows", update_predictions<false, false> },
+  { "update/rows_1m_leaf_values", "rows", update_predictions<false, true> },
+  { "loss/gradients_1m_scalar", "rows", loss_gradients<false> },
+  { "loss/gradients_1m_batch", "rows", loss_gradients<true> },
+  { "scan/reference_bins_256", "bins", scan_hist<256, false> },
+  { "scan/vectorized_bins_256", "bins", scan_hist<256, true> },
+  { "scan/reference_bins_4096", "bins", scan_hist<4096, false> },
+  { "scan/vectorized_bins_4096", "bins", scan_hist<4096, true> },
+  { "train/bins_16", "rows", train_resolution<16>, resolution_detail<16> },
+  { "train/bins_64", "rows", train_resolution<64>, resolution_detail<64> },
+  { "train/bins_256", "rows", train_resolution<256>, resolution_detail<256> },
+  { "train/bins_1024", "rows", train_resolution<1024>, resolution_detail<1024> },
+  { "train/quantized_off", "rows", train_quantized<0>, quantized_detail<0> },
+  { "train/quantized_127", "rows", train_quantized<127>, quantized_detail<127> },
+  { "train/quantized_15", "rows", train_quantized<15>, quantized_detail<15> },
+  { "train/depth_6", "rows", train_depth<6>, depth_detail<6> },
+  { "train/depth_10", "rows", train_depth<10>, depth_detail<10> },
+  { "train/depth_14", "rows", train_depth<14>, depth_detail<14> },
+  { "train/level_wise_depth_6", "rows", train_level_wise<6>, level_wise_detail<6> },
+  { "train/level_wise_depth_10", "rows", train_level_wise<10>, level_wise_detail<10> },
+  { "train/level_wise_depth_14", "rows", train_level_wise<14>, level_wise_detail<14> },
+  { "train/leaf_wise_leaves_63", "rows", train_leaf_wise<63>, leaf_wise_detail<63> },
+  { "train/leaf_wise_leaves_255", "rows", train_leaf_wise<255>, leaf_wise_detail<255> },
+  { "train/leaf_wise_leaves_1023", "rows", train_leaf_wise<1023>, leaf_wise_detail<1023> },
+  { "train/uniform_subsample_30", "rows", train_goss<0>, goss_detail<0> },
+  { "train/goss_20_10", "rows", train_goss<20>, goss_detail<20> },
+  { "train/colsample_100", "rows", train_colsample<100>, colsample_detail<100> },
+  { "train/colsample_50", "rows", train_colsample<50>, colsample_detail<50> },
+  { "train/colsample_25", "rows", train_colsample<25>, colsample_detail<25> },
+  { "train/early_stopping_off", "rows", train_early_stopping<0>, early_stopping_detail<0> },
+  { "train/early_stopping_10", "rows", train_early_stopping<10>, early_stopping_detail<10> }
+};
+
+// -------------
+// Harness
+// -------------
+
+int main(int argc, char **argv) {
+  constexpr int reps = 5;
+  ::std::string filter = argc > 1 ? argv[1] : "";
+
+  for (auto &b: benchmarks) {
+    if (b.name.find(filter) == ::std::string::npos)
+      continue;
+
+    b.run(); // warm up (builds the fixtures)
+
+    double best{ 0.0 };
+    for (int i = 0; i < reps; i++) {
+      auto start = ::std::chrono::steady_clock::now();
+      size_t items = b.run();
+      ::std::chrono::duration<double> elapsed = ::std::chrono::steady_clock::now() - start;
+
+      best = ::std::max(best, items / elapsed.count());
+    }
+
+    ::std::cout << ::std::left << ::std::setw(40) << b.name
+		<< ::std::right << ::std::fixed << ::std::setprecision(2) << ::std::setw(12)
+		<< best / 1e6 << " M" << b.unit << "/s";
+
+    if (b.detail)
+      ::std::cout << "  (" << b.detail() << ")";
+
+    ::std::cout << ::std::endl;
+  }
+
+  CNum::Multithreading::ThreadPool::get_thread_pool()->shutdown();
+  return 0;
+}
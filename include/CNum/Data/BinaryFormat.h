@@ -0,0 +1,41 @@
+#ifndef BINARY_FORMAT_H
+#define BINARY_FORMAT_H
+
+#include "CNum/Data/MappedFile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace CNum::Data {
+  /// @brief The magic number at the beginning of every CNum binary data file
+  constexpr char BINARY_MAGIC[8] = { 'C', 'N', 'U', 'M', 'B', 'I', 'N', '1' };
+
+  /**
+   * @struct BinaryHeader
+   * @brief The header of a CNum binary data file (".cbin")
+   *
+   * The header is followed by the n_rows * n_cols features in row-major order and
+   * then, if has_labels is set, the n_rows labels. All values are native-endian
+   * doubles so a file can be read back with plain memory copies, and the features
+   * and labels of any row range are contiguous, which is what lets the DataReader
+   * stream batches out of the file.
+   */
+  struct BinaryHeader {
+    char magic[8];
+    uint64_t n_rows;
+    uint64_t n_cols;
+    uint64_t has_labels;
+
+    /// @brief Whether or not the magic number is valid
+    bool is_valid() const { return ::std::memcmp(magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0; }
+  };
+
+  /// @brief Read and validate the header of a mapped CNum binary file
+  /// @param file The mapped file
+  /// @param data_path The path of the file (for error messages)
+  /// @return The header
+  BinaryHeader read_binary_header(const MappedFile &file, const ::std::string &data_path);
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef BUCKETIZE_H
+#define BUCKETIZE_H
+
+#include "CNum/Data/Missing.h"
+
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace CNum::Data {
+  /**
+   * @class Bucketizer
+   * @brief Maps values to the bins defined by a sorted list of bin boundaries
+   *
+   * The bin of a value is the number of boundaries less than or equal to it, so bin
+   * k holds the values in [boundaries[k - 1], boundaries[k]). The boundaries are
+   * copied into a table padded with NaN to a power of two so every search takes
+   * exactly log2(table size) branchless steps (8 for 255 boundaries) instead of a
+   * linear scan. Batches of values are searched 8 at a time, with AVX2 gathers on
+   * CPUs that support them. NaN values are put in the missing value bin.
+   */
+  class Bucketizer {
+  private:
+    ::std::unique_ptr<double[]> _table;
+    size_t _table_size;
+    size_t _n_boundaries;
+    size_t _missing_bin;
+
+  public:
+    /// @brief Overloaded constructor
+    /// @param boundaries The sorted bin boundaries
+    /// @param n_boundaries The number of boundaries (the number of bins - 1)
+    /// @param missing_bin The bin NaN values are put in
+    Bucketizer(const double *boundaries, size_t n_boundaries, size_t missing_bin = 0);
+
+    /// @brief Get the bin of a single value
+    /// @param val The value
+    /// @return The bin
+    size_t bucketize(double val) const {
+      size_t idx{ 0 };
+      for (size_t step = _table_size >> 1; step > 0; step >>= 1)
+	idx += _table[idx + step - 1] <= val ? step : 0;
+
+      return is_missing(val) ? _missing_bin : idx;
+    }
+
+    /// @brief Get the bins of a (strided) array of values
+    /// @tparam BinT The integer type the bins are written as
+    /// @param vals The values
+    /// @param n The number of values
+    /// @param in_stride The distance between consecutive values (in elements)
+    /// @param out Where the bins are written
+    /// @param out_stride The distance between consecutive bins (in elements)
+    template <typename BinT>
+    void bucketize(const double *vals,
+		   size_t n,
+		   size_t in_stride,
+		   BinT *out,
+		   size_t out_stride) const;
+
+    /// @brief Get the number of bins
+    /// @return The number of bins
+    size_t get_n_bins() const;
+  };
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include "CNum/DataStructs/DataStructs.h"
+
+#include <vector>
+#include <span>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace CNum::Data {
+  struct Shelf;
+
+  /**
+   * @class BundledBins
+   * @brief Feature-major bins with mutually exclusive features sharing columns
+   * (Exclusive Feature Bundling)
+   *
+   * Sparse features (e.g. one-hot columns) are rarely away from their default bin
+   * (the bin of 0.0) on the same row. Features that never are on the same row are
+   * greedily grouped into a bundle whose column stores a code for the one feature that
+   * is not in its default bin (0 if none are). Each feature of a bundle gets its own
+   * range of codes, one per non-default bin it uses, so a bundle holds at most 256
+   * codes in total.
+   * Features that are dense or do not fit in a bundle get a column of their own with
+   * their bins stored unchanged.
+   *
+   * The tree boosters build one histogram per bundle instead of one per feature and
+   * unbundle each feature's histogram when searching for splits. Bundles never have
+   * conflicting rows, so the splits (and the model) are the same as without bundling.
+   */
+  class BundledBins {
+  private:
+    CNum::DataStructs::Matrix<uint8_t> _bins;
+    ::std::vector<size_t> _bundle_starts;
+    ::std::vector<size_t> _features;
+    ::std::vector<size_t> _bundle_of;
+    ::std::vector<uint16_t> _offset;
+    ::std::vector<size_t> _code_starts;
+    ::std::vector<uint8_t> _codes;
+    ::std::vector<uint8_t> _default_bin;
+    size_t _n_rows{ 0 };
+
+  public:
+    BundledBins() = default;
+
+    /// @brief Overloaded constructor (bundles the features)
+    ///
+    /// If no features can be bundled the bins are not copied and get_bundles()
+    /// equals get_features()
+    /// @param bins The feature-major bins (shape=(features, rows))
+    /// @param shelves The bins and the boundaries associated with them
+    /// @param max_search The number of most recent open bundles a feature is tried
+    /// against (bounds the time and memory spent bundling)
+    BundledBins(const CNum::DataStructs::Matrix<uint8_t> &bins,
+		const Shelf *shelves,
+		size_t max_search = 64);
+
+    /// @brief Get the bin of a feature on a row
+    /// @param feature The feature
+    /// @param row The row
+    /// @return The bin
+    uint8_t get(size_t feature, size_t row) const {
+      int k = static_cast<int>(_bins.begin()[_bundle_of[feature] * _n_rows + row]) - _offset[feature];
+      return k >= 0 && k < static_cast<int>(_code_starts[feature + 1] - _code_starts[feature])
+	? _codes[_code_starts[feature] + k]
+	: _default_bin[feature];
+    }
+
+    /// @brief Get the bundle of a feature
+    size_t get_bundle(size_t feature) const { return _bundle_of[feature]; }
+
+    /// @brief Get the features in a bundle
+    ::std::span<const size_t> get_bundle_features(size_t bundle) const {
+      return { _features.data() + _bundle_starts[bundle], _bundle_starts[bundle + 1] - _bundle_starts[bundle] };
+    }
+
+    /// @brief Get the number of bin values a bundle uses
+    size_t get_bundle_bins(size_t bundle) const {
+      size_t last = _features[_bundle_starts[bundle + 1] - 1];
+      return _offset[last] + _code_starts[last + 1] - _code_starts[last];
+    }
+
+    /// @brief Recover a feature's histogram from its bundle's histogram
+    /// @param feature The feature
+    /// @param bundle_bins The histogram of the bundle
+    /// @param gs The sum of the gradients of the node
+    /// @param hs The sum of the hessians of the node
+    /// @param bins Where the feature's histogram is written
+    /// @param n_bins The size of bins (the bins the feature does not use are 0)
+    void unbundle(size_t feature,
+		  const CNum::DataStructs::GradientPair *bundle_bins,
+		  double gs,
+		  double hs,
+		  CNum::DataStructs::GradientPair *bins,
+		  size_t n_bins) const;
+
+    /// @brief Get the bundled bins
+    /// @return The bins (bundle-major, shape=(bundles, rows))
+    const CNum::DataStructs::Matrix<uint8_t> &get_bins() const;
+
+    /// @brief Get the number of features
+    size_t get_features() const;
+
+    /// @brief Get the number of bundles
+    size_t get_bundles() const;
+
+    /// @brief Get the number of rows
+    size_t get_rows() const;
+  };
+};
+
+#endif
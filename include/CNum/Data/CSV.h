@@ -0,0 +1,101 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdexcept>
+
+namespace CNum::Data {
+  /**
+   * @struct CSVOptions
+   * @brief Options used when parsing delimiter separated (_SV) files
+   *
+   * Quoted fields are not supported, every separator character is treated as a
+   * column boundary.
+   */
+  struct CSVOptions {
+    /// @brief The delimiter of the columns
+    char separator = ',';
+
+    /// @brief The number of lines to skip at the beginning of the file
+    size_t header_rows = 0;
+
+    /// @brief Whether or not the file contains a label column
+    bool has_labels = true;
+
+    /// @brief The index of the label column
+    ///
+    /// Negative values index from the end of a row (-1 is the last column)
+    long label_col = -1;
+
+    /// @brief Fields that are parsed as missing values (NaN)
+    ::std::vector< ::std::string > nan_tokens = { "", "NaN", "nan", "NA", "null" };
+
+    /// @brief The approximate number of bytes parsed by a single thread pool task
+    size_t chunk_bytes = 1 << 22;
+  };
+
+  /// @brief Get a pointer to the beginning of the next line
+  /// @param ptr A pointer into the current line
+  /// @param end The end of the buffer
+  /// @return The pointer to the character after the next newline (or end)
+  const char *csv_next_line(const char *ptr, const char *end);
+
+  /// @brief Whether or not a line only contains whitespace
+  /// @param begin The beginning of the line
+  /// @param end The end of the line (exclusive of the newline)
+  /// @return Whether or not the line is blank
+  bool csv_line_is_blank(const char *begin, const char *end);
+
+  /// @brief Skip header lines
+  /// @param begin The beginning of the buffer
+  /// @param end The end of the buffer
+  /// @param n_lines The number of lines to skip
+  /// @return The pointer to the first line after the skipped lines
+  const char *csv_skip_lines(const char *begin, const char *end, size_t n_lines);
+
+  /// @brief Count the number of columns of a file from its first non-blank line
+  /// @param begin The beginning of the data (after any header rows)
+  /// @param end The end of the buffer
+  /// @param separator The delimiter of the columns
+  /// @return The number of columns (0 if there are no rows)
+  size_t csv_count_cols(const char *begin, const char *end, char separator);
+
+  /// @brief Resolve the label column of a file with n_cols columns
+  /// @param options The parsing options
+  /// @param n_cols The number of columns in the file
+  /// @return The index of the label column (n_cols if the file has no labels)
+  size_t csv_label_idx(const CSVOptions &options, size_t n_cols);
+
+  /// @brief Count the non-blank lines in a buffer
+  /// @param begin The beginning of the buffer (must be the beginning of a line)
+  /// @param end The end of the buffer
+  /// @return The number of rows
+  size_t csv_count_rows(const char *begin, const char *end);
+
+  /// @brief Parse a single field as a double
+  /// @param begin The beginning of the field
+  /// @param end The end of the field
+  /// @param options The parsing options (used for the NaN tokens)
+  /// @return The parsed value
+  double csv_parse_field(const char *begin, const char *end, const CSVOptions &options);
+
+  /// @brief Parse a single line directly into the feature and label buffers
+  /// @param begin The beginning of the line
+  /// @param end The end of the line (exclusive of the newline)
+  /// @param n_cols The number of columns in the file
+  /// @param label_idx The index of the label column (see csv_label_idx)
+  /// @param options The parsing options
+  /// @param x_out Where the n_cols - 1 (or n_cols without labels) features are written
+  /// @param y_out Where the label is written (unused if the file has no labels)
+  void csv_parse_row(const char *begin,
+		     const char *end,
+		     size_t n_cols,
+		     size_t label_idx,
+		     const CSVOptions &options,
+		     double *x_out,
+		     double *y_out);
+};
+
+#endif
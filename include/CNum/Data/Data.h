@@ -2,12 +2,23 @@
 #define DATA_H
 
 #include "CNum/DataStructs/DataStructs.h"
+#include "CNum/Data/CSV.h"
+#include "CNum/Data/MappedFile.h"
+#include "CNum/Data/BinaryFormat.h"
+#include "CNum/Data/DataReader.h"
+#include "CNum/Data/Missing.h"
+#include "CNum/Data/Bucketize.h"
+#include "CNum/Data/QuantileSketch.h"
+#include "CNum/Data/Bundle.h"
+#include "CNum/Data/Dataset.h"
 
 #include <string>
 #include <memory>
 #include <fstream>
 #include <sstream>
 #include <array>
+#include <vector>
+#include <algorithm>
 
 /**
  * @namespace CNum::Data
@@ -27,23 +38,59 @@ namespace CNum::Data {
   /**
    * @struct Shelf
    * @brief Contains bins and the ranges of values they represent
+   *
+   * If the feature has missing (NaN) values the last bin is reserved for them and
+   * only the first num_bins - 2 ranges are used as boundaries.
+   *
+   * A categorical shelf is a category-to-bin dictionary instead: ranges holds the
+   * (sorted) category of each of the first num_bins - 1 bins and the last bin holds
+   * missing values and categories that were not seen (or too rare) when binning
    */
   struct Shelf {
     size_t num_bins;
+    bool has_missing;
+    bool is_categorical;
     std::unique_ptr<Bin[]> bins;
     std::unique_ptr<double[]> ranges;
 
-    Shelf() : num_bins(0) {}
+    Shelf() : num_bins(0), has_missing(false), is_categorical(false) {}
     Shelf(size_t nb)
       : num_bins(nb),
+	has_missing(false),
+	is_categorical(false),
 	bins(std::make_unique<Bin[]>(nb)),
 	ranges(std::make_unique<double[]>(nb - 1)) {}
+    Shelf(Shelf &&other) = default;
+
+    /// @brief Get the bin missing values are put in
+    /// @return The missing value bin (-1 if the feature has no missing values)
+    int missing_bin() const { return has_missing ? static_cast<int>(num_bins) - 1 : -1; }
+
+    /// @brief Get the number of boundaries between the bins of present values
+    size_t num_boundaries() const { return has_missing ? num_bins - 2 : num_bins - 1; }
+
+    /// @brief Get the bin of a single value (see Bucketizer for batches)
+    /// @param val The value
+    /// @return The bin
+    size_t bin_of(double val) const {
+      if (is_categorical) {
+	const double *it = std::lower_bound(ranges.get(), ranges.get() + num_bins - 1, val);
+	return it != ranges.get() + num_bins - 1 && *it == val ? it - ranges.get() : num_bins - 1;
+      }
+
+      if (is_missing(val))
+	return has_missing ? num_bins - 1 : 0;
+
+      return std::upper_bound(ranges.get(), ranges.get() + num_boundaries(), val) - ranges.get();
+    }
 
     Shelf &operator=(Shelf &&other) {
       if (this == &other)
 	return *this;
     
       num_bins = other.num_bins;
+      has_missing = other.has_missing;
+      is_categorical = other.is_categorical;
 
       bins.reset();
       ranges.reset();
@@ -61,6 +108,34 @@ namespace CNum::Data {
   /// @return The data and labels [data, labels]
   std::array< CNum::DataStructs::Matrix<double>, 2 > get_data(std::string data_path, char seperator = ',');
 
+  /// @brief Parse a _SV file in parallel
+  ///
+  /// The file is memory mapped and split into chunks at newline boundaries. The
+  /// rows in each chunk are counted in parallel, then each chunk is parsed on the
+  /// ThreadPool directly into its slice of the preallocated data and label
+  /// matrices. Fields are parsed as doubles and blank lines are skipped.
+  /// @param data_path The path to the data file
+  /// @param options The parsing options (header rows, label column, NaN tokens...)
+  /// @return The data and labels [data, labels] (labels have 0 rows if the file
+  /// has no label column)
+  std::array< CNum::DataStructs::Matrix<double>, 2 > read_csv(const std::string &data_path, const CSVOptions &options = {});
+
+  /// @brief Write data to a CNum binary file (see BinaryHeader)
+  ///
+  /// Binary files load with plain memory copies and can be streamed with a DataReader
+  /// @param data_path The path of the file to write
+  /// @param X The data
+  /// @param y The labels (a Matrix with 0 rows if there are no labels)
+  void write_binary(const std::string &data_path,
+		    const CNum::DataStructs::Matrix<double> &X,
+		    const CNum::DataStructs::Matrix<double> &y);
+
+  /// @brief Read data from a CNum binary file (see BinaryHeader)
+  /// @param data_path The path to the data file
+  /// @return The data and labels [data, labels] (labels have 0 rows if the file
+  /// has no labels)
+  std::array< CNum::DataStructs::Matrix<double>, 2 > read_binary(const std::string &data_path);
+
   /// @brief Principle component analysis
   ///
   /// Available next release
@@ -74,18 +149,81 @@ namespace CNum::Data {
 
   /// @brief Quantile sketch *not exact quantile bins*
   ///
-  /// As perfect quantile binning is an expensive operation
-  /// I used a quantile binning approximation
+  /// As perfect quantile binning is an expensive operation the boundaries come from
+  /// a mergeable quantile sketch (see QuantileSketch). Chunks of rows are sketched in
+  /// parallel and merged per column. The boundaries are exact for columns with fewer
+  /// than 2048 values.
+  ///
+  /// Categorical features get a category-to-bin dictionary instead (see Shelf) with a
+  /// bin for each of their num_bins - 1 most frequent categories
   /// @param data The dataset
   /// @param num_bins The number of bins to distribute the data among
+  /// @param categorical The indeces of the categorical features (their values must be
+  /// non-negative integers)
   /// @return The bins and the boundaries associated with them
-  std::shared_ptr<Shelf[]> quantile_bin(const CNum::DataStructs::Matrix<double> &data, size_t num_bins = 256);
+  std::shared_ptr<Shelf[]> quantile_bin(const CNum::DataStructs::Matrix<double> &data,
+					size_t num_bins = 256,
+					const std::vector<size_t> &categorical = {});
+
+  /// @brief Quantile sketch of a streamed dataset
+  ///
+  /// Every batch of the reader is sketched and merged, so the dataset never has to fit
+  /// in memory. The reader is rewound afterwards.
+  /// @param reader The reader streaming the dataset
+  /// @param num_bins The number of bins to distribute the data among
+  /// @return The bins and the boundaries associated with them
+  std::shared_ptr<Shelf[]> quantile_bin(DataReader &reader, size_t num_bins = 256);
+
+  /// @brief Quantile sketch of a sparse dataset
+  ///
+  /// Only the stored values are visited, the implicit zeros of each column are
+  /// added to its sketch at once
+  /// @param data The dataset
+  /// @param num_bins The number of bins to distribute the data among
+  /// @return The bins and the boundaries associated with them
+  std::shared_ptr<Shelf[]> quantile_bin(const CNum::DataStructs::SparseMatrix<double> &data, size_t num_bins = 256);
 
   /// @brief Construct data matrix of bin values
+  ///
+  /// Bins are found with a binary search over the boundaries (see Bucketizer) and
+  /// blocks of rows are binned in parallel
+  /// @tparam BinT The type of the bin values, uint8_t (at most 256 bins per shelf) or
+  /// uint16_t (at most 65536 bins per shelf)
   /// @param data The dataset
   /// @param shelves The bins and the boundaries associated with them
+  /// @param feature_major Whether to write the bins feature-major (shape=(cols, rows)),
+  /// the layout the tree models train on
   /// @return The matrix of bin values
-  CNum::DataStructs::Matrix<int> apply_quantile(const CNum::DataStructs::Matrix<double> &data, std::shared_ptr<Shelf[]> shelves);
+  template <typename BinT = uint8_t>
+  CNum::DataStructs::Matrix<BinT> apply_quantile(const CNum::DataStructs::Matrix<double> &data,
+						 std::shared_ptr<Shelf[]> shelves,
+						 bool feature_major = false);
+
+  /// @brief Construct sparse matrix of bin values
+  ///
+  /// Only the stored values are binned, implicit zeros stay implicit (their bin is
+  /// Shelf::bin_of(0))
+  /// @param data The dataset
+  /// @param shelves The bins and the boundaries associated with them (at most 256 bins each)
+  /// @return The bins of the stored values (CSR, same structure as data)
+  CNum::DataStructs::SparseMatrix<uint8_t> apply_quantile(const CNum::DataStructs::SparseMatrix<double> &data,
+							  std::shared_ptr<Shelf[]> shelves);
+
+  /// @brief Gather rows of feature-major bins into a contiguous block
+  ///
+  /// Groups of features are gathered in parallel. The rows are read through 32-bit
+  /// indeces when the bins have fewer than 2^32 rows (the row list is read once per
+  /// feature), and sorted rows stream through each feature in order
+  /// @param bins The feature-major bins (shape=(features, rows))
+  /// @param rows The rows to gather
+  /// @param n The number of rows to gather
+  /// @param out Where the rows are written (shape=(features, n)), its storage is
+  /// reused if it already has that shape
+  template <typename BinT>
+  void gather_bins(const CNum::DataStructs::Matrix<BinT> &bins,
+		   const size_t *rows,
+		   size_t n,
+		   CNum::DataStructs::Matrix<BinT> &out);
 };
 
 #endif
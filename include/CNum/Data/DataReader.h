@@ -0,0 +1,150 @@
+#ifndef DATA_READER_H
+#define DATA_READER_H
+
+#include "CNum/DataStructs/DataStructs.h"
+#include "CNum/Data/CSV.h"
+#include "CNum/Data/MappedFile.h"
+#include "CNum/Data/BinaryFormat.h"
+
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace CNum::Data {
+  /**
+   * @enum DataFormat
+   * @brief The format of a data file
+   *
+   * CSV is any delimiter separated file (see CSVOptions), BINARY is the CNum binary
+   * format (see BinaryHeader)
+   */
+  enum DataFormat {
+    CSV,
+    BINARY
+  };
+
+  /**
+   * @class DataReader
+   * @brief Streams a data file in fixed-size row batches
+   *
+   * A background thread reads ahead into a double buffer: while the consumer works
+   * on one batch the next one is being read into the other buffer, so work can start
+   * on the first batch before the file is fully read and files that do not fit in
+   * memory can be processed. Only two batches are ever held in memory.
+   *
+   * The matrices returned by X() and y() are owned by the reader and stay valid
+   * until the next call to next() (every batch has batch_rows rows except possibly
+   * the last one).
+   */
+  class DataReader {
+  private:
+    /**
+     * @struct Slot
+     * @brief One half of the double buffer
+     */
+    struct Slot {
+      ::std::unique_ptr<double[]> X_buf;
+      ::std::unique_ptr<double[]> y_buf;
+      size_t n_rows;
+      size_t first_row;
+      bool ready;
+    };
+
+    ::std::string _path;
+    DataFormat _format;
+    CSVOptions _options;
+    size_t _batch_rows;
+
+    MappedFile _file;
+    const char *_cursor;
+    const char *_data_begin;
+    size_t _n_cols;
+    size_t _x_cols;
+    size_t _label_idx;
+    size_t _n_rows;
+    size_t _rows_read;
+
+    Slot _slots[2];
+    int _current;
+    CNum::DataStructs::Matrix<double> _X;
+    CNum::DataStructs::Matrix<double> _y;
+
+    ::std::thread _producer;
+    ::std::mutex _mtx;
+    ::std::condition_variable _cv;
+    bool _stop;
+    bool _done;
+    ::std::exception_ptr _err;
+
+    /// @brief The read-ahead loop run on the background thread
+    void produce();
+
+    /// @brief Read the next batch of a CSV file into a slot
+    /// @return The number of rows read
+    size_t fill_csv(Slot &slot);
+
+    /// @brief Read the next batch of a binary file into a slot
+    /// @return The number of rows read
+    size_t fill_binary(Slot &slot);
+
+    /// @brief Give the buffers of the current batch back to its slot
+    void release_current();
+
+    /// @brief Start the background thread
+    void start();
+
+    /// @brief Stop and join the background thread
+    void stop();
+
+  public:
+    /// @brief Overloaded constructor
+    /// @param path The path to the data file
+    /// @param batch_rows The number of rows in each batch
+    /// @param format The format of the file
+    /// @param options The parsing options (only used for CSV files; the chunk_bytes option
+    /// is ignored)
+    DataReader(const ::std::string &path,
+	       size_t batch_rows = 65536,
+	       DataFormat format = CSV,
+	       const CSVOptions &options = {});
+
+    DataReader(const DataReader &other) = delete;
+    DataReader &operator=(const DataReader &other) = delete;
+
+    /// @brief Destructor (stops the read-ahead)
+    ~DataReader();
+
+    /// @brief Advance to the next batch
+    ///
+    /// Blocks until the batch has been read. The previous batch is invalidated.
+    /// @return Whether or not there was another batch
+    bool next();
+
+    /// @brief Restart the stream from the first row
+    void rewind();
+
+    /// @brief Get the features of the current batch
+    /// @return The features (shape=(batch rows, n_cols))
+    const CNum::DataStructs::Matrix<double> &X() const;
+
+    /// @brief Get the labels of the current batch
+    /// @return The labels (shape=(batch rows, 1), 0 rows if the file has no labels)
+    const CNum::DataStructs::Matrix<double> &y() const;
+
+    /// @brief Get the index of the first row of the current batch in the file
+    /// @return The row index
+    size_t batch_start() const;
+
+    /// @brief Get the number of features in the file
+    /// @return The number of features
+    size_t get_cols() const;
+
+    /// @brief Whether or not the file has labels
+    bool has_labels() const;
+  };
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include "CNum/DataStructs/DataStructs.h"
+#include "CNum/Data/Bundle.h"
+
+#include <memory>
+#include <vector>
+
+namespace CNum::Data {
+  struct Shelf;
+
+  /**
+   * @class Dataset
+   * @brief A dataset binned once for training
+   *
+   * Owns the raw data, the labels, the shelves (bin boundaries) and the feature-major
+   * matrix of bins the tree models train on (with exclusive features bundled when that
+   * reduces the number of columns, see BundledBins). The shelves and bins are built when the
+   * Dataset is constructed, so training several models on the same Dataset (e.g. a
+   * hyperparameter sweep) only bins the data once. A Dataset is never modified after
+   * construction and can be shared by models training concurrently.
+   */
+  class Dataset {
+  private:
+    CNum::DataStructs::Matrix<double> _X;
+    CNum::DataStructs::Matrix<double> _y;
+    ::std::shared_ptr<Shelf[]> _shelves;
+    CNum::DataStructs::Matrix<uint8_t> _bins;
+    BundledBins _bundled;
+
+  public:
+    /// @brief Overloaded constructor (bins the data)
+    /// @param X The data (moved in to avoid a copy)
+    /// @param y The labels
+    /// @param num_bins The number of bins per feature (at most 256)
+    /// @param categorical The indeces of the categorical features (see quantile_bin)
+    Dataset(CNum::DataStructs::Matrix<double> X,
+	    CNum::DataStructs::Matrix<double> y,
+	    size_t num_bins = 256,
+	    const ::std::vector<size_t> &categorical = {});
+
+    Dataset(const Dataset &other) = delete;
+    Dataset &operator=(const Dataset &other) = delete;
+
+    /// @brief Move constructor
+    Dataset(Dataset &&other) noexcept = default;
+
+    /// @brief Move assignment
+    Dataset &operator=(Dataset &&other) noexcept = default;
+
+    /// @brief Get the raw data
+    /// @return The data (shape=(rows, cols))
+    const CNum::DataStructs::Matrix<double> &X() const;
+
+    /// @brief Get the labels
+    /// @return The labels (shape=(rows, 1))
+    const CNum::DataStructs::Matrix<double> &y() const;
+
+    /// @brief Get the bins and the boundaries associated with them
+    ::std::shared_ptr<Shelf[]> get_shelves() const;
+
+    /// @brief Get the bins of the data
+    /// @return The bins (feature-major, shape=(cols, rows))
+    const CNum::DataStructs::Matrix<uint8_t> &get_bins() const;
+
+    /// @brief Get the bundled bins
+    /// @return The bundled bins (nullptr if no features could be bundled)
+    const BundledBins *get_bundled() const;
+
+    /// @brief Get the number of rows
+    size_t get_rows() const;
+
+    /// @brief Get the number of features
+    size_t get_cols() const;
+  };
+};
+
+#endif
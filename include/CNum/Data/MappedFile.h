@@ -0,0 +1,71 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#include <stdexcept>
+
+namespace CNum::Data {
+  /**
+   * @class MappedFile
+   * @brief A read-only memory mapping of a file
+   *
+   * Used by the data loaders so that large files can be parsed in place without
+   * first being copied into user space buffers. The mapping is released when the
+   * MappedFile is destroyed.
+   */
+  class MappedFile {
+  private:
+    const char *_data;
+    size_t _size;
+
+#ifdef _WIN32
+    void *_file_handle;
+    void *_map_handle;
+#else
+    int _fd;
+#endif
+
+    /// @brief Release the mapping and the underlying file
+    void release() noexcept;
+
+    /// @brief The move logic
+    void move(MappedFile &&other) noexcept;
+
+  public:
+    /// @brief Map a file into memory
+    /// @param path The path to the file
+    explicit MappedFile(const ::std::string &path);
+
+    MappedFile(const MappedFile &other) = delete;
+    MappedFile &operator=(const MappedFile &other) = delete;
+
+    /// @brief Move constructor
+    MappedFile(MappedFile &&other) noexcept;
+
+    /// @brief Move assignment
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    /// @brief Destructor
+    ~MappedFile();
+
+    /// @brief Hint to the OS that the mapping will be read front to back
+    ///
+    /// Enables aggressive read-ahead where the platform supports it
+    void advise_sequential() const noexcept;
+
+    /// @brief Get a pointer to the beginning of the mapped file
+    /// @return Raw pointer (nullptr if the file is empty)
+    const char *begin() const;
+
+    /// @brief Get a pointer to the end of the mapped file
+    /// @return Raw pointer
+    const char *end() const;
+
+    /// @brief Get the size of the mapped file in bytes
+    /// @return The size
+    size_t size() const;
+  };
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef MISSING_H
+#define MISSING_H
+
+#include <bit>
+#include <cstdint>
+
+namespace CNum::Data {
+  /// @brief Bits of a double without the sign
+  constexpr uint64_t abs_mask = 0x7fffffffffffffffULL;
+
+  /// @brief Bits of +inf (every NaN is greater once the sign is cleared)
+  constexpr uint64_t inf_bits = 0x7ff0000000000000ULL;
+
+  /// @brief Whether or not a value is missing (NaN)
+  ///
+  /// Checks the bits instead of comparing the value to itself, so it still works
+  /// when NaN comparisons are optimized away (-ffast-math in the Fast build type)
+  /// @param val The value
+  inline bool is_missing(double val) {
+    return (::std::bit_cast<uint64_t>(val) & abs_mask) > inf_bits;
+  }
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include "CNum/Data/Missing.h"
+#include "XoshiroCpp.hpp"
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace CNum::Data {
+  /**
+   * @class QuantileSketch
+   * @brief A mergeable streaming quantile sketch (KLL)
+   *
+   * Values are kept in a stack of compactors where every value on level h stands for
+   * 2^h of the original values. When the sketch is full the lowest full level is
+   * sorted and every other value (a random half) is promoted to the next level, so
+   * memory stays around 3k values no matter how many values are inserted, and the
+   * rank error of a quantile is roughly 1.7 / k. Sketches built on separate chunks
+   * of a dataset can be merged, which is how columns are sketched in parallel.
+   *
+   * While fewer than k values have been inserted nothing is compacted and the
+   * quantiles are exact. NaN values are ignored.
+   */
+  class QuantileSketch {
+  private:
+    size_t _k;
+    size_t _n;
+    size_t _size;
+    size_t _capacity;
+    ::std::vector< ::std::vector<double> > _levels;
+    ::XoshiroCpp::SplitMix64 _rng;
+
+    /// @brief Get the capacity of a level
+    /// @param level The level
+    /// @return The number of values the level can hold before it is compacted
+    size_t capacity(size_t level) const;
+
+    /// @brief Recompute the total capacity of every level
+    void update_capacity();
+
+    /// @brief Compact levels until the sketch is within its capacity
+    void compress();
+
+  public:
+    /// @brief Overloaded constructor
+    /// @param k The accuracy parameter (the capacity of the top level)
+    /// @param seed The seed of the compaction coin flips (sketches built with the same
+    /// seed on the same values are identical)
+    explicit QuantileSketch(size_t k = 2048, uint64_t seed = 0);
+
+    /// @brief Add a value to the sketch
+    /// @param val The value
+    void insert(double val) {
+      if (is_missing(val))
+	return;
+
+      _levels[0].push_back(val);
+      _n++;
+      _size++;
+
+      if (_size >= _capacity)
+	compress();
+    }
+
+    /// @brief Add a value to the sketch several times
+    ///
+    /// The copies are added in O(log(count)) (e.g. the implicit zeros of a sparse
+    /// column)
+    /// @param val The value
+    /// @param count The number of times to add it
+    void insert(double val, size_t count);
+
+    /// @brief Add a (strided) array of values to the sketch
+    /// @param vals The values
+    /// @param n The number of values
+    /// @param stride The distance between consecutive values (in elements)
+    void insert(const double *vals, size_t n, size_t stride = 1);
+
+    /// @brief Merge another sketch into this one
+    /// @param other The sketch to merge
+    void merge(const QuantileSketch &other);
+
+    /// @brief Get the number of (non NaN) values that have been inserted
+    size_t count() const;
+
+    /// @brief Get the approximate quantiles of the inserted values
+    /// @param qs The quantiles to get (each in [0, 1])
+    /// @return For each q, the smallest value with more than q * count() values at or
+    /// below it (the largest value for q = 1, empty if nothing has been inserted)
+    ::std::vector<double> quantiles(const ::std::vector<double> &qs) const;
+  };
+};
+
+#endif
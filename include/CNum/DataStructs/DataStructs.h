@@ -3,6 +3,7 @@
 
 #include "CNum/DataStructs/DataStructsDefs.h"
 #include "CNum/DataStructs/Matrix/Matrix.h"
+#include "CNum/DataStructs/Matrix/SparseMatrix.h"
 #include "CNum/DataStructs/Matrix/BinaryMask.h"
 #include "CNum/DataStructs/Matrix/IndexMask.h"
 #include "CNum/DataStructs/Views/Views.h"
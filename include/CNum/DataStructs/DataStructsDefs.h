@@ -3,6 +3,8 @@
 
 #include "CNum/DataStructs/Memory/Arena.h"
 
+#include <cstdint>
+
 /**
  * @namespace CNum::DataStructs
  * @brief The data structures used in CNum
@@ -17,6 +19,29 @@ namespace CNum::DataStructs {
   using ::arena_t;
   using ::arena_view_t;
 
+  /**
+   * @struct GradientPair
+   * @brief The gradient and hessian of a sample (or the sums of a histogram bin)
+   *
+   * Stored side by side so one cache line serves both statistics
+   */
+  struct GradientPair {
+    double g;
+    double h;
+  };
+
+  /**
+   * @struct QuantizedPair
+   * @brief A gradient and hessian stochastically rounded to small integers
+   *
+   * The pair approximates (g * g_scale, h * h_scale) for the scales it was quantized
+   * with (see CNum::Model::Loss::quantize_gradients)
+   */
+  struct QuantizedPair {
+    int8_t g;
+    int8_t h;
+  };
+
   /**
    * @namespace CNum::DataStructs::Arena
    * @brief A "mini-heap" used for thread local memory allocation
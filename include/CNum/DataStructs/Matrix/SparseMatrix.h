@@ -0,0 +1,176 @@
+#ifndef SPARSE_MATRIX_H
+#define SPARSE_MATRIX_H
+
+#include "CNum/DataStructs/Matrix/Matrix.h"
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace CNum::DataStructs {
+  /**
+   * @enum SparseFormat
+   * @brief The storage order of a SparseMatrix
+   *
+   * CSR (compressed sparse row) stores the nonzeros row by row, CSC (compressed sparse
+   * column) stores them column by column
+   */
+  enum SparseFormat: uint8_t {
+    CSR,
+    CSC
+  };
+
+  /**
+   * @struct Triplet
+   * @brief A single (row, col, value) entry used to build a SparseMatrix
+   */
+  template <typename T>
+  struct Triplet {
+    size_t row;
+    size_t col;
+    T val;
+  };
+
+  /**
+   * @struct SparseVectorView
+   * @brief A non-owning view of the nonzeros of one row (CSR) or column (CSC)
+   *
+   * idx holds the sorted column (CSR) or row (CSC) indeces of the nonzeros
+   */
+  template <typename T>
+  struct SparseVectorView {
+    const size_t *idx;
+    const T *vals;
+    size_t nnz;
+
+    /// @brief Look up a value (binary search over the nonzeros)
+    /// @param i The index of the value
+    /// @return The value (0 if it is not stored)
+    T get(size_t i) const {
+      const size_t *it = ::std::lower_bound(idx, idx + nnz, i);
+      return it != idx + nnz && *it == i ? vals[it - idx] : T{ 0 };
+    }
+  };
+
+  /**
+   * @class SparseMatrix
+   * @brief 2d array that only stores its nonzero values
+   *
+   * Used for data that is mostly zeros (e.g. one-hot or text-derived features),
+   * which takes a fraction of the memory of a dense Matrix. The nonzeros are stored
+   * in either CSR or CSC order (see SparseFormat) and the indeces within each row
+   * (column) are sorted.
+   * @tparam T The type of the data stored
+   */
+  template <typename T>
+  class SparseMatrix {
+  private:
+    size_t _rows;
+    size_t _cols;
+    SparseFormat _format;
+    ::std::vector<size_t> _outer;
+    ::std::vector<size_t> _inner;
+    ::std::vector<T> _vals;
+
+    /// @brief The number of rows (CSR) or columns (CSC) the nonzeros are grouped by
+    size_t outer_size() const;
+
+  public:
+    /// @brief Default Overloaded Constructor
+    /// @param rows Number of rows in the matrix
+    /// @param cols Number of columns in the matrix
+    /// @param format The storage order
+    SparseMatrix(size_t rows = 0, size_t cols = 0, SparseFormat format = CSR);
+
+    /// @brief Construct from compressed arrays
+    /// @param rows Number of rows in the matrix
+    /// @param cols Number of columns in the matrix
+    /// @param format The storage order
+    /// @param outer The offsets of each row (CSR) or column (CSC) in inner and vals
+    /// (shape=(rows + 1) or (cols + 1))
+    /// @param inner The column (CSR) or row (CSC) index of each nonzero (sorted within
+    /// each row or column)
+    /// @param vals The nonzero values
+    SparseMatrix(size_t rows,
+		 size_t cols,
+		 SparseFormat format,
+		 ::std::vector<size_t> outer,
+		 ::std::vector<size_t> inner,
+		 ::std::vector<T> vals);
+
+    /// @brief Build a matrix from (row, col, value) entries
+    ///
+    /// The entries can be in any order, duplicate entries are summed
+    /// @param rows Number of rows in the matrix
+    /// @param cols Number of columns in the matrix
+    /// @param triplets The entries
+    /// @param format The storage order
+    /// @return The matrix
+    static SparseMatrix<T> from_triplets(size_t rows,
+					 size_t cols,
+					 const ::std::vector< Triplet<T> > &triplets,
+					 SparseFormat format = CSR);
+
+    /// @brief Build a matrix from the nonzeros of a dense Matrix
+    /// @param dense The dense matrix
+    /// @param format The storage order
+    /// @return The matrix
+    static SparseMatrix<T> from_dense(const Matrix<T> &dense, SparseFormat format = CSR);
+
+    /// @brief Convert to a dense Matrix
+    /// @return The dense matrix
+    Matrix<T> to_dense() const;
+
+    /// @brief Get a copy stored in another order
+    /// @param format The storage order
+    /// @return The converted matrix
+    SparseMatrix<T> to_format(SparseFormat format) const;
+
+    /// @brief Sparse matrix - dense matrix product (SpMV when other has one column)
+    /// @param other The dense matrix (shape=(cols, n))
+    /// @return The result (shape=(rows, n))
+    Matrix<T> operator*(const Matrix<T> &other) const;
+
+    /// @brief Get a value (binary search over the row or column)
+    /// @param row The row of the value
+    /// @param col The column of the value
+    /// @return The value (0 if it is not stored)
+    T get(size_t row, size_t col) const;
+
+    /// @brief Get a view of the nonzeros of a row (CSR only)
+    /// @param idx The index of the row
+    /// @return The view
+    SparseVectorView<T> get_row_view(size_t idx) const;
+
+    /// @brief Get a view of the nonzeros of a column (CSC only)
+    /// @param idx The index of the column
+    /// @return The view
+    SparseVectorView<T> get_col_view(size_t idx) const;
+
+    /// @brief Get the number of rows in a matrix
+    size_t get_rows() const;
+
+    /// @brief Get the number of columns in a matrix
+    size_t get_cols() const;
+
+    /// @brief Get the number of stored values
+    size_t get_nnz() const;
+
+    /// @brief Get the storage order
+    SparseFormat get_format() const;
+
+    /// @brief Get the offsets of each row (CSR) or column (CSC)
+    const ::std::vector<size_t> &get_outer() const;
+
+    /// @brief Get the column (CSR) or row (CSC) index of each stored value
+    const ::std::vector<size_t> &get_inner() const;
+
+    /// @brief Get the stored values
+    const ::std::vector<T> &get_vals() const;
+  };
+
+#include "SparseMatrix.tpp"
+};
+
+#endif
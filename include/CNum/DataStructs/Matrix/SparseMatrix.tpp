@@ -0,0 +1,263 @@
+// ------------------------------
+// Constructors
+// ------------------------------
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(size_t rows, size_t cols, SparseFormat format)
+  : _rows(rows),
+    _cols(cols),
+    _format(format),
+    _outer((format == CSR ? rows : cols) + 1, 0) {}
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(size_t rows,
+			      size_t cols,
+			      SparseFormat format,
+			      ::std::vector<size_t> outer,
+			      ::std::vector<size_t> inner,
+			      ::std::vector<T> vals)
+  : _rows(rows),
+    _cols(cols),
+    _format(format),
+    _outer(::std::move(outer)),
+    _inner(::std::move(inner)),
+    _vals(::std::move(vals)) {
+  if (_outer.size() != outer_size() + 1 || _inner.size() != _vals.size() || _outer.back() != _vals.size()) {
+    throw ::std::invalid_argument("Sparse matrix error - compressed arrays do not match the shape");
+  }
+}
+
+template <typename T>
+SparseMatrix<T> SparseMatrix<T>::from_triplets(size_t rows,
+					       size_t cols,
+					       const ::std::vector< Triplet<T> > &triplets,
+					       SparseFormat format) {
+  size_t n_outer = format == CSR ? rows : cols;
+  ::std::vector<size_t> outer(n_outer + 1, 0);
+
+  for (auto &t: triplets) {
+    if (t.row >= rows || t.col >= cols) {
+      throw ::std::out_of_range("Sparse matrix error - triplet out of range");
+    }
+
+    outer[(format == CSR ? t.row : t.col) + 1]++;
+  }
+
+  for (size_t i = 0; i < n_outer; i++)
+    outer[i + 1] += outer[i];
+
+  // counting sort by the outer index
+  ::std::vector<size_t> inner(triplets.size());
+  ::std::vector<T> vals(triplets.size());
+  ::std::vector<size_t> next(outer.begin(), outer.end() - 1);
+
+  for (auto &t: triplets) {
+    size_t pos = next[format == CSR ? t.row : t.col]++;
+    inner[pos] = format == CSR ? t.col : t.row;
+    vals[pos] = t.val;
+  }
+
+  // sort each row (column) by the inner index and sum duplicates
+  ::std::vector<size_t> order;
+  ::std::vector<size_t> row_inner;
+  ::std::vector<T> row_vals;
+  size_t n_kept{ 0 };
+  size_t start = outer[0];
+
+  for (size_t i = 0; i < n_outer; i++) {
+    size_t end = outer[i + 1];
+
+    order.resize(end - start);
+    ::std::iota(order.begin(), order.end(), start);
+    ::std::sort(order.begin(), order.end(), [&] (size_t a, size_t b) { return inner[a] < inner[b]; });
+
+    row_inner.clear();
+    row_vals.clear();
+
+    for (size_t k: order) {
+      if (!row_inner.empty() && row_inner.back() == inner[k]) {
+	row_vals.back() += vals[k];
+	continue;
+      }
+
+      row_inner.push_back(inner[k]);
+      row_vals.push_back(vals[k]);
+    }
+
+    ::std::copy(row_inner.begin(), row_inner.end(), inner.begin() + n_kept);
+    ::std::copy(row_vals.begin(), row_vals.end(), vals.begin() + n_kept);
+
+    start = end;
+    n_kept += row_inner.size();
+    outer[i + 1] = n_kept;
+  }
+
+  inner.resize(n_kept);
+  vals.resize(n_kept);
+
+  return SparseMatrix<T>(rows, cols, format, ::std::move(outer), ::std::move(inner), ::std::move(vals));
+}
+
+template <typename T>
+SparseMatrix<T> SparseMatrix<T>::from_dense(const Matrix<T> &dense, SparseFormat format) {
+  size_t rows = dense.get_rows();
+  size_t cols = dense.get_cols();
+  const T *ptr = dense.begin();
+
+  size_t n_outer = format == CSR ? rows : cols;
+  size_t n_inner = format == CSR ? cols : rows;
+  ::std::vector<size_t> outer(n_outer + 1, 0);
+  ::std::vector<size_t> inner;
+  ::std::vector<T> vals;
+
+  for (size_t i = 0; i < n_outer; i++) {
+    for (size_t j = 0; j < n_inner; j++) {
+      T val = format == CSR ? ptr[i * cols + j] : ptr[j * cols + i];
+      if (val == T{ 0 })
+	continue;
+
+      inner.push_back(j);
+      vals.push_back(val);
+    }
+
+    outer[i + 1] = vals.size();
+  }
+
+  return SparseMatrix<T>(rows, cols, format, ::std::move(outer), ::std::move(inner), ::std::move(vals));
+}
+
+// ------------------
+// Conversions
+// ------------------
+
+template <typename T>
+Matrix<T> SparseMatrix<T>::to_dense() const {
+  auto ptr = ::std::make_unique<T[]>(_rows * _cols);
+
+  for (size_t i = 0; i < outer_size(); i++) {
+    for (size_t k = _outer[i]; k < _outer[i + 1]; k++) {
+      if (_format == CSR)
+	ptr[i * _cols + _inner[k]] = _vals[k];
+      else
+	ptr[_inner[k] * _cols + i] = _vals[k];
+    }
+  }
+
+  return Matrix<T>(_rows, _cols, ::std::move(ptr));
+}
+
+template <typename T>
+SparseMatrix<T> SparseMatrix<T>::to_format(SparseFormat format) const {
+  if (format == _format)
+    return *this;
+
+  // transpose the storage, walking the outer indeces in order keeps the new inner
+  // indeces sorted
+  size_t n_outer = format == CSR ? _rows : _cols;
+  ::std::vector<size_t> outer(n_outer + 1, 0);
+  ::std::vector<size_t> inner(_vals.size());
+  ::std::vector<T> vals(_vals.size());
+
+  for (size_t k = 0; k < _inner.size(); k++)
+    outer[_inner[k] + 1]++;
+
+  for (size_t i = 0; i < n_outer; i++)
+    outer[i + 1] += outer[i];
+
+  ::std::vector<size_t> next(outer.begin(), outer.end() - 1);
+  for (size_t i = 0; i < outer_size(); i++) {
+    for (size_t k = _outer[i]; k < _outer[i + 1]; k++) {
+      size_t pos = next[_inner[k]]++;
+      inner[pos] = i;
+      vals[pos] = _vals[k];
+    }
+  }
+
+  return SparseMatrix<T>(_rows, _cols, format, ::std::move(outer), ::std::move(inner), ::std::move(vals));
+}
+
+// ------------------
+// Operations
+// ------------------
+
+template <typename T>
+Matrix<T> SparseMatrix<T>::operator*(const Matrix<T> &other) const {
+  if (_cols != other.get_rows()) {
+    throw ::std::invalid_argument("Sparse matrix product error - misaligned dims");
+  }
+
+  size_t n = other.get_cols();
+  auto res = ::std::make_unique<T[]>(_rows * n);
+  const T *other_ptr = other.begin();
+
+  for (size_t i = 0; i < outer_size(); i++) {
+    for (size_t k = _outer[i]; k < _outer[i + 1]; k++) {
+      size_t row = _format == CSR ? i : _inner[k];
+      size_t col = _format == CSR ? _inner[k] : i;
+
+      for (size_t j = 0; j < n; j++)
+	res[row * n + j] += _vals[k] * other_ptr[col * n + j];
+    }
+  }
+
+  return Matrix<T>(_rows, n, ::std::move(res));
+}
+
+// ------------------
+// Access
+// ------------------
+
+template <typename T>
+T SparseMatrix<T>::get(size_t row, size_t col) const {
+  if (row >= _rows || col >= _cols) {
+    throw ::std::out_of_range("Sparse matrix error - index out of range");
+  }
+
+  return _format == CSR ? get_row_view(row).get(col) : get_col_view(col).get(row);
+}
+
+template <typename T>
+SparseVectorView<T> SparseMatrix<T>::get_row_view(size_t idx) const {
+  if (_format != CSR) {
+    throw ::std::logic_error("Sparse matrix error - row views need CSR format");
+  }
+
+  return { _inner.data() + _outer[idx], _vals.data() + _outer[idx], _outer[idx + 1] - _outer[idx] };
+}
+
+template <typename T>
+SparseVectorView<T> SparseMatrix<T>::get_col_view(size_t idx) const {
+  if (_format != CSC) {
+    throw ::std::logic_error("Sparse matrix error - column views need CSC format");
+  }
+
+  return { _inner.data() + _outer[idx], _vals.data() + _outer[idx], _outer[idx + 1] - _outer[idx] };
+}
+
+// ------------------
+// Getters
+// ------------------
+
+template <typename T>
+size_t SparseMatrix<T>::outer_size() const { return _format == CSR ? _rows : _cols; }
+
+template <typename T>
+size_t SparseMatrix<T>::get_rows() const { return _rows; }
+
+template <typename T>
+size_t SparseMatrix<T>::get_cols() const { return _cols; }
+
+template <typename T>
+size_t SparseMatrix<T>::get_nnz() const { return _vals.size(); }
+
+template <typename T>
+SparseFormat SparseMatrix<T>::get_format() const { return _format; }
+
+template <typename T>
+const ::std::vector<size_t> &SparseMatrix<T>::get_outer() const { return _outer; }
+
+template <typename T>
+const ::std::vector<size_t> &SparseMatrix<T>::get_inner() const { return _inner; }
+
+template <typename T>
+const ::std::vector<T> &SparseMatrix<T>::get_vals() const { return _vals; }
@@ -5,6 +5,8 @@
 
 #include <string>
 #include <functional>
+#include <algorithm>
+#include <cstdint>
 #include <cmath>
 
 /**
@@ -13,16 +15,25 @@
  */
 namespace CNum::Model::Loss {
   using GHFunction = std::function< double(double, double) >;
+  using GHKernel = std::function< void(const double *,
+				       const double *,
+				       CNum::DataStructs::GradientPair *,
+				       size_t) >;
   using LossFunction = std::function< double(const CNum::DataStructs::Matrix<double> &,
 					     const CNum::DataStructs::Matrix<double> &) >;
   
 
   /// @struct LossProfile
   /// @brief The loss, gradient, and hessian functions associated with a loss function
+  ///
+  /// gh_kernel computes the gradients and hessians of a block of rows in one pass
+  /// (y, y_pred, gh_out, n). Profiles without one (i.e. custom losses) fall back to
+  /// gradient_func and hessian_func one row at a time
   struct LossProfile {
     LossFunction loss_func;
     GHFunction gradient_func;
     GHFunction hessian_func;
+    GHKernel gh_kernel{};
   };
   
   /// @brief Mean squared error
@@ -47,6 +58,17 @@ namespace CNum::Model::Loss {
   double MSE_hessian(double y,
 		     double y_pred);
 
+  /// @brief Calculate the gradients and hessians of the mean squared error for a block
+  /// of rows
+  /// @param y The true y values
+  /// @param y_pred The predicted values
+  /// @param gh_out Where the gradient and hessian values are written
+  /// @param n The number of rows
+  void MSE_gradients_hessians(const double *y,
+			      const double *y_pred,
+			      CNum::DataStructs::GradientPair *gh_out,
+			      size_t n);
+
   /// @brief Root mean squared error
   /// @param y List of true y values (shape=(n,1))
   /// @param y_pred List of predicted values (shape=(n,1))
@@ -75,11 +97,19 @@ namespace CNum::Model::Loss {
   double binary_crossentropy_hessian(double y,
 				     double y_pred);
   
+  /// @brief Calculate the gradients and hessians of the log loss for a block of rows
+  /// (the sigmoid is computed once per row)
+  /// @see MSE_gradients_hessians
+  void binary_crossentropy_gradients_hessians(const double *y,
+					      const double *y_pred,
+					      CNum::DataStructs::GradientPair *gh_out,
+					      size_t n);
+
   /// @brief Get the Gradients and Hessians of a Matrix
   /// @param y List of true y values (shape=(n,1)) 
   /// @param y_pred List of predicted values (shape=(n,1))
-  /// @param g_out The arena_view_t to output the gradient values to
-  /// @param h_out The arena_view_t to output the hessian values to
+  /// @param gh_out The arena_view_t to output the gradient and hessian values to
+  /// (GradientPair)
   /// @param position_array The arena_view_t containing the partitioned indeces
   /// of the data (partitions are for keeping track of which samples tree nodes
   /// have to work with)
@@ -87,12 +117,65 @@ namespace CNum::Model::Loss {
   /// @param hess_func The GHFunction for the hessian of the loss
   void get_gradients_hessians(const CNum::DataStructs::Matrix<double> &y,
 			      const CNum::DataStructs::Matrix<double> &y_pred,
-			      arena_view_t &g_out,
-			      arena_view_t &h_out,
+			      arena_view_t &gh_out,
 			      const arena_view_t &position_array,
 			      GHFunction &grad_func,
 			      GHFunction &hess_func);
 
+  /// @brief Get the Gradients and Hessians of a Matrix with a LossProfile
+  ///
+  /// The rows are gathered into contiguous blocks of y and y_pred values and each
+  /// block is passed to the profile's gh_kernel (or its gradient and hessian functions
+  /// if it has none). Large inputs are split into row blocks run in parallel.
+  /// @param y List of true y values (shape=(n,1))
+  /// @param y_pred List of predicted values (shape=(n,1))
+  /// @param gh_out The arena_view_t to output the gradient and hessian values to
+  /// (GradientPair)
+  /// @param position_array The arena_view_t containing the indeces of the rows
+  /// @param loss_profile The LossProfile of the loss
+  void get_gradients_hessians(const CNum::DataStructs::Matrix<double> &y,
+			      const CNum::DataStructs::Matrix<double> &y_pred,
+			      arena_view_t &gh_out,
+			      const arena_view_t &position_array,
+			      const LossProfile &loss_profile);
+
+  /// @brief Quantize gradients and hessians to integers for histogram building
+  ///
+  /// Each value is divided by its scale (the largest magnitude / levels) and
+  /// stochastically rounded to one of its two neighbouring integers, so the quantized
+  /// values are unbiased. The rounding only depends on seed and the position of the
+  /// value. gh_out is overwritten with the dequantized values so the sums, leaf values,
+  /// and histograms agree.
+  /// @param gh_out The arena_view_t with the gradient and hessian values (GradientPair)
+  /// @param q_out The arena_view_t to output the quantized values to (QuantizedPair)
+  /// @param levels The largest quantized magnitude (1 to 127)
+  /// @param seed The seed of the stochastic rounding
+  /// @return The gradient and hessian scales
+  CNum::DataStructs::GradientPair quantize_gradients(arena_view_t &gh_out,
+						     arena_view_t &q_out,
+						     int levels,
+						     uint64_t seed);
+
+  /// @brief Gradient-based One-Side Sampling (GOSS)
+  ///
+  /// The rows with the top_rate largest gradient magnitudes are kept and other_rate of
+  /// all rows are sampled from the rest, whose gradients and hessians are scaled up by
+  /// (rows not in the top) / (rows sampled) so the sums stay unbiased. The top rows are
+  /// found with a partial selection in parallel row blocks (ties go to the earlier
+  /// rows), the rest are sampled with a selection sampler that only depends on seed and
+  /// the row. The sample is compacted to the front of both views in row order.
+  /// @param gh_out The arena_view_t with the gradient and hessian values (GradientPair)
+  /// @param position_array The arena_view_t with the indeces of the rows of gh_out
+  /// @param top_rate The share of the rows kept by gradient magnitude
+  /// @param other_rate The share of the rows sampled from the rest
+  /// @param seed The seed of the sampling
+  /// @return The number of rows in the sample
+  size_t goss_sample(arena_view_t &gh_out,
+		     arena_view_t &position_array,
+		     double top_rate,
+		     double other_rate,
+		     uint64_t seed);
+
   /// @brief Get the loss of a matrix of values
   /// @param y List of true y values (shape=(n,1)) 
   /// @param y_pred List of predicted values (shape=(n,1))
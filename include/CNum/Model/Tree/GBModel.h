@@ -7,6 +7,7 @@
 #include "CNum/Model/Tree/TreeDefs.h"
 #include "json.hpp"
 #include <variant>
+#include <limits>
 
 namespace CNum::Model::Tree {
   struct Split;
@@ -51,7 +52,7 @@ namespace CNum::Model::Tree {
   template <typename TreeType>
   class GBModel {
   private:
-    TreeType *_trees;
+    TreeType *_trees{ nullptr };
     ::std::string _loss_type;
     CNum::Model::Loss::LossProfile _loss_profile;
     CNum::Model::Activation::ActivationFunc _activation_func;
@@ -66,6 +67,29 @@ namespace CNum::Model::Tree {
     double _gamma;
     SplitAlg _sa;
     SubsampleFunction _subsample_function;
+    ::std::vector<size_t> _categorical_features;
+    size_t _num_bins{ N_BINS };
+    int _gradient_levels{ 0 };
+    GrowPolicy _grow_policy{ DEPTH_FIRST };
+    int _max_leaves{ 0 };
+    bool _compact_subsample{ false };
+    double _goss_top_rate{ 0.0 };
+    double _goss_other_rate{ 0.0 };
+    double _colsample_bytree{ 1.0 };
+    double _colsample_bylevel{ 1.0 };
+    double _colsample_bynode{ 1.0 };
+    int _n_trees{ 0 };
+    int _best_iteration{ -1 };
+
+    /**
+     * @struct EvalSet
+     * @brief Held-out data scored after every learner for early stopping
+     */
+    struct EvalSet {
+      const ::CNum::DataStructs::Matrix<double> &X;
+      const ::CNum::DataStructs::Matrix<double> &y;
+      int early_stopping_rounds;
+    };
 
     /// @brief Parse the JSON data for a singular learner and create the TreeBooster
     /// object for it
@@ -82,6 +106,31 @@ namespace CNum::Model::Tree {
     /// @brief The move logic
     void move(GBModel &&other) noexcept;
 
+    /// @brief Bin dense data and run the boosting loop on it
+    /// @param eval The data scored for early stopping (nullptr to train every learner)
+    /// @see fit
+    void fit_dense(const ::CNum::DataStructs::Matrix<double> &X,
+		   const ::CNum::DataStructs::Matrix<double> &y,
+		   const EvalSet *eval,
+		   bool verbose);
+
+    /// @brief The boosting loop shared by the fit overloads
+    /// @param arena The arena of the worker running the fit
+    /// @param X The raw data (used for the training predictions, dense or CSR)
+    /// @param y The labels
+    /// @param data The binned data the trees are built on
+    /// @param shelves The bins and the boundaries associated with them
+    /// @param verbose Whether or not to log the loss
+    /// @param eval The data scored for early stopping (nullptr to train every learner)
+    template <typename XT>
+    void fit_binned(arena_t *arena,
+		    const XT &X,
+		    const ::CNum::DataStructs::Matrix<double> &y,
+		    const DataMatrix &data,
+		    ::std::shared_ptr<::CNum::Data::Shelf[]> shelves,
+		    bool verbose,
+		    const EvalSet *eval = nullptr);
+
   public:
     /**
      * @brief Overloaded default constructor
@@ -174,6 +223,82 @@ namespace CNum::Model::Tree {
     /// @brief Destructor
     ~GBModel();
 
+    /// @brief Set the features fit treats as categorical
+    ///
+    /// Categorical features are binned with a category-to-bin dictionary and split on
+    /// sets of categories, so they do not have to be one-hot encoded. Their values must
+    /// be non-negative integers. Models trained on a Dataset use the Dataset's
+    /// categorical features instead.
+    /// @param features The indeces of the categorical features
+    void set_categorical_features(::std::vector<size_t> features);
+
+    /// @brief Set the number of bins fit distributes each feature among
+    ///
+    /// Fewer bins build and scan smaller histograms (faster training), more bins place
+    /// the split thresholds more precisely. Up to N_BINS bins are stored in one byte,
+    /// more (up to MAX_BINS) are stored in two bytes and are only supported by the
+    /// dense fit. Models trained on a Dataset use the Dataset's bins instead.
+    /// @param num_bins The number of bins (at least 2)
+    void set_num_bins(size_t num_bins);
+
+    /// @brief Build the histograms of the histogram-based fits from quantized gradients
+    ///
+    /// Each learner's gradients and hessians are stochastically rounded to integers in
+    /// [-levels, levels] and the histograms are summed in integers, which are cheaper to
+    /// accumulate than doubles. The trees are trained on the rounded values, so fewer
+    /// levels trade accuracy for speed. The rounding is seeded by the learner, so fits
+    /// are reproducible.
+    /// @param levels The largest quantized magnitude (1 to 127, 0 to turn it off)
+    void set_quantized_gradients(int levels);
+
+    /// @brief Set the order the nodes of the histogram-based fits' trees are grown in
+    ///
+    /// LEVEL_WISE builds the histograms of every node of a depth in one pass over the
+    /// bins instead of one pass per node, which suits deep trees with many small nodes.
+    /// Nodes are split the same way under either policy. LEAF_WISE splits the leaf
+    /// with the highest gain first and stops at the max leaves, so the budget goes to
+    /// the branches that reduce the loss the most (use a larger max depth with it).
+    /// @param grow_policy The grow policy (DEPTH_FIRST by default)
+    void set_grow_policy(GrowPolicy grow_policy);
+
+    /// @brief Set the most leaves each tree of a leaf-wise fit grows
+    /// @param max_leaves The most leaves (0 for no limit other than the max depth)
+    void set_max_leaves(int max_leaves);
+
+    /// @brief Gather each learner's subsample into a contiguous block of bins
+    ///
+    /// Without it the trees of a subsampled fit index rows spread over the whole
+    /// dataset, so every histogram pass gathers from all of the bins. With it the
+    /// sampled rows (in row order) are copied into a block sized to the subsample and
+    /// the trees build their histograms sequentially over it. Only dense bins are
+    /// compacted (bundled and sparse bins are trained on in place).
+    /// @param compact Whether or not to compact the subsamples
+    void set_compact_subsample(bool compact);
+
+    /// @brief Sample each learner's rows with Gradient-based One-Side Sampling (GOSS)
+    ///
+    /// The gradients of every row are computed, the rows with the top_rate largest
+    /// gradient magnitudes are kept and other_rate of the rows are sampled from the
+    /// rest (their gradients and hessians are scaled up to keep the sums unbiased).
+    /// The subsample rate and function are not used while GOSS is on (histogram-based
+    /// fits only).
+    /// @param top_rate The share of the rows kept by gradient magnitude
+    /// @param other_rate The share of the rows sampled from the rest (both 0 to turn
+    /// GOSS off)
+    void set_goss(double top_rate, double other_rate);
+
+    /// @brief Sample the features each tree, level, and node of the histogram-based
+    /// fits can split on
+    ///
+    /// Each tree samples bytree of the features, each depth samples bylevel of the
+    /// tree's, and each node bynode of its level's (at least 1 feature each). Only the
+    /// tree's features have histograms built, so a smaller bytree also makes the trees
+    /// faster to train. The samples follow the global seed.
+    /// @param bytree The fraction of the features sampled per tree (in (0, 1])
+    /// @param bylevel The fraction of the tree's features sampled per level (in (0, 1])
+    /// @param bynode The fraction of the level's features sampled per node (in (0, 1])
+    void set_colsample(double bytree, double bylevel = 1.0, double bynode = 1.0);
+
     /// @brief Train the model
     /// @param X The tabular data used to train the GBModel
     /// @param y The labels for the data (the intended output of the model)
@@ -181,10 +306,67 @@ namespace CNum::Model::Tree {
 	     ::CNum::DataStructs::Matrix<double> &y,
 	     bool verbose = true);
 
+    /// @brief Train the model with early stopping on an eval set
+    ///
+    /// The eval set's predictions are updated with each learner and its loss is
+    /// evaluated every round. Training stops once the loss has not improved for
+    /// early_stopping_rounds learners, and the model keeps the learners up to the
+    /// best round (see get_best_iteration)
+    /// @param X The tabular data used to train the GBModel
+    /// @param y The labels for the data (the intended output of the model)
+    /// @param X_val The held-out data (the same features as X)
+    /// @param y_val The labels for the held-out data
+    /// @param early_stopping_rounds The learners trained without an improvement
+    /// before stopping (at least 1)
+    /// @param verbose Whether or not to log the loss
+    void fit(const ::CNum::DataStructs::Matrix<double> &X,
+	     const ::CNum::DataStructs::Matrix<double> &y,
+	     const ::CNum::DataStructs::Matrix<double> &X_val,
+	     const ::CNum::DataStructs::Matrix<double> &y_val,
+	     int early_stopping_rounds,
+	     bool verbose = true);
+
+    /// @brief Get the learner with the lowest eval set loss of the last early
+    /// stopping fit
+    /// @return The index of the learner (-1 if the last fit had no eval set)
+    int get_best_iteration() const;
+
+    /// @brief Train the model on a binned Dataset
+    ///
+    /// The Dataset is only read, so it can be reused (and shared by models training
+    /// concurrently) without binning the data again
+    /// @param dataset The binned data and labels
+    /// @param verbose Whether or not to log the loss
+    void fit(const ::CNum::Data::Dataset &dataset, bool verbose = true);
+
+    /// @brief Train the model on sparse data
+    ///
+    /// The trees are built on CSR bins, so only the stored values are visited when
+    /// building histograms. Values that are not stored are treated as 0
+    /// @param X The sparse data used to train the GBModel
+    /// @param y The labels for the data (the intended output of the model)
+    /// @param verbose Whether or not to log the loss
+    void fit(const ::CNum::DataStructs::SparseMatrix<double> &X,
+	     const ::CNum::DataStructs::Matrix<double> &y,
+	     bool verbose = true);
+
     /// @brief Inference (making predictions)
     /// @param The data to make predictions on
     /// @return The predictions
-    ::CNum::DataStructs::Matrix<double> predict(::CNum::DataStructs::Matrix<double> &data);
+    ::CNum::DataStructs::Matrix<double> predict(const ::CNum::DataStructs::Matrix<double> &data);
+
+    /// @brief Inference (making predictions) on sparse data
+    /// @param The data to make predictions on (values that are not stored are 0)
+    /// @return The predictions
+    ::CNum::DataStructs::Matrix<double> predict(const ::CNum::DataStructs::SparseMatrix<double> &data);
+
+    /// @brief Batch inference on a streamed data file
+    ///
+    /// Each batch is scored as soon as it has been read while the DataReader reads
+    /// ahead on its background thread
+    /// @param reader The reader streaming the data to make predictions on
+    /// @return The predictions for every row streamed by the reader
+    ::CNum::DataStructs::Matrix<double> predict(::CNum::Data::DataReader &reader);
 
     /// @brief Save Model to JSON encoded ".cmod" file
     /// @param path The path to save the file to
@@ -28,6 +28,7 @@ GBModel<TreeType>::GBModel(::std::string lt,
     _gamma(gamma),
     _subsample_function(ssf) {
   _trees = new TreeType[n_learners];
+  _n_trees = n_learners;
   _loss_profile = CNum::Model::Loss::get_loss_profile(lt);
   if (!_activation.empty())
     _activation_func = CNum::Model::Activation::get_activation_func(activation_func);
@@ -62,6 +63,7 @@ GBModel<TreeType>::GBModel(CNum::Model::Loss::LossProfile loss_profile,
     _gamma(gamma),
     _subsample_function(ssf) {
   _trees = new TreeType[n_learners];
+  _n_trees = n_learners;
   if (activation_func)
     _activation_func = activation_func;
 }
@@ -69,6 +71,7 @@ GBModel<TreeType>::GBModel(CNum::Model::Loss::LossProfile loss_profile,
 template <typename TreeType>
 void GBModel<TreeType>::copy_hyperparams(const GBModel &other) noexcept {
   this->_loss_type = other._loss_type;
+  this->_loss_profile = other._loss_profile;
   this->_n_learners = other._n_learners;
   this->_learning_rate = other._learning_rate;
   this->_subsample = other._subsample;
@@ -80,6 +83,20 @@ void GBModel<TreeType>::copy_hyperparams(const GBModel &other) noexcept {
   this->_reg_lambda = other._reg_lambda;
   this->_gamma = other._gamma;
   this->_activation_func = other._activation_func;
+  this->_subsample_function = other._subsample_function;
+  this->_categorical_features = other._categorical_features;
+  this->_num_bins = other._num_bins;
+  this->_gradient_levels = other._gradient_levels;
+  this->_grow_policy = other._grow_policy;
+  this->_max_leaves = other._max_leaves;
+  this->_compact_subsample = other._compact_subsample;
+  this->_goss_top_rate = other._goss_top_rate;
+  this->_goss_other_rate = other._goss_other_rate;
+  this->_colsample_bytree = other._colsample_bytree;
+  this->_colsample_bylevel = other._colsample_bylevel;
+  this->_colsample_bynode = other._colsample_bynode;
+  this->_n_trees = other._n_trees;
+  this->_best_iteration = other._best_iteration;
 }
 
 template <typename TreeType>
@@ -133,75 +150,373 @@ GBModel<TreeType>::~GBModel() {
 // Training and inference
 // ------------------------
 
+template <typename TreeType>
+void GBModel<TreeType>::set_categorical_features(::std::vector<size_t> features) {
+  _categorical_features = ::std::move(features);
+}
+
+template <typename TreeType>
+void GBModel<TreeType>::set_num_bins(size_t num_bins) {
+  if (num_bins < 2 || num_bins > MAX_BINS) {
+    throw ::std::invalid_argument("GBModel error - The number of bins must be between 2 and 65536");
+  }
+
+  _num_bins = num_bins;
+}
+
+template <typename TreeType>
+void GBModel<TreeType>::set_quantized_gradients(int levels) {
+  if (levels < 0 || levels > 127) {
+    throw ::std::invalid_argument("GBModel error - The gradient levels must be between 0 and 127");
+  }
+
+  _gradient_levels = levels;
+}
+
+template <typename TreeType>
+void GBModel<TreeType>::set_grow_policy(GrowPolicy grow_policy) {
+  _grow_policy = grow_policy;
+}
+
+template <typename TreeType>
+void GBModel<TreeType>::set_max_leaves(int max_leaves) {
+  if (max_leaves < 0 || max_leaves == 1) {
+    throw ::std::invalid_argument("GBModel error - The max leaves must be 0 or at least 2");
+  }
+
+  _max_leaves = max_leaves;
+}
+
+template <typename TreeType>
+void GBModel<TreeType>::set_compact_subsample(bool compact) {
+  _compact_subsample = compact;
+}
+
+template <typename TreeType>
+void GBModel<TreeType>::set_goss(double top_rate, double other_rate) {
+  if (top_rate < 0 || other_rate < 0 || top_rate + other_rate > 1) {
+    throw ::std::invalid_argument("GBModel error - The GOSS rates must be non-negative and sum to at most 1");
+  }
+
+  _goss_top_rate = top_rate;
+  _goss_other_rate = other_rate;
+}
+
+template <typename TreeType>
+void GBModel<TreeType>::set_colsample(double bytree, double bylevel, double bynode) {
+  if (!(bytree > 0 && bytree <= 1) || !(bylevel > 0 && bylevel <= 1) || !(bynode > 0 && bynode <= 1)) {
+    throw ::std::invalid_argument("GBModel error - The column sample rates must be in (0, 1]");
+  }
+
+  _colsample_bytree = bytree;
+  _colsample_bylevel = bylevel;
+  _colsample_bynode = bynode;
+}
+
 template <typename TreeType>
 void GBModel<TreeType>::fit(CNum::DataStructs::Matrix<double> &X,
 			    CNum::DataStructs::Matrix<double> &y,
 			    bool verbose) {
+  fit_dense(X, y, nullptr, verbose);
+}
+
+template <typename TreeType>
+void GBModel<TreeType>::fit(const CNum::DataStructs::Matrix<double> &X,
+			    const CNum::DataStructs::Matrix<double> &y,
+			    const CNum::DataStructs::Matrix<double> &X_val,
+			    const CNum::DataStructs::Matrix<double> &y_val,
+			    int early_stopping_rounds,
+			    bool verbose) {
+  if (early_stopping_rounds < 1) {
+    throw ::std::invalid_argument("GBModel error - The early stopping rounds must be at least 1");
+  }
+
+  if (X_val.get_cols() != X.get_cols() || X_val.get_rows() != y_val.get_rows()) {
+    throw ::std::invalid_argument("GBModel error - The eval set does not match the training data");
+  }
+
+  EvalSet eval{ X_val, y_val, early_stopping_rounds };
+  fit_dense(X, y, &eval, verbose);
+}
+
+template <typename TreeType>
+int GBModel<TreeType>::get_best_iteration() const {
+  return _best_iteration;
+}
+
+template <typename TreeType>
+void GBModel<TreeType>::fit_dense(const CNum::DataStructs::Matrix<double> &X,
+				  const CNum::DataStructs::Matrix<double> &y,
+				  const EvalSet *eval,
+				  bool verbose) {
   auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
 
   auto a = tp->submit< void >([&, this] (arena_t *arena) {
-    ::std::shared_ptr<CNum::Data::Shelf[]> shelves = _sa == GREEDY ? nullptr : CNum::Data::quantile_bin(X, N_BINS);
-
-      DataMatrix data = apply_quantile(X, shelves).transpose();
-
-      CNum::DataStructs::Matrix<double> fm = CNum::DataStructs::Matrix<double>::init_const(y.get_rows(), 1, 0);
-
-      ::std::visit([&, this] (auto &x) {
-	using T = ::std::decay_t<decltype(x)>;
-      
-	size_t n_samples = ::std::min(static_cast<size_t>(_subsample * X.get_rows()), X.get_rows());
-      
-	for (int i = 0; i < _n_learners; i++) {
-	  arena_view_t position_array = arena_malloc(arena, sizeof(size_t) * n_samples, sizeof(size_t));
-	  arena_view_t g_sub = arena_malloc(arena, sizeof(double) * n_samples, sizeof(double));
-	  arena_view_t h_sub = arena_malloc(arena, sizeof(double) * n_samples, sizeof(double));
-	
-	  size_t *pos_ptr = (size_t *) position_array.ptr;
-	  double *g_sub_ptr = (double *) g_sub.ptr;
-	  double *h_sub_ptr = (double *) h_sub.ptr;
-
-	  _subsample_function(pos_ptr, 0, X.get_rows(), n_samples, y);
-     
-	  DataPartition partition{ &position_array, 0, n_samples };
-
-	  CNum::Model::Loss::get_gradients_hessians(y,
-						    fm,
-						    g_sub,
-						    h_sub,
-						    position_array,
-						    _loss_profile.gradient_func,
-						    _loss_profile.hessian_func);
-
-	  _trees[i] = TreeType(arena,
-			       _max_depth,
-			       _min_samples,
-			       _weight_decay,
-			       _reg_lambda,
-			       _gamma);
-
-	
-        
-	  _trees[i].fit(data, shelves, g_sub_ptr, h_sub_ptr, partition);
-	  fm = fm + (_trees[i].predict(X) * _learning_rate);
-      
-	  if (verbose && i % 5 == 0) {
-	    ::std::cout << "[*] Learner #" << i << " loss: "
-			<< _loss_profile.loss_func(y, fm) << ::std::endl;
-	  }
-
-	  arena_clear(arena);
-	}
-      }, data);
+    ::std::shared_ptr<CNum::Data::Shelf[]> shelves = _sa == GREEDY ? nullptr : CNum::Data::quantile_bin(X, _num_bins, _categorical_features);
+
+    // resolutions that do not fit in a byte train on two-byte bins (never bundled)
+    if (_num_bins > N_BINS) {
+      auto wide_bins = CNum::Data::apply_quantile<uint16_t>(X, shelves, true);
+      fit_binned(arena, X, y, DataMatrix(&wide_bins), shelves, verbose, eval);
+      return;
+    }
+
+    auto bins = apply_quantile(X, shelves, true);
+
+    // bundle mutually exclusive features when that reduces the histograms built per node
+    CNum::Data::BundledBins bundled;
+    if (shelves)
+      bundled = CNum::Data::BundledBins(bins, shelves.get());
+
+    if (bundled.get_bundles() < bundled.get_features()) {
+      bins = CNum::DataStructs::Matrix<uint8_t>();
+      fit_binned(arena, X, y, DataMatrix(&bundled), shelves, verbose, eval);
+    } else {
+      fit_binned(arena, X, y, DataMatrix(&bins), shelves, verbose, eval);
+    }
   });
 
-  a.wait();
+  a.get();
 }
 
 template <typename TreeType>
-CNum::DataStructs::Matrix<double> GBModel<TreeType>::predict(CNum::DataStructs::Matrix<double> &data) {
+void GBModel<TreeType>::fit(const CNum::Data::Dataset &dataset, bool verbose) {
+  auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+
+  auto a = tp->submit< void >([&, this] (arena_t *arena) {
+    fit_binned(arena,
+	       dataset.X(),
+	       dataset.y(),
+	       dataset.get_bundled() ? DataMatrix(dataset.get_bundled()) : DataMatrix(&dataset.get_bins()),
+	       dataset.get_shelves(),
+	       verbose);
+  });
+
+  a.get();
+}
+
+template <typename TreeType>
+void GBModel<TreeType>::fit(const CNum::DataStructs::SparseMatrix<double> &X,
+			    const CNum::DataStructs::Matrix<double> &y,
+			    bool verbose) {
+  auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+
+  auto a = tp->submit< void >([&, this] (arena_t *arena) {
+    if (_num_bins > N_BINS) {
+      throw ::std::invalid_argument("GBModel error - Sparse data supports at most 256 bins");
+    }
+
+    auto shelves = CNum::Data::quantile_bin(X, _num_bins);
+    auto bins = CNum::Data::apply_quantile(X, shelves);
+
+    // the training predictions walk the rows
+    CNum::DataStructs::SparseMatrix<double> converted;
+    const auto &X_csr = X.get_format() == CNum::DataStructs::CSR ? X : (converted = X.to_format(CNum::DataStructs::CSR));
+
+    fit_binned(arena, X_csr, y, DataMatrix(&bins), shelves, verbose);
+  });
+
+  a.get();
+}
+
+template <typename TreeType>
+template <typename XT>
+void GBModel<TreeType>::fit_binned(arena_t *arena,
+				   const XT &X,
+				   const CNum::DataStructs::Matrix<double> &y,
+				   const DataMatrix &data,
+				   ::std::shared_ptr<CNum::Data::Shelf[]> shelves,
+				   bool verbose,
+				   const EvalSet *eval) {
+  CNum::DataStructs::Matrix<double> fm = CNum::DataStructs::Matrix<double>::init_const(y.get_rows(), 1, 0);
+
+  // GOSS samples from the gradients of every row
+  bool goss = _goss_top_rate + _goss_other_rate > 0 && _sa != GREEDY;
+  size_t n_samples = goss ? X.get_rows() : ::std::min(static_cast<size_t>(_subsample * X.get_rows()), X.get_rows());
+
+  // the compact bins are reused by every learner
+  bool compact = _compact_subsample && (goss || n_samples < X.get_rows()) &&
+    (::std::holds_alternative<const CNum::DataStructs::Matrix<uint8_t> *>(data) ||
+     ::std::holds_alternative<const CNum::DataStructs::Matrix<uint16_t> *>(data));
+  CNum::DataStructs::Matrix<uint8_t> compact_bins;
+  CNum::DataStructs::Matrix<uint16_t> compact_wide_bins;
+  DataMatrix tree_data = data;
+
+  // the rows a learner was fit on take their leaf's value, the others are predicted
+  // from their bins
+  double *fm_ptr = fm.begin();
+  ::std::vector<size_t> sample_rows;
+  ::std::vector<size_t> other_rows;
+  ::std::vector<uint8_t> in_sample;
+  ::std::vector<double> tree_preds;
+
+  // the eval set's predictions get one learner at a time
+  CNum::DataStructs::Matrix<double> eval_fm;
+  double best_loss = ::std::numeric_limits<double>::infinity();
+  if (eval != nullptr)
+    eval_fm = CNum::DataStructs::Matrix<double>::init_const(eval->y.get_rows(), 1, 0);
+
+  _n_trees = _n_learners;
+  _best_iteration = -1;
+
+  for (int i = 0; i < _n_learners; i++) {
+    arena_view_t position_array = arena_malloc(arena, sizeof(size_t) * n_samples, sizeof(size_t));
+    arena_view_t gh_sub = arena_malloc(arena, sizeof(GradientPair) * n_samples, sizeof(GradientPair));
+
+    size_t *pos_ptr = (size_t *) position_array.ptr;
+    GradientPair *gh_sub_ptr = (GradientPair *) gh_sub.ptr;
+
+    if (goss)
+      ::std::iota(pos_ptr, pos_ptr + n_samples, size_t{ 0 });
+    else
+      _subsample_function(pos_ptr, 0, X.get_rows(), n_samples, y);
+
+    // rows in order stream through the bins when they are gathered (GOSS keeps them
+    // in order)
+    if (compact && !goss)
+      ::std::sort(pos_ptr, pos_ptr + n_samples);
+
+    CNum::Model::Loss::get_gradients_hessians(y,
+					      fm,
+					      gh_sub,
+					      position_array,
+					      _loss_profile);
+
+    size_t n_learner_samples = goss
+      ? CNum::Model::Loss::goss_sample(gh_sub, position_array, _goss_top_rate, _goss_other_rate, i)
+      : n_samples;
+    DataPartition partition{ &position_array, 0, n_learner_samples };
+
+    // the gradients are computed on the dataset's rows, then the trees are trained on
+    // the gathered rows (numbered by their position in the subsample)
+    if (compact) {
+      if (auto *bins = ::std::get_if<const CNum::DataStructs::Matrix<uint8_t> *>(&data)) {
+	CNum::Data::gather_bins(**bins, pos_ptr, n_learner_samples, compact_bins);
+	tree_data = DataMatrix(static_cast<const CNum::DataStructs::Matrix<uint8_t> *>(&compact_bins));
+      } else {
+	CNum::Data::gather_bins(*::std::get<const CNum::DataStructs::Matrix<uint16_t> *>(data), pos_ptr, n_learner_samples, compact_wide_bins);
+	tree_data = DataMatrix(static_cast<const CNum::DataStructs::Matrix<uint16_t> *>(&compact_wide_bins));
+      }
+
+      sample_rows.assign(pos_ptr, pos_ptr + n_learner_samples);
+      ::std::iota(pos_ptr, pos_ptr + n_learner_samples, size_t{ 0 });
+    }
+
+    _trees[i] = TreeType(arena,
+			 _max_depth,
+			 _min_samples,
+			 _weight_decay,
+			 _reg_lambda,
+			 _gamma);
+    _trees[i].set_grow_policy(_grow_policy);
+    _trees[i].set_max_leaves(_max_leaves);
+    _trees[i].set_colsample(_colsample_bytree,
+			    _colsample_bylevel,
+			    _colsample_bynode,
+			    CNum::Utils::Rand::RandomGenerator::instance(2)());
+
+    if (_gradient_levels > 0 && _sa != GREEDY) {
+      arena_view_t q_sub = arena_malloc(arena, sizeof(QuantizedPair) * n_samples, sizeof(QuantizedPair));
+      GradientPair scale = CNum::Model::Loss::quantize_gradients(gh_sub, q_sub, _gradient_levels, i);
+
+      _trees[i].set_quantized_gradients({ (QuantizedPair *) q_sub.ptr, scale, _gradient_levels });
+    }
+
+    _trees[i].fit(tree_data, shelves, gh_sub_ptr, partition);
+    _trees[i].set_quantized_gradients({ nullptr, { 1.0, 1.0 }, 0 });
+
+    if (_sa == GREEDY) {
+      fm = fm + (_trees[i].predict(X) * _learning_rate);
+    } else {
+      tree_preds.resize(n_learner_samples);
+      _trees[i].leaf_values(tree_preds.data());
+
+      in_sample.assign(X.get_rows(), 0);
+      for (size_t k = 0; k < n_learner_samples; k++) {
+	size_t row = compact ? sample_rows[pos_ptr[k]] : pos_ptr[k];
+
+	// a subsample function can draw a row more than once
+	if (in_sample[row])
+	  continue;
+
+	in_sample[row] = 1;
+	fm_ptr[row] += tree_preds[k] * _learning_rate;
+      }
+
+      other_rows.clear();
+      for (size_t row = 0; row < X.get_rows(); row++) {
+	if (!in_sample[row])
+	  other_rows.push_back(row);
+      }
+
+      tree_preds.resize(other_rows.size());
+      _trees[i].predict_bins(data, shelves, other_rows.data(), other_rows.size(), tree_preds.data());
+      for (size_t k = 0; k < other_rows.size(); k++)
+	fm_ptr[other_rows[k]] += tree_preds[k] * _learning_rate;
+    }
+
+    double eval_loss{ 0.0 };
+    if (eval != nullptr) {
+      auto eval_preds = _trees[i].predict(eval->X);
+      double *eval_ptr = eval_fm.begin();
+      for (size_t row = 0; row < eval->X.get_rows(); row++)
+	eval_ptr[row] += eval_preds[row] * _learning_rate;
+
+      eval_loss = _loss_profile.loss_func(eval->y, eval_fm);
+      if (_best_iteration == -1 || eval_loss < best_loss) {
+	best_loss = eval_loss;
+	_best_iteration = i;
+      }
+    }
+
+    if (verbose && i % 5 == 0) {
+      ::std::cout << "[*] Learner #" << i << " loss: "
+		  << _loss_profile.loss_func(y, fm);
+
+      if (eval != nullptr)
+	::std::cout << " eval loss: " << eval_loss;
+
+      ::std::cout << ::std::endl;
+    }
+
+    arena_clear(arena);
+
+    if (eval != nullptr && i - _best_iteration >= eval->early_stopping_rounds)
+      break;
+  }
+
+  // the learners after the best one are dropped
+  if (eval != nullptr) {
+    _n_trees = _best_iteration + 1;
+    for (int i = _n_trees; i < _n_learners; i++)
+      _trees[i] = TreeType();
+  }
+}
+
+template <typename TreeType>
+CNum::DataStructs::Matrix<double> GBModel<TreeType>::predict(const CNum::DataStructs::Matrix<double> &data) {
+  auto preds = CNum::DataStructs::Matrix<double>::init_const(data.get_rows(), 1, 0);
+
+  ::std::for_each(_trees, _trees + _n_trees, [&] (TreeBooster &t) {
+    auto t_preds = t.predict(data);
+    preds = preds + (t_preds * _learning_rate);
+  });
+
+  if (_activation_func) {
+    preds = CNum::Model::Activation::activate(preds, _activation_func);
+  }
+
+  return preds;
+}
+
+template <typename TreeType>
+CNum::DataStructs::Matrix<double> GBModel<TreeType>::predict(const CNum::DataStructs::SparseMatrix<double> &data) {
+  if (data.get_format() != CNum::DataStructs::CSR)
+    return predict(data.to_format(CNum::DataStructs::CSR));
+
   auto preds = CNum::DataStructs::Matrix<double>::init_const(data.get_rows(), 1, 0);
   
-  ::std::for_each(_trees, _trees + _n_learners, [&] (TreeBooster &t) {
+  ::std::for_each(_trees, _trees + _n_trees, [&] (TreeBooster &t) {
     auto t_preds = t.predict(data);
     preds = preds + (t_preds * _learning_rate);
   });
@@ -213,6 +528,22 @@ CNum::DataStructs::Matrix<double> GBModel<TreeType>::predict(CNum::DataStructs::
   return preds;
 }
 
+template <typename TreeType>
+CNum::DataStructs::Matrix<double> GBModel<TreeType>::predict(CNum::Data::DataReader &reader) {
+  ::std::vector< CNum::DataStructs::Matrix<double> > batch_preds;
+  size_t total_rows{ 0 };
+
+  while (reader.next()) {
+    batch_preds.push_back(predict(reader.X()));
+    total_rows += reader.X().get_rows();
+  }
+
+  if (batch_preds.empty())
+    return CNum::DataStructs::Matrix<double>();
+
+  return CNum::DataStructs::Matrix<double>::combine_vertically(batch_preds, total_rows);
+}
+
 // ----------------------------
 // Saving and loading models
 // ----------------------------
@@ -222,7 +553,7 @@ void GBModel<TreeType>::save_model(::std::string path) {
   ::std::string json_str("{\"loss_type\":\"");
   json_str += _loss_type + "\",";
   json_str += "\"learning_rate\":" + ::std::to_string(_learning_rate) + ",";
-  json_str += "\"n_learners\":" + ::std::to_string(_n_learners) + ",";
+  json_str += "\"n_learners\":" + ::std::to_string(_n_trees) + ",";
   json_str += "\"subsample\":" + ::std::to_string(_subsample) + ",";
   json_str += "\"max_depth\":" + ::std::to_string(_max_depth) + ",";
   json_str += "\"min_samples\":" + ::std::to_string(_min_samples) + ",";
@@ -233,7 +564,7 @@ void GBModel<TreeType>::save_model(::std::string path) {
   
   json_str += "\"learners\": [";
 
-  for (int i = 0; i < _n_learners; i++) {
+  for (int i = 0; i < _n_trees; i++) {
     json_str += _trees[i].to_json() + ",";
   }
 
@@ -257,7 +588,25 @@ TreeBoosterNode *GBModel<TreeType>::parse_learner(json node) {
 		       node["split"]["threshold"],
 		       1e-4,
 		       0,
-		       SplitValuePair{ 0, 0 } };
+		       SplitValuePair{ 0, 0 },
+		       node["split"].value("default_left", false) };
+  if (node["split"].contains("categories")) {
+    auto bitset = node["split"]["categories"].template get< ::std::vector<uint32_t> >();
+
+    if (node["split"].contains("category_values")) {
+      res->_split.cat_bitset = ::std::move(bitset);
+      res->_split.cat_values = node["split"]["category_values"].template get< ::std::vector<double> >();
+    } else {
+      // older models index the bitset by category, those categories are the bins
+      for (size_t c = 0; c < bitset.size() * 32; c++) {
+	if ((bitset[c / 32] >> (c % 32)) & 1)
+	  res->_split.cat_values.push_back(static_cast<double>(c));
+      }
+
+      res->_split.cat_bitset.assign((res->_split.cat_values.size() + 31) / 32, ~uint32_t{ 0 });
+    }
+  }
+
   res->_value = node["value"];
   res->_left = node["left"].dump() == "{}" ? nullptr : parse_learner(node["left"]);
   res->_right = node["right"].dump() == "{}" ? nullptr : parse_learner(node["right"]);
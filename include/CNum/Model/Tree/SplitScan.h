@@ -0,0 +1,61 @@
+#ifndef SPLIT_SCAN_H
+#define SPLIT_SCAN_H
+
+#include "CNum/Model/Tree/TreeDefs.h"
+
+namespace CNum::Model::Tree {
+  /**
+   * @struct ScanCandidate
+   * @brief The best threshold of a histogram found by a split scan
+   *
+   * bin is -1 if no threshold has a gain above gamma. left holds the sums of the
+   * left side of the split (including the missing values if missing_left)
+   */
+  struct ScanCandidate {
+    double gain;
+    int bin;
+    bool missing_left;
+    GradientPair left;
+  };
+
+  /// @brief Find the threshold with the highest gain in a numeric histogram
+  ///
+  /// The bins are scanned in chunks. The Kahan-compensated prefix sums of a chunk are
+  /// computed first, then the gains of the chunk's thresholds are evaluated 4 at a time
+  /// (AVX on CPUs that support it) with the weight decay and gamma constraints applied
+  /// as masks, and the first threshold with the highest gain is kept. Every gain is
+  /// computed with the same operations as scan_bins_reference, so the results are
+  /// bitwise identical to it. Empty bins are not thresholds (they split the same rows
+  /// as the bin before them).
+  /// @param bins The histogram (not including the missing value bin)
+  /// @param n_bins The number of bins
+  /// @param sums The sums of the gradients and hessians of the node
+  /// @param missing The sums of the missing values (nullptr if the feature has none),
+  /// splits try sending them right, then left
+  /// @param weight_decay The smallest hessian sum a side of a split can have
+  /// @param reg_lambda Reg Lambda; A regularization parameter
+  /// @param gamma Gamma; The gain a split has to exceed
+  /// @return The best threshold
+  ScanCandidate scan_bins(const GradientPair *bins,
+			  int n_bins,
+			  GradientPair sums,
+			  const GradientPair *missing,
+			  double weight_decay,
+			  double reg_lambda,
+			  double gamma);
+
+  /// @brief Find the threshold with the highest gain in a numeric histogram one bin at
+  /// a time
+  ///
+  /// The serial reference scan_bins is tested against
+  /// @see scan_bins
+  ScanCandidate scan_bins_reference(const GradientPair *bins,
+				    int n_bins,
+				    GradientPair sums,
+				    const GradientPair *missing,
+				    double weight_decay,
+				    double reg_lambda,
+				    double gamma);
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define TREE_H
 
 #include "CNum/Model/Tree/TreeDefs.h"
+#include "CNum/Model/Tree/SplitScan.h"
 #include "CNum/Model/Tree/TreeBoosterNode.h"
 #include "CNum/Model/Tree/TreeBooster.h"
 #include "CNum/Model/Tree/XGTreeBooster.h"
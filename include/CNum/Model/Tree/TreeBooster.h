@@ -11,6 +11,7 @@
 #include <future>
 #include <cstring>
 #include <utility>
+#include <array>
 
 namespace CNum::Model::Tree {
   /**
@@ -32,35 +33,106 @@ namespace CNum::Model::Tree {
     double _gamma;
     double _weight_decay;
     arena_t *_arena;
+    std::vector<size_t> _hist_bins;
+    QuantizedGradients _quantized{ nullptr, { 1.0, 1.0 }, 0 };
+    GrowPolicy _grow_policy{ DEPTH_FIRST };
+    int _max_leaves{ 0 };
+    double _colsample_bytree{ 1.0 };
+    double _colsample_bylevel{ 1.0 };
+    double _colsample_bynode{ 1.0 };
+    uint64_t _colsample_seed{ 0 };
+    std::vector<uint8_t> _tree_histograms;
+    std::vector<uint8_t> _tree_features;
+
+    /// @brief The quantized gradient pairs to build histograms from (nullptr if not set)
+    const QuantizedGradients *quantized() const { return _quantized.pairs != nullptr ? &_quantized : nullptr; }
+
+    /// @brief Sample the columns of the next fit (every column if the column sample
+    /// rates are 1)
+    /// @param feature_histograms The histogram each feature is built in
+    /// @param n_histograms The number of histograms
+    void sample_tree_columns(const std::vector<size_t> &feature_histograms, size_t n_histograms);
+
+    /// @brief Get the columns of a node's split search
+    ///
+    /// The node's features are sampled from its level's, which are sampled from the
+    /// tree's. The samples only depend on the seed, the depth and the node's partition
+    /// so they are the same whatever order the nodes are searched in
+    /// @param depth The depth of the node
+    /// @param partition The partition of the node's slice of the dataset
+    /// @param features Where the node's feature flags are written
+    /// @param columns Where the node's columns are written
+    /// @return columns (nullptr if every column is used)
+    const ColumnSample *node_columns(int depth,
+				     const DataPartition &partition,
+				     std::vector<uint8_t> &features,
+				     ColumnSample &columns) const;
     
   private:
-    double predict_sample(TreeBoosterNode *node, std::span<double> &sample);
+    /// @brief Inference on a single sample (dense row or sparse row view)
+    template <typename SampleT>
+    double predict_sample(TreeBoosterNode *node, const SampleT &sample);
 
     virtual void fit_node_greedy(const CNum::DataStructs::Matrix<double> &X,
-				 double *g,
-				 double *h,
+				 GradientPair *gh,
 				 TreeBoosterNode *node,
 				 int depth = 0) = 0;
     
-    virtual void fit_node_hist(const CNum::DataStructs::Matrix<int> &X,
+    virtual void fit_node_hist(const CNum::DataStructs::Matrix<uint8_t> &X,
 			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
-			       double *g,
-			       double *h,
+			       GradientPair *gh,
 			       DataPartition &partition,
 			       const arena_view_t &parent_hist_view,
 			       TreeBoosterNode *node,
 			       int depth = 0) = 0;
 
-    virtual void fit_prep(const CNum::DataStructs::Matrix<int> &X,
+    virtual void fit_node_hist(const CNum::DataStructs::Matrix<uint16_t> &X,
+			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			       GradientPair *gh,
+			       DataPartition &partition,
+			       const arena_view_t &parent_hist_view,
+			       TreeBoosterNode *node,
+			       int depth = 0) = 0;
+
+    virtual void fit_node_hist(const CNum::DataStructs::SparseMatrix<uint8_t> &X,
+			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			       GradientPair *gh,
+			       DataPartition &partition,
+			       const arena_view_t &parent_hist_view,
+			       TreeBoosterNode *node,
+			       int depth = 0) = 0;
+
+    virtual void fit_node_hist(const CNum::Data::BundledBins &X,
+			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			       GradientPair *gh,
+			       DataPartition &partition,
+			       const arena_view_t &parent_hist_view,
+			       TreeBoosterNode *node,
+			       int depth = 0) = 0;
+
+    virtual void fit_prep(const CNum::DataStructs::Matrix<uint8_t> &X,
+			  std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			  GradientPair *gh,
+			  DataPartition &partition) = 0;
+
+    virtual void fit_prep(const CNum::DataStructs::Matrix<uint16_t> &X,
 			  std::shared_ptr<CNum::Data::Shelf[]> shelves,
-			  double *g,
-			  double *h,
+			  GradientPair *gh,
+			  DataPartition &partition) = 0;
+
+    virtual void fit_prep(const CNum::DataStructs::SparseMatrix<uint8_t> &X,
+			  std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			  GradientPair *gh,
+			  DataPartition &partition) = 0;
+
+    virtual void fit_prep(const CNum::Data::BundledBins &X,
+			  std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			  GradientPair *gh,
 			  DataPartition &partition) = 0;
 
     virtual void fit_prep(const CNum::DataStructs::Matrix<double> &X,
 			  std::shared_ptr<CNum::Data::Shelf[]> shelves,
-			  double *g,
-			  double *h,
+			  GradientPair *gh,
 			  DataPartition &partition) = 0;
     /// @brief Recursively free nodes
     void destruct(TreeBoosterNode *node);
@@ -108,32 +180,131 @@ namespace CNum::Model::Tree {
     /// @brief Set the root of the tree
     void set_root(TreeBoosterNode *root);
 
-    virtual void fit(DataMatrix &X,
+    /// @brief Build the histograms of the next fit from quantized gradient pairs
+    ///
+    /// The pairs are indexed like the gradient pairs passed to fit and are
+    /// partitioned along with them
+    /// @param quantized The quantized gradient pairs (pairs = nullptr to build the
+    /// histograms from the gradient pairs)
+    void set_quantized_gradients(const QuantizedGradients &quantized);
+
+    /// @brief Set the order the nodes are grown in by histogram fits
+    /// @param grow_policy The grow policy
+    void set_grow_policy(GrowPolicy grow_policy);
+
+    /// @brief Set the most leaves a leaf-wise fit grows
+    /// @param max_leaves The most leaves (0 for no limit other than the max depth)
+    void set_max_leaves(int max_leaves);
+
+    /// @brief Set the fraction of the features sampled per tree, per level, and per node
+    ///
+    /// Each level samples from the tree's features and each node from its level's.
+    /// Only the tree's features have histograms built, so histogram subtraction works
+    /// as usual
+    /// @param bytree The fraction of the features sampled per tree (in (0, 1])
+    /// @param bylevel The fraction of the tree's features sampled per level (in (0, 1])
+    /// @param bynode The fraction of the level's features sampled per node (in (0, 1])
+    /// @param seed The seed of the next fit's samples
+    void set_colsample(double bytree, double bylevel, double bynode, uint64_t seed);
+
+    virtual void fit(const DataMatrix &X,
 		     std::shared_ptr<CNum::Data::Shelf[]> shelves,
-		     double *g,
-		     double *h,
+		     GradientPair *gh,
 		     DataPartition &partition) = 0;
 
     /// @brief Inference (making predictions) on tabular data
     /// @param data The data to make predictions on
     /// @return The predictions
-    CNum::DataStructs::Matrix<double> predict(CNum::DataStructs::Matrix<double> &data);
+    CNum::DataStructs::Matrix<double> predict(const CNum::DataStructs::Matrix<double> &data);
 
-    /// @brief Partition idx array, g, and h based on a split to make 
+    /// @brief Inference (making predictions) on sparse data
+    ///
+    /// Features that are not stored in a row are treated as 0
+    /// @param data The data to make predictions on (converted to CSR if it is CSC)
+    /// @return The predictions
+    CNum::DataStructs::Matrix<double> predict(const CNum::DataStructs::SparseMatrix<double> &data);
+
+    /// @brief Get the leaf values of the rows the last fit was trained on
+    ///
+    /// A fit leaves the rows of each leaf contiguous in its partition (in the order of
+    /// an in-order walk of the tree), so the values are written without a traversal
+    /// @param values Where the values are written (one per row of the fit's partition,
+    /// in the partition's order)
+    void leaf_values(double *values) const;
+
+    /// @brief Inference on rows of the bins the tree was fit on
+    ///
+    /// Rows go down the side their bins went while fitting. Large row sets are
+    /// predicted in parallel blocks
+    /// @param X The bins (the raw rows if the tree was fit with the greedy method)
+    /// @param shelves The bins and the boundaries associated with them
+    /// @param rows The rows to predict
+    /// @param n_rows The number of rows
+    /// @param preds Where the predictions are written (one per entry of rows)
+    void predict_bins(const DataMatrix &X,
+		      std::shared_ptr<CNum::Data::Shelf[]> shelves,
+		      const size_t *rows,
+		      size_t n_rows,
+		      double *preds);
+
+    /// @brief Get which bins of a feature go left in a split
+    /// @param split The split
+    /// @param shelf The split feature's shelf
+    /// @return Whether each bin goes left (one entry per bin of the shelf)
+    static std::vector<uint8_t> left_bins(const Split &split, const CNum::Data::Shelf &shelf);
+
+    /// @brief Partition idx array and gradient pairs based on a split to make
     /// each nodes' slice of the dataset contigous
+    ///
+    /// The partition is stable (rows keep their order on both sides). Large nodes are
+    /// partitioned in parallel row blocks
     /// @param X The dataset (row-wise features)
-    /// @param g The gradient array
-    /// @param h The hessian array
-    /// @param feat The feature associated with the split
-    /// @param bin The bin associated with the split
+    /// @param gh The gradient and hessian pairs
+    /// @param split The split
+    /// @param shelf The split feature's shelf
     /// @param partition The current node's data partition
+    /// @param q The quantized gradient pairs, partitioned along with gh (can be nullptr)
+    /// @param parallel Whether or not large nodes can be partitioned on the ThreadPool
     /// @return The index of the boundary between the left and right partitions
-    static size_t partition_data(const CNum::DataStructs::Matrix<int> &X,
-				 double *g,
-				 double *h,
-				 size_t feat,
-				 uint8_t bin,
-				 const DataPartition &partition);
+    static size_t partition_data(const CNum::DataStructs::Matrix<uint8_t> &X,
+				 GradientPair *gh,
+				 const Split &split,
+				 const CNum::Data::Shelf &shelf,
+				 const DataPartition &partition,
+				 QuantizedPair *q = nullptr,
+				 bool parallel = true);
+
+    /// @brief Partition idx array and gradient pairs based on a split on two-byte bins
+    /// @see partition_data
+    static size_t partition_data(const CNum::DataStructs::Matrix<uint16_t> &X,
+				 GradientPair *gh,
+				 const Split &split,
+				 const CNum::Data::Shelf &shelf,
+				 const DataPartition &partition,
+				 QuantizedPair *q = nullptr,
+				 bool parallel = true);
+
+    /// @brief Partition idx array and gradient pairs based on a split on sparse (CSR) bins
+    ///
+    /// Rows that do not store the feature are placed with the bin of 0.0
+    /// @see partition_data
+    static size_t partition_data(const CNum::DataStructs::SparseMatrix<uint8_t> &X,
+				 GradientPair *gh,
+				 const Split &split,
+				 const CNum::Data::Shelf &shelf,
+				 const DataPartition &partition,
+				 QuantizedPair *q = nullptr,
+				 bool parallel = true);
+
+    /// @brief Partition idx array and gradient pairs based on a split on bundled bins
+    /// @see partition_data
+    static size_t partition_data(const CNum::Data::BundledBins &X,
+				 GradientPair *gh,
+				 const Split &split,
+				 const CNum::Data::Shelf &shelf,
+				 const DataPartition &partition,
+				 QuantizedPair *q = nullptr,
+				 bool parallel = true);
 
     /// @brief Subtract a parent histogram from "small" histogram for histogram caching
     ///
@@ -150,9 +321,10 @@ namespace CNum::Model::Tree {
 				      arena_view_t &large_hist_view);
 
     /// @brief Allocate space for histograms on the arena
-    /// @param n_data_cols The number of features in the dataset
+    /// @param hist_bins The number of bins of each histogram (one per feature or bundle)
+    /// @param arena The arena to allocate in (nullptr for the tree's arena)
     /// @return An arena_view_t with the histograms
-    arena_view_t init_hist_view(size_t n_data_cols);
+    arena_view_t init_hist_view(const std::vector<size_t> &hist_bins, arena_t *arena = nullptr);
 
     /// @brief Save tree data in json encoded string
     /// @return The JSON string
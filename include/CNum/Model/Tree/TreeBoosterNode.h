@@ -4,10 +4,14 @@
 #include "CNum/DataStructs/DataStructs.h"
 #include "CNum/Data/Data.h"
 #include "CNum/Model/Tree/TreeDefs.h"
+#include "CNum/Model/Tree/SplitScan.h"
 
 #include <vector>
 #include <future>
 #include <cstring>
+#include <array>
+#include <limits>
+#include <type_traits>
 
 namespace CNum::Model::Tree {
   struct Split;
@@ -49,9 +53,74 @@ namespace CNum::Model::Tree {
     /// @return The best split
     static Split split_comparison(std::vector< std::future<Split> > &splits);
   
+    /// @brief Scan the histogram of a feature for a split with a higher gain than s
+    ///
+    /// Numeric features are scanned with scan_bins
+    /// @param shelf The feature's shelf
+    /// @param feature The feature
+    /// @param bins The histogram
+    /// @param gs The sum of the gradients of the node
+    /// @param hs The sum of the hessians of the node
+    /// @param s The best split found so far (updated in place)
+    static void scan_histogram(const CNum::Data::Shelf &shelf,
+			       size_t feature,
+			       const GradientPair *bins,
+			       double gs,
+			       double hs,
+			       double weight_decay,
+			       double reg_lambda,
+			       double gamma,
+			       Split &s);
+
+    /// @brief Scan the histogram of a categorical feature for a many-vs-many split
+    /// with a higher gain than s
+    ///
+    /// The categories are sorted by their leaf value and every prefix (from either
+    /// end) is tried as the set of categories that go left
+    /// @see scan_histogram
+    static void scan_categorical(const CNum::Data::Shelf &shelf,
+				 size_t feature,
+				 const GradientPair *bins,
+				 double gs,
+				 double hs,
+				 double weight_decay,
+				 double reg_lambda,
+				 double gamma,
+				 Split &s);
+
+    /// @brief The histogram split search shared by the dense, sparse, and bundled bins
+    template <typename MatrixT>
+    static Split find_best_split_hist_impl(const MatrixT &X,
+					   std::shared_ptr<CNum::Data::Shelf[]> shelves,
+					   const GradientPair *gh,
+					   bool histogram_cache,
+					   const arena_view_t &hist_view,
+					   DataPartition &partition,
+					   double weight_decay,
+					   double reg_lambda,
+					   double gamma,
+					   const QuantizedGradients *quantized,
+					   bool parallel,
+					   const ColumnSample *columns);
+
+    /// @brief The batched histogram split search shared by the dense, sparse, and
+    /// bundled bins
+    template <typename MatrixT>
+    static std::vector<Split> find_best_splits_hist_impl(const MatrixT &X,
+							 std::shared_ptr<CNum::Data::Shelf[]> shelves,
+							 const GradientPair *gh,
+							 const std::vector<arena_view_t> &hist_views,
+							 const std::vector<DataPartition> &partitions,
+							 double weight_decay,
+							 double reg_lambda,
+							 double gamma,
+							 const QuantizedGradients *quantized,
+							 const ColumnSample *columns);
+
   public:
     Split _split;
     double _value;
+    size_t _rows;
     TreeBoosterNode *_left;
     TreeBoosterNode *_right;
 
@@ -67,8 +136,7 @@ namespace CNum::Model::Tree {
     /// histogram method (maximizing gain)
     /// @param X The dataset
     /// @param shelves The bins and values associated with their boundaries
-    /// @param g The gradient array
-    /// @param h The hessian array
+    /// @param gh The gradient and hessian pairs
     /// @param histogram_cache Whether or not the histograms have already been built
     /// @param hist_view The view of the histograms
     /// @param partition The partition of the node's slice of the dataset
@@ -76,33 +144,163 @@ namespace CNum::Model::Tree {
     /// effect is significant enough to take
     /// @param reg_lambda Reg Lambda; A regularization parameter
     /// @param gamma Gamma; A regularization parameter
+    /// @param quantized The quantized gradient pairs the histograms are built from
+    /// (nullptr to build them from gh)
+    /// @param parallel Whether or not the search can be spread over the ThreadPool
+    /// (false inside tasks that must not wait on other tasks). The split is the same
+    /// either way
+    /// @param columns The columns to build and scan (nullptr for every column)
     /// @return The best split
-    static Split find_best_split_hist(const CNum::DataStructs::Matrix<int> &X,
+    static Split find_best_split_hist(const CNum::DataStructs::Matrix<uint8_t> &X,
+				      std::shared_ptr<CNum::Data::Shelf[]> shelves,
+				      const GradientPair *gh,
+				      bool histogram_cache,
+				      const arena_view_t &hist_view,
+				      DataPartition &partition,
+				      double weight_decay = 0.0,
+				      double reg_lambda = 1.0,
+				      double gamma = 0,
+				      const QuantizedGradients *quantized = nullptr,
+				      bool parallel = true,
+				      const ColumnSample *columns = nullptr);
+
+    /// @brief Find the best split at a tree node with the histogram method on
+    /// two-byte bins (more than 256 bins per feature)
+    /// @see find_best_split_hist
+    static Split find_best_split_hist(const CNum::DataStructs::Matrix<uint16_t> &X,
+				      std::shared_ptr<CNum::Data::Shelf[]> shelves,
+				      const GradientPair *gh,
+				      bool histogram_cache,
+				      const arena_view_t &hist_view,
+				      DataPartition &partition,
+				      double weight_decay = 0.0,
+				      double reg_lambda = 1.0,
+				      double gamma = 0,
+				      const QuantizedGradients *quantized = nullptr,
+				      bool parallel = true,
+				      const ColumnSample *columns = nullptr);
+
+    /// @brief Find the best split at a tree node with the histogram method on
+    /// sparse (CSR) bins
+    ///
+    /// Only the stored entries are visited when building the histograms, the
+    /// implicit zeros are accounted for with the node totals
+    /// @see find_best_split_hist
+    static Split find_best_split_hist(const CNum::DataStructs::SparseMatrix<uint8_t> &X,
+				      std::shared_ptr<CNum::Data::Shelf[]> shelves,
+				      const GradientPair *gh,
+				      bool histogram_cache,
+				      const arena_view_t &hist_view,
+				      DataPartition &partition,
+				      double weight_decay = 0.0,
+				      double reg_lambda = 1.0,
+				      double gamma = 0,
+				      const QuantizedGradients *quantized = nullptr,
+				      bool parallel = true,
+				      const ColumnSample *columns = nullptr);
+
+    /// @brief Find the best split at a tree node with the histogram method on
+    /// bundled bins
+    ///
+    /// One histogram is built per bundle, the features' histograms are recovered
+    /// from it when searching for splits
+    /// @see find_best_split_hist
+    static Split find_best_split_hist(const CNum::Data::BundledBins &X,
 				      std::shared_ptr<CNum::Data::Shelf[]> shelves,
-				      const double *g,
-				      const double *h,
+				      const GradientPair *gh,
 				      bool histogram_cache,
 				      const arena_view_t &hist_view,
 				      DataPartition &partition,
 				      double weight_decay = 0.0,
 				      double reg_lambda = 1.0,
-				      double gamma = 0);
+				      double gamma = 0,
+				      const QuantizedGradients *quantized = nullptr,
+				      bool parallel = true,
+				      const ColumnSample *columns = nullptr);
+
+    /// @brief Find the best splits of several nodes with the histogram method,
+    /// building all of their histograms in one pass over the data
+    ///
+    /// The histograms are split into groups spread over the ThreadPool and each
+    /// feature's bins (each row for sparse bins) are streamed once for all of the
+    /// nodes instead of once per node
+    /// @param X The dataset
+    /// @param shelves The bins and values associated with their boundaries
+    /// @param gh The gradient and hessian pairs
+    /// @param hist_views The (zeroed) histograms of each node
+    /// @param partitions The partition of each node (of the same index array)
+    /// @param weight_decay A parameter used in deteriming whether or not a splits
+    /// effect is significant enough to take
+    /// @param reg_lambda Reg Lambda; A regularization parameter
+    /// @param gamma Gamma; A regularization parameter
+    /// @param quantized The quantized gradient pairs the histograms are built from
+    /// (nullptr to build them from gh)
+    /// @param columns The columns to build and scan for each node (nullptr for every
+    /// column of every node)
+    /// @return The best split of each node
+    static std::vector<Split> find_best_splits_hist(const CNum::DataStructs::Matrix<uint8_t> &X,
+						    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+						    const GradientPair *gh,
+						    const std::vector<arena_view_t> &hist_views,
+						    const std::vector<DataPartition> &partitions,
+						    double weight_decay = 0.0,
+						    double reg_lambda = 1.0,
+						    double gamma = 0,
+						    const QuantizedGradients *quantized = nullptr,
+						    const ColumnSample *columns = nullptr);
+
+    /// @brief Find the best splits of several nodes on two-byte bins
+    /// @see find_best_splits_hist
+    static std::vector<Split> find_best_splits_hist(const CNum::DataStructs::Matrix<uint16_t> &X,
+						    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+						    const GradientPair *gh,
+						    const std::vector<arena_view_t> &hist_views,
+						    const std::vector<DataPartition> &partitions,
+						    double weight_decay = 0.0,
+						    double reg_lambda = 1.0,
+						    double gamma = 0,
+						    const QuantizedGradients *quantized = nullptr,
+						    const ColumnSample *columns = nullptr);
+
+    /// @brief Find the best splits of several nodes on sparse (CSR) bins
+    /// @see find_best_splits_hist
+    static std::vector<Split> find_best_splits_hist(const CNum::DataStructs::SparseMatrix<uint8_t> &X,
+						    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+						    const GradientPair *gh,
+						    const std::vector<arena_view_t> &hist_views,
+						    const std::vector<DataPartition> &partitions,
+						    double weight_decay = 0.0,
+						    double reg_lambda = 1.0,
+						    double gamma = 0,
+						    const QuantizedGradients *quantized = nullptr,
+						    const ColumnSample *columns = nullptr);
+
+    /// @brief Find the best splits of several nodes on bundled bins
+    /// @see find_best_splits_hist
+    static std::vector<Split> find_best_splits_hist(const CNum::Data::BundledBins &X,
+						    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+						    const GradientPair *gh,
+						    const std::vector<arena_view_t> &hist_views,
+						    const std::vector<DataPartition> &partitions,
+						    double weight_decay = 0.0,
+						    double reg_lambda = 1.0,
+						    double gamma = 0,
+						    const QuantizedGradients *quantized = nullptr,
+						    const ColumnSample *columns = nullptr);
 
     /// @brief Find the best split at a tree node with the exact
     /// greedy method proposed in Chen & Guestrin's XGBoost (minimizing loss)
     ///
     /// Available next release
     /// @param X The dataset
-    /// @param g The gradient array
-    /// @param h The hessian array
+    /// @param gh The gradient and hessian pairs
     /// @param weight_decay A parameter used in deteriming whether or not a splits
     /// effect is significant enough to take
     /// @param reg_lambda Reg Lambda; A regularization parameter
     /// @param gamma Gamma; A regularization parameter
     /// @return The best split
     static Split find_best_split_greedy(CNum::DataStructs::Matrix<double> &X,
-				        const double *g,
-				        const double *h,
+					const GradientPair *gh,
 					double weight_decay = 0.0,
 					double reg_lambda = 1.0,
 					double gamma = 0);
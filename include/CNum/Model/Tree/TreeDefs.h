@@ -2,8 +2,13 @@
 #define TREE_DEFS_H
 
 #include "CNum/DataStructs/DataStructs.h"
+#include "CNum/Data/Bundle.h"
+#include "CNum/Data/Missing.h"
+#include <vector>
+#include <cstdint>
 #include <utility>
 #include <variant>
+#include <algorithm>
 
 /**
  * @namespace CNum::Model::Tree
@@ -11,8 +16,10 @@
  */
 namespace CNum::Model::Tree {
   using SplitValuePair = std::pair<double, double>;
+  using GradientPair = CNum::DataStructs::GradientPair;
+  using QuantizedPair = CNum::DataStructs::QuantizedPair;
   
-  /// @brief Number of bins used in the Tree models
+  /// @brief Default (and maximum one-byte) number of bins used in the Tree models
   /// 
   /// The value 256 was chosen for vgather optimizations. If there are 256 bins
   /// then the bin number fits in one byte, and we can gather more gradients and
@@ -20,15 +27,54 @@ namespace CNum::Model::Tree {
   /// best split.
   constexpr int N_BINS = 256;
 
-  using DataMatrix = std::variant< CNum::DataStructs::Matrix<int>, CNum::DataStructs::Matrix<double> >;
+  /// @brief Maximum number of bins used in the Tree models
+  ///
+  /// Resolutions above N_BINS store their bins as uint16_t
+  constexpr int MAX_BINS = 65536;
+
+  /// @brief The training data of a tree, bins for HIST (feature-major, CSR, or bundled)
+  /// and raw values for GREEDY
+  ///
+  /// Non-owning so trees can train on data shared with other models
+  using DataMatrix = std::variant< const CNum::DataStructs::Matrix<uint8_t> *,
+				   const CNum::DataStructs::Matrix<uint16_t> *,
+				   const CNum::DataStructs::Matrix<double> *,
+				   const CNum::DataStructs::SparseMatrix<uint8_t> *,
+				   const CNum::Data::BundledBins * >;
+
+  /// @brief The number of features in feature-major bins
+  template <typename BinT>
+  inline size_t feature_count(const CNum::DataStructs::Matrix<BinT> &X) { return X.get_rows(); }
+
+  /// @brief The number of features in sparse (CSR) bins
+  inline size_t feature_count(const CNum::DataStructs::SparseMatrix<uint8_t> &X) { return X.get_cols(); }
+
+  /// @brief The number of features in bundled bins
+  inline size_t feature_count(const CNum::Data::BundledBins &X) { return X.get_features(); }
+
+  /// @brief The number of histograms built per node (one per feature)
+  template <typename MatrixT>
+  inline size_t histogram_count(const MatrixT &X) { return feature_count(X); }
+
+  /// @brief The number of histograms built per node on bundled bins (one per bundle)
+  inline size_t histogram_count(const CNum::Data::BundledBins &X) { return X.get_bundles(); }
+
+  /// @brief The histogram a feature is built in
+  template <typename MatrixT>
+  inline size_t histogram_of(const MatrixT &X, size_t feature) { return feature; }
+
+  /// @brief The histogram a feature is built in on bundled bins (its bundle's)
+  inline size_t histogram_of(const CNum::Data::BundledBins &X, size_t feature) { return X.get_bundle(feature); }
 
   /**
    * @struct Histogram
    * @brief Holds the total gradients and hessians for all bins
+   *
+   * The histograms of a node are views into one contiguous block of GradientPair
+   * (feature, then bin, then gradient and hessian)
    */
   struct Histogram {
-    arena_view_t g_bin;
-    arena_view_t h_bin;
+    arena_view_t bins;
   };
 
   /**
@@ -41,11 +87,67 @@ namespace CNum::Model::Tree {
     size_t start;
     size_t end;
   };
+
+  /**
+   * @struct QuantizedGradients
+   * @brief The quantized gradient and hessian pairs a tree is trained on (see
+   * CNum::Model::Loss::quantize_gradients)
+   *
+   * pairs is permuted along with the gradient pairs when the data is partitioned, and
+   * histograms are accumulated in integers and scaled back before they are scanned
+   */
+  struct QuantizedGradients {
+    QuantizedPair *pairs;
+    GradientPair scale;
+    int levels;
+  };
+
+  /**
+   * @struct ColumnSample
+   * @brief The columns a split search uses (see TreeBooster::set_colsample)
+   *
+   * histograms flags the histograms that are built (one entry per feature or bundle)
+   * and features flags the features that are scanned for splits (one entry per
+   * feature). A scanned feature's histogram has to be built
+   */
+  struct ColumnSample {
+    const uint8_t *histograms;
+    const uint8_t *features;
+  };
+
+  /**
+   * @struct IntPair
+   * @brief The integer sums of a histogram bin of quantized gradient pairs
+   */
+  struct IntPair {
+    int32_t g;
+    int32_t h;
+  };
+
+  /// @brief Sum the gradient and hessian pairs of a partition
+  /// @param gh The gradient and hessian pairs
+  /// @param partition The partition
+  /// @return The sums
+  inline GradientPair sum_gradients(const GradientPair *gh, const DataPartition &partition) {
+    GradientPair sum{ 0.0, 0.0 };
+    for (size_t j = partition.start; j < partition.end; j++) {
+      sum.g += gh[j].g;
+      sum.h += gh[j].h;
+    }
+
+    return sum;
+  }
   
   /**
    * @struct Split
    * @brief Holds data associated with the decision making process in a 
    * TreeBoosterNode
+   *
+   * Missing (NaN) values go left if default_left is set and right otherwise.
+   * Categorical splits have a non-empty cat_bitset instead of a threshold. cat_values
+   * holds the categories of the feature's bins (sorted) and bit b of cat_bitset is set
+   * if bin b goes left, so both are bounded by the number of bins. Everything else
+   * (unseen categories and missing values) goes right
    */
   struct Split {
     int feature;
@@ -53,8 +155,28 @@ namespace CNum::Model::Tree {
     double best_gain;
     int bin;
     SplitValuePair values;
+    bool default_left;
+    std::vector<uint32_t> cat_bitset;
+    std::vector<double> cat_values;
   };
 
+  /// @brief Check whether a value's category bin is set in a categorical split's bitset
+  /// @param split The categorical split
+  /// @param val The value
+  /// @return Whether the value goes left (values that are not one of the split's
+  /// categories, i.e. non-integer ones, go right like unseen categories)
+  inline bool category_in(const Split &split, double val) {
+    if (CNum::Data::is_missing(val))
+      return false;
+
+    auto it = std::lower_bound(split.cat_values.begin(), split.cat_values.end(), val);
+    if (it == split.cat_values.end() || *it != val)
+      return false;
+
+    size_t b = it - split.cat_values.begin();
+    return b / 32 < split.cat_bitset.size() && ((split.cat_bitset[b / 32] >> (b % 32)) & 1);
+  }
+
   /**
    * @enum split_dir
    * @brief Signifies the direction of a node resultant of a split in relation
@@ -65,6 +187,22 @@ namespace CNum::Model::Tree {
     RIGHT
   };
 
+  /**
+   * @enum GrowPolicy
+   * @brief The order the nodes of a tree are grown in (histogram splits only)
+   *
+   * DEPTH_FIRST grows each node's subtree before its sibling's
+   * LEVEL_WISE grows every node of a depth together, building the histograms of the
+   * level in one pass over the bins
+   * LEAF_WISE grows the leaf with the highest split gain first, until the tree has
+   * max_leaves leaves
+   */
+  enum GrowPolicy {
+    DEPTH_FIRST,
+    LEVEL_WISE,
+    LEAF_WISE
+  };
+
   class TreeBoosterNode;
   class TreeBooster;
   class XGTreeBooster;
@@ -6,6 +6,9 @@
 #include "CNum/Model/Tree/TreeBooster.h"
 #include "CNum/Model/Tree/TreeDefs.h"
 
+#include <vector>
+#include <future>
+
 namespace CNum::Model::Tree {
   /**
    * @class XGTreeBooster
@@ -15,8 +18,7 @@ namespace CNum::Model::Tree {
   private:
     /// @brief Exact Greedy Tree Building
     virtual void fit_node_greedy(const CNum::DataStructs::Matrix<double> &X,
-				 double *g,
-				 double *h,
+				 GradientPair *gh,
 				 TreeBoosterNode *node,
 				 int depth = 0) override;
 
@@ -25,44 +27,145 @@ namespace CNum::Model::Tree {
     /// A recursive tree building process modeled after Chen & Guestrin's approach in XGBoost
     /// @param X The dataset
     /// @param shelves The bins and values associated with their boundaries
-    /// @param g The gradient array
-    /// @param h The hessian array
+    /// @param gh The gradient and hessian pairs
     /// @param partition The partition of the node's slice of the dataset
     /// @param parent_hist_view The view of the histograms associated with
     /// node's slice of the dataset
     /// @param node The node
     /// @param depth The depth of the node
-    virtual void fit_node_hist(const CNum::DataStructs::Matrix<int> &X,
+    virtual void fit_node_hist(const CNum::DataStructs::Matrix<uint8_t> &X,
+			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			       GradientPair *gh,
+			       DataPartition &partition,
+			       const arena_view_t &parent_hist_view,
+			       TreeBoosterNode *node,
+			       int depth = 0) override;
+
+    /// @brief Histogram Tree Building on two-byte bins
+    /// @see fit_node_hist
+    virtual void fit_node_hist(const CNum::DataStructs::Matrix<uint16_t> &X,
+			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			       GradientPair *gh,
+			       DataPartition &partition,
+			       const arena_view_t &parent_hist_view,
+			       TreeBoosterNode *node,
+			       int depth = 0) override;
+
+    /// @brief Histogram Tree Building on sparse (CSR) bins
+    /// @see fit_node_hist
+    virtual void fit_node_hist(const CNum::DataStructs::SparseMatrix<uint8_t> &X,
 			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
-			       double *g,
-			       double *h,
+			       GradientPair *gh,
 			       DataPartition &partition,
 			       const arena_view_t &parent_hist_view,
 			       TreeBoosterNode *node,
 			       int depth = 0) override;
 
+    /// @brief Histogram Tree Building on bundled bins
+    /// @see fit_node_hist
+    virtual void fit_node_hist(const CNum::Data::BundledBins &X,
+			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			       GradientPair *gh,
+			       DataPartition &partition,
+			       const arena_view_t &parent_hist_view,
+			       TreeBoosterNode *node,
+			       int depth = 0) override;
+
+    /// @brief The histogram tree building shared by the dense and sparse bins
+    ///
+    /// Nodes with enough rows spread their split searches over the ThreadPool. The
+    /// subtrees of smaller nodes are built as tasks of their own (their partitions are
+    /// disjoint) with serial split searches, so deep trees keep the pool busy without
+    /// a round of task submissions per node
+    /// @param arena The arena the histograms are allocated in
+    /// @param subtrees Where the subtree tasks are collected (nullptr to build the
+    /// whole subtree serially)
+    /// @see fit_node_hist
+    template <typename MatrixT>
+    void fit_node_hist_impl(const MatrixT &X,
+			    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			    GradientPair *gh,
+			    DataPartition &partition,
+			    const arena_view_t &parent_hist_view,
+			    TreeBoosterNode *node,
+			    int depth,
+			    arena_t *arena,
+			    ::std::vector< ::std::future<void> > *subtrees);
+
+    /// @brief Level-wise histogram tree building
+    ///
+    /// Every node of a depth is split, then the histograms of the smaller child of each
+    /// split are built in one pass over the bins and the larger children's histograms
+    /// are found by histogram subtraction
+    /// @param root_partition The partition of the root's slice of the dataset
+    /// @param root_hist_view The view of the root's histograms
+    /// @see fit_node_hist
+    template <typename MatrixT>
+    void fit_level_wise(const MatrixT &X,
+			std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			GradientPair *gh,
+			DataPartition &root_partition,
+			const arena_view_t &root_hist_view);
+
+    /// @brief Leaf-wise (best-first) histogram tree building
+    ///
+    /// The leaves that can be split wait in a priority queue keyed by their best split's
+    /// gain (ties go to the leaf that was queued first) and keep their histograms, so
+    /// the larger child of the leaf that is split next is found by histogram subtraction
+    /// @see fit_level_wise
+    template <typename MatrixT>
+    void fit_leaf_wise(const MatrixT &X,
+		       std::shared_ptr<CNum::Data::Shelf[]> shelves,
+		       GradientPair *gh,
+		       DataPartition &root_partition,
+		       const arena_view_t &root_hist_view);
+
     /// @brief Preperation for histogram tree build
     /// @param X The dataset
     /// @param shelves The bins and values associated with their boundaries
-    /// @param g The gradient array
-    /// @param h The hessian array
+    /// @param gh The gradient and hessian pairs
     /// @param partition The partition of the node's slice of the dataset
-    virtual void fit_prep(const CNum::DataStructs::Matrix<int> &X,
+    virtual void fit_prep(const CNum::DataStructs::Matrix<uint8_t> &X,
 			  std::shared_ptr<CNum::Data::Shelf[]> shelves,
-			  double *g,
-			  double *h,
+			  GradientPair *gh,
 			  DataPartition &partition) override;
 
+    /// @brief Preperation for histogram tree build on two-byte bins
+    /// @see fit_prep
+    virtual void fit_prep(const CNum::DataStructs::Matrix<uint16_t> &X,
+			  std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			  GradientPair *gh,
+			  DataPartition &partition) override;
+
+    /// @brief Preperation for histogram tree build on sparse (CSR) bins
+    /// @see fit_prep
+    virtual void fit_prep(const CNum::DataStructs::SparseMatrix<uint8_t> &X,
+			  std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			  GradientPair *gh,
+			  DataPartition &partition) override;
+
+    /// @brief Preperation for histogram tree build on bundled bins
+    /// @see fit_prep
+    virtual void fit_prep(const CNum::Data::BundledBins &X,
+			  std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			  GradientPair *gh,
+			  DataPartition &partition) override;
+
+    /// @brief The histogram tree building preperation shared by the dense and sparse bins
+    template <typename MatrixT>
+    void fit_prep_hist(const MatrixT &X,
+		       std::shared_ptr<CNum::Data::Shelf[]> shelves,
+		       GradientPair *gh,
+		       DataPartition &partition);
+
     /// @brief Preperation for exact greedy tree build
     /// @param X The dataset
     /// @param shelves The bins and values associated with their boundaries
-    /// @param g The gradient array
-    /// @param h The hessian array
+    /// @param gh The gradient and hessian pairs
     /// @param partition The partition of the node's slice of the dataset
     virtual void fit_prep(const CNum::DataStructs::Matrix<double> &X,
 			  std::shared_ptr<CNum::Data::Shelf[]> shelves,
-			  double *g,
-			  double *h,
+			  GradientPair *gh,
 			  DataPartition &partition) override;
   
   public:
@@ -85,13 +188,11 @@ namespace CNum::Model::Tree {
     /// @brief Unified fit function
     /// @param X The dataset
     /// @param shelves The bins and values associated with their boundaries
-    /// @param g The gradient array
-    /// @param h The hessian array
+    /// @param gh The gradient and hessian pairs
     /// @param partition The partition of the node's slice of the dataset
-    virtual void fit(DataMatrix &X,
+    virtual void fit(const DataMatrix &X,
 		     std::shared_ptr<CNum::Data::Shelf[]> shelves,
-		     double *g,
-		     double *h,
+		     GradientPair *gh,
 		     DataPartition &partition) override;
   };
 };
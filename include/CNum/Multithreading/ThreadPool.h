@@ -59,6 +59,10 @@ namespace CNum::Multithreading {
     /// @return The worker id
     static int get_worker_id();
 
+    /// @brief Get the number of worker threads in the pool
+    /// @return The number of worker threads
+    int get_num_threads() const;
+
     /// @brief Destructor
     ~ThreadPool();
   
@@ -72,7 +76,8 @@ namespace CNum::Multithreading {
     
     /// @brief Submit a task to the ThreadPool
     /// @param f The task
-    /// @return A future that will contain whatever the task returns
+    /// @return A future that will contain whatever the task returns (or the
+    /// exception it threw)
     template<typename T>
     std::future<T> submit(std::function< T(arena_t *arena) > f) {
       if (_is_shutdown.load(::std::memory_order_acquire))
@@ -81,12 +86,18 @@ namespace CNum::Multithreading {
       auto p = std::make_shared< std::promise<T> >();
       std::future<T> fut = p->get_future();
   
+      // exceptions thrown by a task are forwarded to its future instead of
+      // terminating the worker
       auto func = [p, f] (arena_t *arena) mutable {
-	if constexpr (std::is_void_v<T>) {
-	  f(arena);
-	  p->set_value();
-	} else {
-	  p->set_value(f(arena));
+	try {
+	  if constexpr (std::is_void_v<T>) {
+	    f(arena);
+	    p->set_value();
+	  } else {
+	    p->set_value(f(arena));
+	  }
+	} catch (...) {
+	  p->set_exception(::std::current_exception());
 	}
       };
   
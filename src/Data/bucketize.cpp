@@ -0,0 +1,142 @@
+#include "CNum/Data/Bucketize.h"
+
+#include <limits>
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BUCKETIZE_AVX2
+#include <immintrin.h>
+#endif
+
+namespace CNum::Data {
+  /// @brief The number of values searched at once
+  constexpr size_t bucketize_lanes = 8;
+
+  Bucketizer::Bucketizer(const double *boundaries, size_t n_boundaries, size_t missing_bin)
+    : _table_size(1), _n_boundaries(n_boundaries), _missing_bin(missing_bin) {
+    while (_table_size < n_boundaries + 1)
+      _table_size <<= 1;
+
+    // NaN never compares less than or equal to a value so the padding is never
+    // counted (not even for +inf) and NaN values end the search in bin 0
+    _table = ::std::make_unique<double[]>(_table_size);
+    ::std::copy(boundaries, boundaries + n_boundaries, _table.get());
+    ::std::fill(_table.get() + n_boundaries,
+		_table.get() + _table_size,
+		::std::numeric_limits<double>::quiet_NaN());
+  }
+
+  size_t Bucketizer::get_n_bins() const { return _n_boundaries + 1; }
+
+#ifdef BUCKETIZE_AVX2
+  /// @brief Search 8 values per iteration with AVX2 gathers
+  /// @return The number of values that were bucketized
+  template <typename BinT>
+  __attribute__((target("avx2")))
+  static size_t bucketize_avx2(const double *table,
+			       size_t table_size,
+			       size_t missing_bin,
+			       const double *vals,
+			       size_t n,
+			       size_t in_stride,
+			       BinT *out,
+			       size_t out_stride) {
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i missing = _mm256_set1_epi64x(static_cast<int64_t>(missing_bin));
+    const __m256i abs_bits = _mm256_set1_epi64x(static_cast<int64_t>(abs_mask));
+    const __m256i inf = _mm256_set1_epi64x(static_cast<int64_t>(inf_bits));
+    alignas(32) int64_t lanes[bucketize_lanes];
+    size_t i{ 0 };
+
+    for (; i + bucketize_lanes <= n; i += bucketize_lanes) {
+      const double *v_ptr = vals + i * in_stride;
+      __m256d v_lo, v_hi;
+
+      if (in_stride == 1) {
+	v_lo = _mm256_loadu_pd(v_ptr);
+	v_hi = _mm256_loadu_pd(v_ptr + 4);
+      } else {
+	v_lo = _mm256_set_pd(v_ptr[3 * in_stride], v_ptr[2 * in_stride], v_ptr[in_stride], v_ptr[0]);
+	v_hi = _mm256_set_pd(v_ptr[7 * in_stride], v_ptr[6 * in_stride], v_ptr[5 * in_stride], v_ptr[4 * in_stride]);
+      }
+
+      // two independent search chains to hide the gather latency
+      __m256i idx_lo = _mm256_setzero_si256();
+      __m256i idx_hi = _mm256_setzero_si256();
+
+      for (size_t step = table_size >> 1; step > 0; step >>= 1) {
+	__m256i step_v = _mm256_set1_epi64x(static_cast<int64_t>(step));
+	__m256i offset = _mm256_sub_epi64(step_v, one);
+
+	__m256d t_lo = _mm256_i64gather_pd(table, _mm256_add_epi64(idx_lo, offset), 8);
+	__m256d t_hi = _mm256_i64gather_pd(table, _mm256_add_epi64(idx_hi, offset), 8);
+
+	__m256i le_lo = _mm256_castpd_si256(_mm256_cmp_pd(t_lo, v_lo, _CMP_LE_OQ));
+	__m256i le_hi = _mm256_castpd_si256(_mm256_cmp_pd(t_hi, v_hi, _CMP_LE_OQ));
+
+	idx_lo = _mm256_add_epi64(idx_lo, _mm256_and_si256(le_lo, step_v));
+	idx_hi = _mm256_add_epi64(idx_hi, _mm256_and_si256(le_hi, step_v));
+      }
+
+      // same bit test as is_missing
+      __m256i nan_lo = _mm256_cmpgt_epi64(_mm256_and_si256(_mm256_castpd_si256(v_lo), abs_bits), inf);
+      __m256i nan_hi = _mm256_cmpgt_epi64(_mm256_and_si256(_mm256_castpd_si256(v_hi), abs_bits), inf);
+      idx_lo = _mm256_blendv_epi8(idx_lo, missing, nan_lo);
+      idx_hi = _mm256_blendv_epi8(idx_hi, missing, nan_hi);
+
+      _mm256_store_si256((__m256i *) lanes, idx_lo);
+      _mm256_store_si256((__m256i *) (lanes + 4), idx_hi);
+
+      for (size_t k = 0; k < bucketize_lanes; k++)
+	out[(i + k) * out_stride] = static_cast<BinT>(lanes[k]);
+    }
+
+    return i;
+  }
+
+  /// @brief Whether or not the CPU supports AVX2 (checked once)
+  static bool cpu_has_avx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+  }
+#endif
+
+  template <typename BinT>
+  void Bucketizer::bucketize(const double *vals,
+			     size_t n,
+			     size_t in_stride,
+			     BinT *out,
+			     size_t out_stride) const {
+    const double *table = _table.get();
+    size_t i{ 0 };
+
+#ifdef BUCKETIZE_AVX2
+    if (cpu_has_avx2())
+      i = bucketize_avx2(table, _table_size, _missing_bin, vals, n, in_stride, out, out_stride);
+#endif
+
+    // portable path, the lanes are independent so the searches are interleaved
+    for (; i + bucketize_lanes <= n; i += bucketize_lanes) {
+      double v[bucketize_lanes];
+      size_t idx[bucketize_lanes] = { 0 };
+
+      for (size_t k = 0; k < bucketize_lanes; k++)
+	v[k] = vals[(i + k) * in_stride];
+
+      for (size_t step = _table_size >> 1; step > 0; step >>= 1) {
+	for (size_t k = 0; k < bucketize_lanes; k++)
+	  idx[k] += table[idx[k] + step - 1] <= v[k] ? step : 0;
+      }
+
+      for (size_t k = 0; k < bucketize_lanes; k++)
+	out[(i + k) * out_stride] = static_cast<BinT>(is_missing(v[k]) ? _missing_bin : idx[k]);
+    }
+
+    for (; i < n; i++)
+      out[i * out_stride] = static_cast<BinT>(bucketize(vals[i * in_stride]));
+  }
+
+  template void Bucketizer::bucketize<uint8_t>(const double *, size_t, size_t, uint8_t *, size_t) const;
+  template void Bucketizer::bucketize<uint16_t>(const double *, size_t, size_t, uint16_t *, size_t) const;
+  template void Bucketizer::bucketize<int>(const double *, size_t, size_t, int *, size_t) const;
+};
@@ -0,0 +1,203 @@
+#include "CNum/Data/Data.h"
+
+#include <numeric>
+
+using namespace CNum::DataStructs;
+
+namespace CNum::Data {
+  BundledBins::BundledBins(const Matrix<uint8_t> &bins,
+			   const Shelf *shelves,
+			   size_t max_search)
+    : _n_rows(bins.get_cols()) {
+    constexpr size_t max_bundle_bins = 256;
+    size_t n_features = bins.get_rows();
+    size_t n_words = (_n_rows + 63) / 64;
+    const uint8_t *ptr = bins.begin();
+
+    _bundle_of.resize(n_features);
+    _offset.assign(n_features, 0);
+    _default_bin.resize(n_features);
+
+    // the non-default bins each feature uses (only these take up space in a bundle)
+    ::std::vector< ::std::vector<uint8_t> > used(n_features);
+    ::std::vector<size_t> nnz(n_features);
+    for (size_t f = 0; f < n_features; f++) {
+      const uint8_t *row = ptr + f * _n_rows;
+      uint8_t d = shelves[f].bin_of(0.0);
+      ::std::array<size_t, max_bundle_bins> counts{};
+
+      for (size_t r = 0; r < _n_rows; r++)
+	counts[row[r]]++;
+
+      for (size_t b = 0; b < max_bundle_bins; b++) {
+	if (b != d && counts[b] > 0)
+	  used[f].push_back(b);
+      }
+
+      _default_bin[f] = d;
+      nnz[f] = _n_rows - counts[d];
+    }
+
+    // greedily bundle the features, most nonzeros first
+    ::std::vector<size_t> order(n_features);
+    ::std::iota(order.begin(), order.end(), 0);
+    ::std::stable_sort(order.begin(), order.end(), [&] (size_t a, size_t b) { return nnz[a] > nnz[b]; });
+
+    ::std::vector< ::std::vector<size_t> > groups;
+    ::std::vector< ::std::vector<uint64_t> > occupied;
+    ::std::vector<size_t> used_bins;
+    ::std::vector<size_t> open;
+    ::std::vector<size_t> nonzero_rows;
+
+    for (size_t f: order) {
+      // dense features and features with too many bins get a column of their own
+      if (2 * nnz[f] > _n_rows || used[f].size() + 1 >= max_bundle_bins) {
+	groups.push_back({ f });
+	occupied.emplace_back();
+	used_bins.push_back(max_bundle_bins);
+	continue;
+      }
+
+      const uint8_t *row = ptr + f * _n_rows;
+      nonzero_rows.clear();
+      for (size_t r = 0; r < _n_rows; r++) {
+	if (row[r] != _default_bin[f])
+	  nonzero_rows.push_back(r);
+      }
+
+      bool placed{ false };
+      for (auto it = open.rbegin(); it != open.rend() && !placed; it++) {
+	size_t g = *it;
+	if (used_bins[g] + used[f].size() > max_bundle_bins)
+	  continue;
+
+	auto &bits = occupied[g];
+	bool conflict = ::std::any_of(nonzero_rows.begin(), nonzero_rows.end(), [&] (size_t r) {
+	  return (bits[r / 64] >> (r % 64)) & 1;
+	});
+
+	if (conflict)
+	  continue;
+
+	for (size_t r: nonzero_rows)
+	  bits[r / 64] |= uint64_t{ 1 } << (r % 64);
+
+	groups[g].push_back(f);
+	used_bins[g] += used[f].size();
+	placed = true;
+      }
+
+      if (placed)
+	continue;
+
+      groups.push_back({ f });
+      occupied.emplace_back(n_words, 0);
+      used_bins.push_back(1 + used[f].size());
+      for (size_t r: nonzero_rows)
+	occupied.back()[r / 64] |= uint64_t{ 1 } << (r % 64);
+
+      // only the most recent bundles are searched, the rest are closed
+      open.push_back(groups.size() - 1);
+      if (open.size() > max_search) {
+	occupied[open.front()] = ::std::vector<uint64_t>();
+	open.erase(open.begin());
+      }
+    }
+
+    // a feature in a bundle stores the k-th bin it uses as offset + k, bin value 0 of
+    // a bundle means every feature is in its default bin. A feature with a column of
+    // its own stores its bins unchanged
+    size_t n_bundles = groups.size();
+    _bundle_starts.reserve(n_bundles + 1);
+    _bundle_starts.push_back(0);
+    _features.reserve(n_features);
+    _code_starts.assign(n_features + 1, 0);
+
+    for (size_t g = 0; g < n_bundles; g++) {
+      size_t offset = groups[g].size() > 1 ? 1 : 0;
+      for (size_t f: groups[g]) {
+	if (groups[g].size() == 1) {
+	  used[f].resize(shelves[f].num_bins);
+	  ::std::iota(used[f].begin(), used[f].end(), 0);
+	}
+
+	_bundle_of[f] = g;
+	_offset[f] = offset;
+	_features.push_back(f);
+	offset += used[f].size();
+      }
+
+      _bundle_starts.push_back(_features.size());
+    }
+
+    for (size_t f = 0; f < n_features; f++)
+      _code_starts[f + 1] = _code_starts[f] + used[f].size();
+
+    _codes.reserve(_code_starts.back());
+    for (size_t f = 0; f < n_features; f++)
+      _codes.insert(_codes.end(), used[f].begin(), used[f].end());
+
+    if (n_bundles == n_features)
+      return;
+
+    auto bundled = ::std::make_unique<uint8_t[]>(n_bundles * _n_rows);
+    for (size_t g = 0; g < n_bundles; g++) {
+      uint8_t *out = bundled.get() + g * _n_rows;
+
+      if (groups[g].size() == 1) {
+	::std::copy(ptr + groups[g][0] * _n_rows, ptr + (groups[g][0] + 1) * _n_rows, out);
+	continue;
+      }
+
+      for (size_t f: groups[g]) {
+	::std::array<uint8_t, max_bundle_bins> code_of{};
+	for (size_t k = 0; k < used[f].size(); k++)
+	  code_of[used[f][k]] = _offset[f] + k;
+
+	const uint8_t *row = ptr + f * _n_rows;
+	for (size_t r = 0; r < _n_rows; r++) {
+	  if (row[r] != _default_bin[f])
+	    out[r] = code_of[row[r]];
+	}
+      }
+    }
+
+    _bins = Matrix<uint8_t>(n_bundles, _n_rows, ::std::move(bundled));
+  }
+
+  void BundledBins::unbundle(size_t feature,
+			     const GradientPair *bundle_bins,
+			     double gs,
+			     double hs,
+			     GradientPair *bins,
+			     size_t n_bins) const {
+    const uint8_t *codes = _codes.data() + _code_starts[feature];
+    size_t n_codes = _code_starts[feature + 1] - _code_starts[feature];
+    size_t offset = _offset[feature];
+
+    ::std::fill(bins, bins + n_bins, GradientPair{ 0.0, 0.0 });
+    for (size_t k = 0; k < n_codes; k++)
+      bins[codes[k]] = bundle_bins[offset + k];
+
+    if (get_bundle_features(_bundle_of[feature]).size() == 1)
+      return;
+
+    // the default bin is never stored, it holds what is left of the node totals
+    size_t d = _default_bin[feature];
+    double g_rest{ 0.0 }, h_rest{ 0.0 };
+    for (size_t b = 0; b < n_bins; b++) {
+      g_rest += bins[b].g;
+      h_rest += bins[b].h;
+    }
+
+    bins[d] = { gs - g_rest, hs - h_rest };
+  }
+
+  const Matrix<uint8_t> &BundledBins::get_bins() const { return _bins; }
+
+  size_t BundledBins::get_features() const { return _bundle_of.size(); }
+
+  size_t BundledBins::get_bundles() const { return _bundle_starts.empty() ? 0 : _bundle_starts.size() - 1; }
+
+  size_t BundledBins::get_rows() const { return _n_rows; }
+};
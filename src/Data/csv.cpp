@@ -0,0 +1,145 @@
+#include "CNum/Data/CSV.h"
+
+#include <charconv>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <string_view>
+#include <algorithm>
+
+namespace CNum::Data {
+  /// @brief Whether or not a character is insignificant whitespace in a field
+  static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+  }
+
+  const char *csv_next_line(const char *ptr, const char *end) {
+    const char *nl = (const char *) ::std::memchr(ptr, '\n', end - ptr);
+    return nl == nullptr ? end : nl + 1;
+  }
+
+  bool csv_line_is_blank(const char *begin, const char *end) {
+    return ::std::all_of(begin, end, is_space);
+  }
+
+  const char *csv_skip_lines(const char *begin, const char *end, size_t n_lines) {
+    for (size_t i = 0; i < n_lines && begin < end; i++) {
+      begin = csv_next_line(begin, end);
+    }
+
+    return begin;
+  }
+
+  size_t csv_count_cols(const char *begin, const char *end, char separator) {
+    while (begin < end) {
+      const char *nl = (const char *) ::std::memchr(begin, '\n', end - begin);
+      const char *line_end = nl == nullptr ? end : nl;
+
+      if (!csv_line_is_blank(begin, line_end)) {
+	return ::std::count(begin, line_end, separator) + 1;
+      }
+
+      begin = nl == nullptr ? end : nl + 1;
+    }
+
+    return 0;
+  }
+
+  size_t csv_label_idx(const CSVOptions &options, size_t n_cols) {
+    if (!options.has_labels)
+      return n_cols;
+
+    long idx = options.label_col < 0 ? static_cast<long>(n_cols) + options.label_col : options.label_col;
+    if (idx < 0 || idx >= static_cast<long>(n_cols)) {
+      throw ::std::invalid_argument("CSV error - Label column " + ::std::to_string(options.label_col) +
+				    " out of bounds for a file with " + ::std::to_string(n_cols) + " columns");
+    }
+
+    return static_cast<size_t>(idx);
+  }
+
+  size_t csv_count_rows(const char *begin, const char *end) {
+    size_t n_rows{ 0 };
+
+    while (begin < end) {
+      const char *nl = (const char *) ::std::memchr(begin, '\n', end - begin);
+      const char *line_end = nl == nullptr ? end : nl;
+
+      // the blank check stops at the first significant character
+      if (!csv_line_is_blank(begin, line_end))
+	n_rows++;
+
+      begin = nl == nullptr ? end : nl + 1;
+    }
+
+    return n_rows;
+  }
+
+  double csv_parse_field(const char *begin, const char *end, const CSVOptions &options) {
+    while (begin < end && is_space(*begin)) begin++;
+    while (end > begin && is_space(end[-1])) end--;
+
+    ::std::string_view field(begin, end - begin);
+    for (const auto &token: options.nan_tokens) {
+      if (field == token)
+	return ::std::numeric_limits<double>::quiet_NaN();
+    }
+
+    if (begin < end && *begin == '+')
+      begin++;
+
+    double val{ 0.0 };
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    auto [ptr, ec] = ::std::from_chars(begin, end, val);
+    bool ok = ec == ::std::errc() && ptr == end && begin < end;
+#else
+    // fallback for standard libraries without floating point from_chars
+    ::std::string buf(begin, end);
+    char *ptr = nullptr;
+    val = ::std::strtod(buf.c_str(), &ptr);
+    bool ok = !buf.empty() && ptr == buf.c_str() + buf.size();
+#endif
+
+    if (!ok) {
+      throw ::std::runtime_error("CSV error - Error converting \"" + ::std::string(field) + "\" to double");
+    }
+
+    return val;
+  }
+
+  void csv_parse_row(const char *begin,
+		     const char *end,
+		     size_t n_cols,
+		     size_t label_idx,
+		     const CSVOptions &options,
+		     double *x_out,
+		     double *y_out) {
+    const char *field_begin = begin;
+
+    for (size_t c = 0; c < n_cols; c++) {
+      const char *field_end = (const char *) ::std::memchr(field_begin, options.separator, end - field_begin);
+
+      if (field_end == nullptr) {
+	if (c != n_cols - 1) {
+	  throw ::std::runtime_error("CSV error - Expected " + ::std::to_string(n_cols) +
+				     " columns but found " + ::std::to_string(c + 1) +
+				     " in line \"" + ::std::string(begin, end) + "\"");
+	}
+
+	field_end = end;
+      } else if (c == n_cols - 1) {
+	throw ::std::runtime_error("CSV error - Expected " + ::std::to_string(n_cols) +
+				   " columns but found more in line \"" + ::std::string(begin, end) + "\"");
+      }
+
+      double val = csv_parse_field(field_begin, field_end, options);
+      if (c == label_idx)
+	*y_out = val;
+      else
+	*x_out++ = val;
+
+      field_begin = field_end + 1;
+    }
+  }
+};
@@ -1,51 +1,190 @@
 #include "CNum/Data/Data.h"
 
+#include <limits>
+#include <unordered_map>
+#include <cmath>
+
 using namespace CNum::DataStructs;
 
 namespace CNum::Data {
   std::array< Matrix<double>, 2 > get_data(std::string data_path, char seperator) {
-    std::ifstream is(data_path);
+    CSVOptions options;
+    options.separator = seperator;
   
-    if (!is.is_open()) {
-      throw ::std::runtime_error("Get data error - Failed to open file");
+    return read_csv(data_path, options);
+  }
+
+  /**
+   * @struct CSVChunk
+   * @brief A slice of a mapped file that is parsed by a single task
+   */
+  struct CSVChunk {
+    const char *begin;
+    const char *end;
+    size_t first_row;
+    size_t n_rows;
+  };
+
+  std::array< Matrix<double>, 2 > read_csv(const std::string &data_path, const CSVOptions &options) {
+    MappedFile file(data_path);
+    file.advise_sequential();
+
+    const char *begin = csv_skip_lines(file.begin(), file.end(), options.header_rows);
+    const char *end = file.end();
+
+    size_t n_cols = csv_count_cols(begin, end, options.separator);
+    if (n_cols == 0) {
+      throw ::std::runtime_error("Get data error - No rows found in file: " + data_path);
+    }
+
+    size_t label_idx = csv_label_idx(options, n_cols);
+    size_t x_cols = options.has_labels ? n_cols - 1 : n_cols;
+
+    // split at newline boundaries
+    auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+    size_t chunk_bytes = ::std::max<size_t>(options.chunk_bytes, 1);
+    std::vector<CSVChunk> chunks;
+    chunks.reserve((end - begin) / chunk_bytes + 1);
+
+    for (const char *chunk_begin = begin; chunk_begin < end;) {
+      const char *chunk_end = chunk_begin + ::std::min<size_t>(chunk_bytes, end - chunk_begin);
+      if (chunk_end < end && chunk_end[-1] != '\n')
+	chunk_end = csv_next_line(chunk_end, end);
+
+      chunks.push_back({ chunk_begin, chunk_end, 0, 0 });
+      chunk_begin = chunk_end;
+    }
+
+    // count the rows of each chunk so every chunk knows where its rows go
+    std::vector< std::future<size_t> > counts;
+    counts.reserve(chunks.size());
+    for (auto &chunk: chunks) {
+      counts.push_back(tp->submit< size_t >([&chunk] (arena_t *arena) {
+	return csv_count_rows(chunk.begin, chunk.end);
+      }));
+    }
+
+    size_t n_rows{ 0 };
+    for (size_t i = 0; i < chunks.size(); i++) {
+      chunks[i].first_row = n_rows;
+      chunks[i].n_rows = counts[i].get();
+      n_rows += chunks[i].n_rows;
     }
 
     std::array< Matrix<double>, 2 > data;
-    std::vector<double> X;
-    std::vector<double> y;
-
-    std::string line;
-    getline(is, line, '\n');
-    int X_cols = std::count(line.begin(), line.end(), seperator);
-
-    do {
-      std::stringstream ss(line);
-      std::string segment;
-
-      for (int i = 0; i < X_cols; i++) {
-	getline(ss, segment, seperator);
-	try {
-	  X.push_back(stof(segment));
-	} catch(...) {
-	  std::cout << "Error converting " << segment << " to float" << std::endl;
+    data[0] = Matrix<double>(n_rows, x_cols);
+    data[1] = Matrix<double>(options.has_labels ? n_rows : 0, options.has_labels ? 1 : 0);
+
+    double *X_ptr = data[0].begin();
+    double *y_ptr = data[1].begin();
+
+    // parse each chunk directly into its slice of the matrices
+    std::vector< std::future<void> > workers;
+    workers.reserve(chunks.size());
+    for (auto &chunk: chunks) {
+      workers.push_back(tp->submit< void >([&, X_ptr, y_ptr] (arena_t *arena) {
+	double *x_out = X_ptr + chunk.first_row * x_cols;
+	double *y_out = options.has_labels ? y_ptr + chunk.first_row : nullptr;
+	double unused_label;
+
+	for (const char *line = chunk.begin; line < chunk.end;) {
+	  const char *nl = (const char *) ::std::memchr(line, '\n', chunk.end - line);
+	  const char *line_end = nl == nullptr ? chunk.end : nl;
+
+	  if (!csv_line_is_blank(line, line_end)) {
+	    csv_parse_row(line, line_end, n_cols, label_idx, options,
+			  x_out, y_out == nullptr ? &unused_label : y_out);
+	    x_out += x_cols;
+	    if (y_out != nullptr)
+	      y_out++;
+	  }
+
+	  line = nl == nullptr ? chunk.end : nl + 1;
 	}
+      }));
+    }
+
+    // wait for every task before rethrowing so no task outlives the mapping
+    ::std::exception_ptr err = nullptr;
+    for (auto &w: workers) {
+      try {
+	w.get();
+      } catch (...) {
+	if (err == nullptr)
+	  err = ::std::current_exception();
       }
+    }
 
-      getline(ss, segment, seperator);
-      y.push_back(stod(segment));
-    
-    } while (getline(is, line, '\n'));
-  
-    is.close();
+    if (err != nullptr) {
+      try {
+	::std::rethrow_exception(err);
+      } catch (const ::std::exception &e) {
+	throw ::std::runtime_error(::std::string("Get data error - ") + e.what());
+      }
+    }
 
-    auto X_ptr = std::make_unique<double[]>(X.size());
-    auto y_ptr = std::make_unique<double[]>(y.size());
+    return data;
+  }
 
-    std::copy(X.begin(), X.end(), X_ptr.get());
-    std::copy(y.begin(), y.end(), y_ptr.get());
+  void write_binary(const std::string &data_path, const Matrix<double> &X, const Matrix<double> &y) {
+    bool has_labels = y.get_rows() > 0;
+    if (has_labels && (y.get_rows() != X.get_rows() || y.get_cols() != 1)) {
+      throw ::std::invalid_argument("Write binary error - Labels must have shape=(n,1) with the same number of rows as the data");
+    }
 
-    data[0] = Matrix<double>(y.size(), X_cols, std::move(X_ptr));
-    data[1] = Matrix<double>(y.size(), 1, std::move(y_ptr));
+    std::ofstream of(data_path, std::ios::binary);
+    if (!of.is_open()) {
+      throw ::std::runtime_error("Write binary error - Failed to open file: " + data_path);
+    }
+
+    BinaryHeader header;
+    ::std::memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    header.n_rows = X.get_rows();
+    header.n_cols = X.get_cols();
+    header.has_labels = has_labels ? 1 : 0;
+
+    of.write((const char *) &header, sizeof(BinaryHeader));
+    of.write((const char *) X.begin(), sizeof(double) * X.get_rows() * X.get_cols());
+    if (has_labels)
+      of.write((const char *) y.begin(), sizeof(double) * y.get_rows());
+
+    if (!of.good()) {
+      throw ::std::runtime_error("Write binary error - Failed to write file: " + data_path);
+    }
+  }
+
+  BinaryHeader read_binary_header(const MappedFile &file, const std::string &data_path) {
+    BinaryHeader header;
+    if (file.size() < sizeof(BinaryHeader)) {
+      throw ::std::runtime_error("Read binary error - File is too small to be a CNum binary file: " + data_path);
+    }
+
+    ::std::memcpy(&header, file.begin(), sizeof(BinaryHeader));
+    size_t expected_size = sizeof(BinaryHeader) +
+      sizeof(double) * header.n_rows * (header.n_cols + (header.has_labels ? 1 : 0));
+
+    if (!header.is_valid() || file.size() < expected_size) {
+      throw ::std::runtime_error("Read binary error - Invalid CNum binary file: " + data_path);
+    }
+
+    return header;
+  }
+
+  std::array< Matrix<double>, 2 > read_binary(const std::string &data_path) {
+    MappedFile file(data_path);
+    file.advise_sequential();
+    BinaryHeader header = read_binary_header(file, data_path);
+
+    const double *X_src = (const double *) (file.begin() + sizeof(BinaryHeader));
+    std::array< Matrix<double>, 2 > data;
+    data[0] = Matrix<double>(header.n_rows, header.n_cols);
+    data[1] = Matrix<double>(header.has_labels ? header.n_rows : 0, header.has_labels ? 1 : 0);
+
+    ::std::copy(X_src, X_src + header.n_rows * header.n_cols, data[0].begin());
+    if (header.has_labels)
+      ::std::copy(X_src + header.n_rows * header.n_cols,
+		  X_src + header.n_rows * (header.n_cols + 1),
+		  data[1].begin());
   
     return data;
   }
@@ -95,89 +234,393 @@ namespace CNum::Data {
   }
 
   
-  std::shared_ptr<Shelf[]> quantile_bin(const Matrix<double> &data, size_t num_bins) {
-    auto shelves = uniform_bin(data, num_bins);
-    std::shared_ptr<Shelf[]> new_shelves(new Shelf[data.get_cols()]);
-
-    for (int i = 0; i < data.get_cols(); i++) {
-      new_shelves[i] = Shelf(num_bins);
+  /// @brief The number of rows each sketching task handles
+  constexpr size_t sketch_rows_per_task = 65536;
+
+  /// @brief Sketch every column of a row-major block of data into the accumulated sketches
+  ///
+  /// The rows are split into fixed-size chunks that are sketched in parallel (a wave
+  /// of chunks at a time to bound the memory) and merged into the accumulated sketches
+  /// in chunk order, so the result only depends on the data and not on the number of
+  /// threads
+  /// @param data The data (shape=(n_rows, n_cols))
+  /// @param n_rows The number of rows
+  /// @param n_cols The number of columns
+  /// @param sketches The accumulated sketches (one per column)
+  /// @param n_chunks The number of chunks sketched so far (used to seed the sketches)
+  static void sketch_columns(const double *data,
+			     size_t n_rows,
+			     size_t n_cols,
+			     std::vector<QuantileSketch> &sketches,
+			     size_t &n_chunks) {
+    auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+    size_t wave_size = std::max<size_t>(1, tp->get_num_threads());
     
-      auto cumulative_sum = std::make_unique<int[]>(num_bins);
-      int sum = 0;
+    for (size_t wave_start = 0; wave_start < n_rows; wave_start += wave_size * sketch_rows_per_task) {
+      std::vector< std::future< std::vector<QuantileSketch> > > chunk_workers;
+
+      for (size_t start = wave_start;
+	   start < std::min(n_rows, wave_start + wave_size * sketch_rows_per_task);
+	   start += sketch_rows_per_task) {
+	size_t seed = n_chunks++;
+
+	chunk_workers.push_back(tp->submit< std::vector<QuantileSketch> >([&, start, seed] (arena_t *arena) {
+	  size_t chunk_rows = std::min(sketch_rows_per_task, n_rows - start);
+	  std::vector<QuantileSketch> chunk_sketches;
+	  chunk_sketches.reserve(n_cols);
+
+	  for (size_t i = 0; i < n_cols; i++) {
+	    chunk_sketches.emplace_back(2048, seed);
+	    chunk_sketches[i].insert(data + start * n_cols + i, chunk_rows, n_cols);
+	  }
 
-      for (int j = 0; j < num_bins; j++) {
-	sum += shelves[i].bins[j].ct;
-	cumulative_sum[j] = sum;
+	  return chunk_sketches;
+	}));
       }
 
-      int uni = 0;
-      for (int quant = 0; quant < num_bins - 1; quant++) {
-	double quant_fraction = static_cast<double>(quant) / num_bins;
-	int count = quant_fraction * data.get_rows();
-	while (uni < num_bins - 1 && cumulative_sum[uni] < count) {
-	  uni++;
-	}
+      std::vector< std::vector<QuantileSketch> > chunk_sketches;
+      for (auto &w: chunk_workers) {
+	chunk_sketches.push_back(w.get());
+      }
 
-	double b_low = (uni == 0) ? shelves[i].ranges[0] : shelves[i].ranges[uni - 1];
-	double b_high = (uni >= num_bins - 1) ? shelves[i].ranges[num_bins - 2] + 1e-3 : shelves[i].ranges[uni];
+      std::vector< std::future<void> > merge_workers;
+      merge_workers.reserve(n_cols);
+      for (size_t i = 0; i < n_cols; i++) {
+	merge_workers.push_back(tp->submit< void >([&, i] (arena_t *arena) {
+	  for (auto &chunk: chunk_sketches)
+	    sketches[i].merge(chunk[i]);
+	}));
+      }
       
-	int bin_ct = shelves[i].bins[uni].ct;
-	double r = bin_ct == 0 ? 0 : (static_cast<double>(count - (uni == 0 ? 0 : cumulative_sum[uni - 1])) / bin_ct);
-	double interpolated = b_low + r * (b_high - b_low);
-
-	if (quant > 0) {
-	  double prev = new_shelves[i].ranges[quant - 1];
-	  if (interpolated < prev)
-	    interpolated = prev;
-	}
+      for (auto &w: merge_workers) {
+	w.get();
+      }
+    }
+  }
 
-	new_shelves[i].ranges[quant] = interpolated;
+  /// @brief Build the shelves from the quantiles of the column sketches
+  ///
+  /// Columns with missing values get a missing value bin (the last bin) and one less
+  /// bin for present values. Repeated boundaries (and a boundary at the minimum) would
+  /// only make empty bins, so they are dropped and low-cardinality columns get fewer
+  /// bins (a column with d distinct values gets at most d bins for present values)
+  /// @param sketches The column sketches
+  /// @param num_bins The maximum number of bins per shelf
+  /// @param n_rows The number of rows sketched (to detect missing values)
+  /// @return The shelves (the boundaries are the distinct 1/n, ..., (n - 1)/n quantiles,
+  /// where n is the maximum number of bins for present values)
+  static std::shared_ptr<Shelf[]> shelves_from_sketches(const std::vector<QuantileSketch> &sketches,
+							size_t num_bins,
+							size_t n_rows) {
+    std::shared_ptr<Shelf[]> shelves(new Shelf[sketches.size()]);
+
+    for (size_t i = 0; i < sketches.size(); i++) {
+      bool has_missing = sketches[i].count() < n_rows && num_bins > 2;
+      size_t max_boundaries = num_bins - (has_missing ? 2 : 1);
+
+      // the 0 quantile is the minimum
+      std::vector<double> qs(max_boundaries + 1);
+      for (size_t q = 0; q <= max_boundaries; q++)
+	qs[q] = static_cast<double>(q) / (max_boundaries + 1);
+
+      auto boundaries = sketches[i].quantiles(qs);
+      if (!boundaries.empty()) {
+	boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+	boundaries.erase(boundaries.begin());
       }
+
+      shelves[i] = Shelf(boundaries.size() + (has_missing ? 2 : 1));
+      shelves[i].has_missing = has_missing;
+      std::fill(shelves[i].ranges.get(),
+		shelves[i].ranges.get() + shelves[i].num_bins - 1,
+		std::numeric_limits<double>::infinity());
+      std::copy(boundaries.begin(), boundaries.end(), shelves[i].ranges.get());
     }
 
-    return new_shelves;
+    return shelves;
   }
 
-  
-  Matrix<int> apply_quantile(const Matrix<double> &data, std::shared_ptr<Shelf[]> shelves) {
-    std::vector< Matrix<int> > cols;
-    std::vector< std::future< Matrix<int> > > workers;
-    workers.reserve(data.get_cols());
+  /// @brief Build the category-to-bin dictionary of a categorical column
+  ///
+  /// The num_bins - 1 most frequent categories get a bin each (in order of category),
+  /// the last bin holds missing values and every other category
+  /// @param col The column
+  /// @param n_rows The number of rows
+  /// @param stride The distance between consecutive values (in elements)
+  /// @param num_bins The number of bins
+  /// @return The shelf
+  static Shelf categorical_shelf(const double *col, size_t n_rows, size_t stride, size_t num_bins) {
+    std::unordered_map<double, size_t> counts;
+
+    for (size_t i = 0; i < n_rows; i++) {
+      double val = col[i * stride];
+      if (is_missing(val))
+	continue;
+
+      if (val < 0 || val != std::floor(val) || val > std::numeric_limits<int32_t>::max()) {
+	throw std::invalid_argument("Quantile bin error - Categorical values must be non-negative integers");
+      }
+
+      counts[val]++;
+    }
+
+    std::vector< std::pair<double, size_t> > categories(counts.begin(), counts.end());
+    std::sort(categories.begin(), categories.end(), [] (const auto &a, const auto &b) {
+      return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+
+    categories.resize(std::min(categories.size(), num_bins - 1));
+    std::sort(categories.begin(), categories.end());
+
+    Shelf shelf(categories.size() + 1);
+    shelf.is_categorical = true;
+    for (size_t k = 0; k < categories.size(); k++)
+      shelf.ranges[k] = categories[k].first;
+
+    return shelf;
+  }
+
+  std::shared_ptr<Shelf[]> quantile_bin(const Matrix<double> &data,
+					size_t num_bins,
+					const std::vector<size_t> &categorical) {
+    std::vector<QuantileSketch> sketches(data.get_cols());
+    size_t n_chunks{ 0 };
+
+    sketch_columns(data.begin(), data.get_rows(), data.get_cols(), sketches, n_chunks);
+    auto shelves = shelves_from_sketches(sketches, num_bins, data.get_rows());
+
+    for (size_t i: categorical) {
+      if (i >= data.get_cols()) {
+	throw std::out_of_range("Quantile bin error - Categorical feature index out of range");
+      }
+
+      shelves[i] = categorical_shelf(data.begin() + i, data.get_rows(), data.get_cols(), num_bins);
+    }
+
+    return shelves;
+  }
+
+  std::shared_ptr<Shelf[]> quantile_bin(const SparseMatrix<double> &data, size_t num_bins) {
+    constexpr size_t cols_per_task = 16;
+    // only copy the data if it has to be converted
+    SparseMatrix<double> converted;
+    if (data.get_format() != CSC)
+      converted = data.to_format(CSC);
+    const SparseMatrix<double> &csc = data.get_format() == CSC ? data : converted;
+
+    size_t n_cols = data.get_cols();
+    size_t n_rows = data.get_rows();
+
+    std::vector<QuantileSketch> sketches(n_cols);
+    std::vector< std::future<void> > workers;
+    workers.reserve((n_cols + cols_per_task - 1) / cols_per_task);
 
     auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
-    for (int i = 0; i < data.get_cols(); i++) {
-      workers.push_back(tp->submit< Matrix<int> >([&, i] (arena_t *arena) {
-	auto col = data.get(COL, i);
-	auto binned_col = std::make_unique<int[]>(col.get_rows());
-	
-	for (int j = 0; j < col.get_rows(); j++) {
-	  double val = col.get(j, 0);
+    for (size_t start = 0; start < n_cols; start += cols_per_task) {
+      workers.push_back(tp->submit< void >([&, start] (arena_t *arena) {
+	for (size_t i = start; i < std::min(n_cols, start + cols_per_task); i++) {
+	  auto col = csc.get_col_view(i);
+	  sketches[i].insert(col.vals, col.nnz);
+	  sketches[i].insert(0.0, n_rows - col.nnz);
+	}
+      }));
+    }
 
-	  if (val < shelves[i].ranges[0]) {
-	    binned_col[j] = 0;
-	    continue;
-	  }
+    for (auto &w: workers) {
+      w.get();
+    }
+
+    return shelves_from_sketches(sketches, num_bins, n_rows);
+  }
+
+  std::shared_ptr<Shelf[]> quantile_bin(DataReader &reader, size_t num_bins) {
+    std::vector<QuantileSketch> sketches(reader.get_cols());
+    size_t n_chunks{ 0 };
+
+    size_t n_rows{ 0 };
+
+    while (reader.next()) {
+      sketch_columns(reader.X().begin(), reader.X().get_rows(), reader.get_cols(), sketches, n_chunks);
+      n_rows += reader.X().get_rows();
+    }
 
-	  for (int k = 1; k < shelves[i].num_bins - 1; k++) {
-	    if (val >= shelves[i].ranges[k - 1] && val < shelves[i].ranges[k]) {
-	      binned_col[j] = k;
-	      break;
+    reader.rewind();
+    return shelves_from_sketches(sketches, num_bins, n_rows);
+  }
+
+  
+  template <typename BinT>
+  Matrix<BinT> apply_quantile(const Matrix<double> &data, std::shared_ptr<Shelf[]> shelves, bool feature_major) {
+    constexpr size_t rows_per_task = 8192;
+    constexpr size_t max_bins = static_cast<size_t>(std::numeric_limits<BinT>::max()) + 1;
+    size_t n_rows = data.get_rows();
+    size_t n_cols = data.get_cols();
+
+    std::vector<Bucketizer> bucketizers;
+    bucketizers.reserve(n_cols);
+    for (size_t i = 0; i < n_cols; i++) {
+      if (shelves[i].num_bins > max_bins) {
+	throw std::invalid_argument("Apply quantile error - A shelf has more bins than the bin type holds");
+      }
+
+      bucketizers.emplace_back(shelves[i].ranges.get(),
+			       shelves[i].num_boundaries(),
+			       shelves[i].has_missing ? shelves[i].missing_bin() : 0);
+    }
+
+    auto binned = std::make_unique<BinT[]>(n_rows * n_cols);
+    const double *data_ptr = data.begin();
+    BinT *binned_ptr = binned.get();
+
+    // each task bins a block of rows straight into the result
+    std::vector< std::future<void> > workers;
+    workers.reserve((n_rows + rows_per_task - 1) / rows_per_task);
+
+    auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+    for (size_t start = 0; start < n_rows; start += rows_per_task) {
+      workers.push_back(tp->submit< void >([&, start] (arena_t *arena) {
+	size_t block_rows = std::min(rows_per_task, n_rows - start);
+	
+	for (size_t i = 0; i < n_cols; i++) {
+	  // categories are looked up in the shelf's dictionary
+	  if (shelves[i].is_categorical) {
+	    for (size_t j = start; j < start + block_rows; j++) {
+	      BinT b = shelves[i].bin_of(data_ptr[j * n_cols + i]);
+	      binned_ptr[feature_major ? i * n_rows + j : j * n_cols + i] = b;
 	    }
+	    continue;
 	  }
 
-	  if (val > shelves[i].ranges[shelves[i].num_bins - 2]) {
-	    binned_col[j] = shelves[i].num_bins - 1;
+	  if (feature_major) {
+	    bucketizers[i].bucketize(data_ptr + start * n_cols + i, block_rows, n_cols,
+				     binned_ptr + i * n_rows + start, 1);
+	  } else {
+	    bucketizers[i].bucketize(data_ptr + start * n_cols + i, block_rows, n_cols,
+				     binned_ptr + start * n_cols + i, n_cols);
 	  }
 	}
+      }));
+    }
+
+    for (auto &t: workers) {
+      t.get();
+    }
+
+    if (feature_major)
+      return Matrix<BinT>(n_cols, n_rows, std::move(binned));
+
+    return Matrix<BinT>(n_rows, n_cols, std::move(binned));
+  }
+
+  template Matrix<uint8_t> apply_quantile<uint8_t>(const Matrix<double> &, std::shared_ptr<Shelf[]>, bool);
+  template Matrix<uint16_t> apply_quantile<uint16_t>(const Matrix<double> &, std::shared_ptr<Shelf[]>, bool);
+
+  /// @brief Gather the rows of the features in [start, end)
+  template <typename BinT, typename IndexT>
+  static void gather_features(const BinT *bins,
+			      size_t n_rows,
+			      const IndexT *rows,
+			      size_t n,
+			      BinT *out,
+			      size_t start,
+			      size_t end) {
+    for (size_t i = start; i < end; i++) {
+      const BinT *feature = bins + i * n_rows;
+      BinT *feature_out = out + i * n;
+
+      for (size_t k = 0; k < n; k++)
+	feature_out[k] = feature[rows[k]];
+    }
+  }
+
+  template <typename BinT>
+  void gather_bins(const Matrix<BinT> &bins, const size_t *rows, size_t n, Matrix<BinT> &out) {
+    constexpr size_t min_task_cells = size_t{ 1 } << 16;
+    size_t n_features = bins.get_rows();
+    size_t n_rows = bins.get_cols();
+
+    if (out.get_rows() != n_features || out.get_cols() != n)
+      out = Matrix<BinT>(n_features, n, std::make_unique<BinT[]>(n_features * n));
+
+    std::vector<uint32_t> narrow_rows;
+    if (n_rows <= std::numeric_limits<uint32_t>::max())
+      narrow_rows.assign(rows, rows + n);
+
+    auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+    size_t n_tasks = std::min({ n_features, 2 * static_cast<size_t>(tp->get_num_threads()), std::max(size_t{ 1 }, n_features * n / min_task_cells) });
+    if (n_tasks == 0)
+      return;
+
+    size_t features_per_task = (n_features + n_tasks - 1) / n_tasks;
+
+    auto gather = [&] (size_t start, size_t end) {
+      if (!narrow_rows.empty() || n == 0)
+	gather_features(bins.begin(), n_rows, narrow_rows.data(), n, out.begin(), start, end);
+      else
+	gather_features(bins.begin(), n_rows, rows, n, out.begin(), start, end);
+    };
+
+    std::vector< std::future<void> > workers;
+    for (size_t start = features_per_task; start < n_features; start += features_per_task)
+      workers.push_back(tp->submit< void >([&, start] (arena_t *arena) {
+	gather(start, std::min(n_features, start + features_per_task));
+      }));
 
-	return Matrix<int>(col.get_rows(), 1, std::move(binned_col));
+    gather(0, std::min(n_features, features_per_task));
+
+    for (auto &t: workers) {
+      t.get();
+    }
+  }
+
+  template void gather_bins<uint8_t>(const Matrix<uint8_t> &, const size_t *, size_t, Matrix<uint8_t> &);
+  template void gather_bins<uint16_t>(const Matrix<uint16_t> &, const size_t *, size_t, Matrix<uint16_t> &);
+
+  SparseMatrix<uint8_t> apply_quantile(const SparseMatrix<double> &data, std::shared_ptr<Shelf[]> shelves) {
+    constexpr size_t rows_per_task = 8192;
+    SparseMatrix<double> converted;
+    if (data.get_format() != CSR)
+      converted = data.to_format(CSR);
+    const SparseMatrix<double> &csr = data.get_format() == CSR ? data : converted;
+
+    size_t n_rows = data.get_rows();
+
+    std::vector<Bucketizer> bucketizers;
+    bucketizers.reserve(data.get_cols());
+    for (size_t i = 0; i < data.get_cols(); i++) {
+      if (shelves[i].num_bins > 256) {
+	throw std::invalid_argument("Apply quantile error - A shelf has more than 256 bins");
+      }
+
+      bucketizers.emplace_back(shelves[i].ranges.get(),
+			       shelves[i].num_boundaries(),
+			       shelves[i].has_missing ? shelves[i].missing_bin() : 0);
+    }
+
+    const auto &outer = csr.get_outer();
+    const auto &inner = csr.get_inner();
+    const auto &vals = csr.get_vals();
+    std::vector<uint8_t> binned(vals.size());
+
+    std::vector< std::future<void> > workers;
+    workers.reserve((n_rows + rows_per_task - 1) / rows_per_task);
+
+    auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+    for (size_t start = 0; start < n_rows; start += rows_per_task) {
+      workers.push_back(tp->submit< void >([&, start] (arena_t *arena) {
+	size_t end = std::min(n_rows, start + rows_per_task);
+
+	for (size_t k = outer[start]; k < outer[end]; k++) {
+	  const Shelf &shelf = shelves[inner[k]];
+	  binned[k] = static_cast<uint8_t>(shelf.is_categorical ? shelf.bin_of(vals[k]) : bucketizers[inner[k]].bucketize(vals[k]));
+	}
       }));
     }
 
     for (auto &t: workers) {
-      cols.push_back(t.get());
+      t.get();
     }
 
-    return Matrix<int>::join_cols(cols);
+    return SparseMatrix<uint8_t>(n_rows, data.get_cols(), CSR, outer, inner, std::move(binned));
   }
 };
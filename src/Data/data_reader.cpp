@@ -0,0 +1,323 @@
+#include "CNum/Data/DataReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <future>
+#include <utility>
+
+using namespace CNum::DataStructs;
+
+namespace CNum::Data {
+  /// @brief The smallest number of rows worth parsing in a separate task
+  constexpr size_t min_rows_per_parse_task = 4096;
+
+  // ------------------------------
+  // Constructors and destructors
+  // ------------------------------
+
+  DataReader::DataReader(const ::std::string &path,
+			 size_t batch_rows,
+			 DataFormat format,
+			 const CSVOptions &options)
+    : _path(path),
+      _format(format),
+      _options(options),
+      _batch_rows(batch_rows),
+      _file(path),
+      _cursor(nullptr),
+      _data_begin(nullptr),
+      _n_cols(0),
+      _x_cols(0),
+      _label_idx(0),
+      _n_rows(0),
+      _rows_read(0),
+      _current(-1),
+      _stop(false),
+      _done(false),
+      _err(nullptr) {
+    if (_batch_rows == 0) {
+      throw ::std::invalid_argument("Data reader error - batch_rows must be greater than 0");
+    }
+
+    _file.advise_sequential();
+
+    if (_format == CSV) {
+      _data_begin = csv_skip_lines(_file.begin(), _file.end(), _options.header_rows);
+      _n_cols = csv_count_cols(_data_begin, _file.end(), _options.separator);
+
+      if (_n_cols == 0) {
+	throw ::std::runtime_error("Data reader error - No rows found in file: " + _path);
+      }
+
+      _label_idx = csv_label_idx(_options, _n_cols);
+      _x_cols = _options.has_labels ? _n_cols - 1 : _n_cols;
+    } else {
+      BinaryHeader header = read_binary_header(_file, _path);
+
+      _data_begin = _file.begin() + sizeof(BinaryHeader);
+      _n_rows = header.n_rows;
+      _n_cols = header.n_cols;
+      _x_cols = header.n_cols;
+      _options.has_labels = header.has_labels != 0;
+    }
+
+    _cursor = _data_begin;
+
+    for (auto &slot: _slots) {
+      slot.X_buf = ::std::make_unique<double[]>(_batch_rows * _x_cols);
+      slot.y_buf = _options.has_labels ? ::std::make_unique<double[]>(_batch_rows) : nullptr;
+      slot.n_rows = 0;
+      slot.first_row = 0;
+      slot.ready = false;
+    }
+
+    start();
+  }
+
+  DataReader::~DataReader() {
+    stop();
+  }
+
+  // ---------------
+  // Read-ahead
+  // ---------------
+
+  void DataReader::start() {
+    _producer = ::std::thread(&DataReader::produce, this);
+  }
+
+  void DataReader::stop() {
+    {
+      ::std::lock_guard<::std::mutex> lg(_mtx);
+      _stop = true;
+    }
+    _cv.notify_all();
+
+    if (_producer.joinable())
+      _producer.join();
+  }
+
+  void DataReader::produce() {
+    int k = 0;
+
+    while (true) {
+      Slot &slot = _slots[k];
+
+      {
+	// wait until the consumer has given the slot's buffers back
+	::std::unique_lock<::std::mutex> ul(_mtx);
+	_cv.wait(ul, [&, this] { return _stop || (!slot.ready && slot.X_buf != nullptr); });
+
+	if (_stop)
+	  return;
+      }
+
+      size_t first_row = _rows_read;
+      size_t n_rows{ 0 };
+
+      try {
+	n_rows = _format == CSV ? fill_csv(slot) : fill_binary(slot);
+      } catch (...) {
+	::std::lock_guard<::std::mutex> lg(_mtx);
+	_err = ::std::current_exception();
+	_done = true;
+	_cv.notify_all();
+	return;
+      }
+
+      ::std::lock_guard<::std::mutex> lg(_mtx);
+      if (n_rows == 0) {
+	_done = true;
+	_cv.notify_all();
+	return;
+      }
+
+      slot.n_rows = n_rows;
+      slot.first_row = first_row;
+      slot.ready = true;
+      _cv.notify_all();
+
+      k ^= 1;
+    }
+  }
+
+  size_t DataReader::fill_csv(Slot &slot) {
+    const char *end = _file.end();
+    auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+
+    size_t n_tasks = ::std::max<size_t>(1, ::std::min<size_t>(tp->get_num_threads(),
+							      _batch_rows / min_rows_per_parse_task));
+    size_t rows_per_task = (_batch_rows + n_tasks - 1) / n_tasks;
+
+    // find the lines of the batch and where each task starts
+    ::std::vector< ::std::pair<const char *, size_t> > task_starts;
+    task_starts.reserve(n_tasks);
+
+    size_t n_rows{ 0 };
+    const char *ptr = _cursor;
+    while (n_rows < _batch_rows && ptr < end) {
+      const char *nl = (const char *) ::std::memchr(ptr, '\n', end - ptr);
+      const char *line_end = nl == nullptr ? end : nl;
+
+      if (!csv_line_is_blank(ptr, line_end)) {
+	if (n_rows % rows_per_task == 0)
+	  task_starts.push_back({ ptr, n_rows });
+	n_rows++;
+      }
+
+      ptr = nl == nullptr ? end : nl + 1;
+    }
+
+    _cursor = ptr;
+    _rows_read += n_rows;
+
+    double *X_ptr = slot.X_buf.get();
+    double *y_ptr = slot.y_buf.get();
+
+    auto parse_task = [&, this] (size_t task) {
+      const char *line = task_starts[task].first;
+      size_t first_row = task_starts[task].second;
+      size_t task_rows = (task + 1 < task_starts.size() ? task_starts[task + 1].second : n_rows) - first_row;
+      double unused_label;
+
+      for (size_t row = first_row; row < first_row + task_rows;) {
+	const char *nl = (const char *) ::std::memchr(line, '\n', end - line);
+	const char *line_end = nl == nullptr ? end : nl;
+
+	if (!csv_line_is_blank(line, line_end)) {
+	  csv_parse_row(line, line_end, _n_cols, _label_idx, _options,
+			X_ptr + row * _x_cols,
+			y_ptr == nullptr ? &unused_label : y_ptr + row);
+	  row++;
+	}
+
+	line = nl == nullptr ? end : nl + 1;
+      }
+    };
+
+    if (task_starts.size() <= 1) {
+      if (n_rows > 0)
+	parse_task(0);
+      return n_rows;
+    }
+
+    ::std::vector< ::std::future<void> > workers;
+    workers.reserve(task_starts.size());
+    for (size_t task = 0; task < task_starts.size(); task++) {
+      workers.push_back(tp->submit< void >([&parse_task, task] (arena_t *arena) {
+	parse_task(task);
+      }));
+    }
+
+    // wait for every task before rethrowing so no task writes to the slot afterwards
+    ::std::exception_ptr err = nullptr;
+    for (auto &w: workers) {
+      try {
+	w.get();
+      } catch (...) {
+	if (err == nullptr)
+	  err = ::std::current_exception();
+      }
+    }
+
+    if (err != nullptr)
+      ::std::rethrow_exception(err);
+
+    return n_rows;
+  }
+
+  size_t DataReader::fill_binary(Slot &slot) {
+    size_t n_rows = ::std::min(_batch_rows, _n_rows - _rows_read);
+    const double *X_src = (const double *) _data_begin;
+
+    ::std::memcpy(slot.X_buf.get(),
+		  X_src + _rows_read * _x_cols,
+		  sizeof(double) * n_rows * _x_cols);
+
+    if (_options.has_labels) {
+      const double *y_src = X_src + _n_rows * _x_cols;
+      ::std::memcpy(slot.y_buf.get(), y_src + _rows_read, sizeof(double) * n_rows);
+    }
+
+    _rows_read += n_rows;
+    return n_rows;
+  }
+
+  // ---------------
+  // Consuming
+  // ---------------
+
+  void DataReader::release_current() {
+    if (_current < 0 || _X.begin() == nullptr)
+      return;
+
+    Slot &slot = _slots[_current];
+    slot.X_buf = _X.move_ptr();
+    _X = Matrix<double>();
+
+    if (_options.has_labels) {
+      slot.y_buf = _y.move_ptr();
+      _y = Matrix<double>();
+    }
+  }
+
+  bool DataReader::next() {
+    ::std::unique_lock<::std::mutex> ul(_mtx);
+    release_current();
+    _cv.notify_all();
+
+    int k = _current < 0 ? 0 : _current ^ 1;
+    _cv.wait(ul, [&, this] { return _slots[k].ready || _done; });
+
+    if (!_slots[k].ready) {
+      if (_err != nullptr)
+	::std::rethrow_exception(_err);
+
+      return false;
+    }
+
+    Slot &slot = _slots[k];
+    _X = Matrix<double>(slot.n_rows, _x_cols, ::std::move(slot.X_buf));
+    if (_options.has_labels)
+      _y = Matrix<double>(slot.n_rows, 1, ::std::move(slot.y_buf));
+
+    slot.ready = false;
+    _current = k;
+
+    return true;
+  }
+
+  void DataReader::rewind() {
+    stop();
+    release_current();
+
+    for (auto &slot: _slots)
+      slot.ready = false;
+
+    _cursor = _data_begin;
+    _rows_read = 0;
+    _current = -1;
+    _stop = false;
+    _done = false;
+    _err = nullptr;
+
+    start();
+  }
+
+  // ---------------
+  // Getters
+  // ---------------
+
+  const Matrix<double> &DataReader::X() const { return _X; }
+
+  const Matrix<double> &DataReader::y() const { return _y; }
+
+  size_t DataReader::batch_start() const {
+    return _current < 0 ? 0 : _slots[_current].first_row;
+  }
+
+  size_t DataReader::get_cols() const { return _x_cols; }
+
+  bool DataReader::has_labels() const { return _options.has_labels; }
+};
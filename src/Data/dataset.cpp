@@ -0,0 +1,33 @@
+#include "CNum/Data/Data.h"
+
+using namespace CNum::DataStructs;
+
+namespace CNum::Data {
+  Dataset::Dataset(Matrix<double> X, Matrix<double> y, size_t num_bins, const ::std::vector<size_t> &categorical)
+    : _X(::std::move(X)),
+      _y(::std::move(y)) {
+    if (_X.get_rows() != _y.get_rows()) {
+      throw ::std::invalid_argument("Dataset error - The data and labels have a different number of rows");
+    }
+
+    _shelves = quantile_bin(_X, num_bins, categorical);
+    _bins = apply_quantile(_X, _shelves, true);
+    _bundled = BundledBins(_bins, _shelves.get());
+  }
+
+  const Matrix<double> &Dataset::X() const { return _X; }
+
+  const Matrix<double> &Dataset::y() const { return _y; }
+
+  ::std::shared_ptr<Shelf[]> Dataset::get_shelves() const { return _shelves; }
+
+  const Matrix<uint8_t> &Dataset::get_bins() const { return _bins; }
+
+  const BundledBins *Dataset::get_bundled() const {
+    return _bundled.get_bundles() < _bundled.get_features() ? &_bundled : nullptr;
+  }
+
+  size_t Dataset::get_rows() const { return _X.get_rows(); }
+
+  size_t Dataset::get_cols() const { return _X.get_cols(); }
+};
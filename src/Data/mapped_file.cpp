@@ -0,0 +1,168 @@
+#include "CNum/Data/MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace CNum::Data {
+#ifdef _WIN32
+  MappedFile::MappedFile(const ::std::string &path)
+    : _data(nullptr), _size(0), _file_handle(nullptr), _map_handle(nullptr) {
+    HANDLE file = CreateFileA(path.c_str(),
+			      GENERIC_READ,
+			      FILE_SHARE_READ,
+			      nullptr,
+			      OPEN_EXISTING,
+			      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+			      nullptr);
+
+    if (file == INVALID_HANDLE_VALUE) {
+      throw ::std::runtime_error("Mapped file error - Failed to open file: " + path);
+    }
+
+    _file_handle = file;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+      release();
+      throw ::std::runtime_error("Mapped file error - Failed to get size of file: " + path);
+    }
+
+    _size = static_cast<size_t>(file_size.QuadPart);
+    if (_size == 0)
+      return;
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+      release();
+      throw ::std::runtime_error("Mapped file error - Failed to map file: " + path);
+    }
+
+    _map_handle = mapping;
+    _data = (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (_data == nullptr) {
+      release();
+      throw ::std::runtime_error("Mapped file error - Failed to map file: " + path);
+    }
+  }
+
+  void MappedFile::release() noexcept {
+    if (_data != nullptr)
+      UnmapViewOfFile(_data);
+
+    if (_map_handle != nullptr)
+      CloseHandle((HANDLE) _map_handle);
+
+    if (_file_handle != nullptr)
+      CloseHandle((HANDLE) _file_handle);
+
+    _data = nullptr;
+    _map_handle = nullptr;
+    _file_handle = nullptr;
+    _size = 0;
+  }
+
+  void MappedFile::move(MappedFile &&other) noexcept {
+    if (this == &other) return;
+    release();
+
+    _data = ::std::exchange(other._data, nullptr);
+    _size = ::std::exchange(other._size, 0);
+    _file_handle = ::std::exchange(other._file_handle, nullptr);
+    _map_handle = ::std::exchange(other._map_handle, nullptr);
+  }
+
+  void MappedFile::advise_sequential() const noexcept {
+    // FILE_FLAG_SEQUENTIAL_SCAN is set when the file is opened
+  }
+#else
+  MappedFile::MappedFile(const ::std::string &path)
+    : _data(nullptr), _size(0), _fd(-1) {
+    _fd = ::open(path.c_str(), O_RDONLY);
+
+    if (_fd < 0) {
+      throw ::std::runtime_error("Mapped file error - Failed to open file: " + path);
+    }
+
+    struct stat st;
+    if (::fstat(_fd, &st) != 0) {
+      release();
+      throw ::std::runtime_error("Mapped file error - Failed to get size of file: " + path);
+    }
+
+    _size = static_cast<size_t>(st.st_size);
+    if (_size == 0)
+      return;
+
+    void *ptr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+    if (ptr == MAP_FAILED) {
+      release();
+      throw ::std::runtime_error("Mapped file error - Failed to map file: " + path);
+    }
+
+    _data = (const char *) ptr;
+  }
+
+  void MappedFile::release() noexcept {
+    if (_data != nullptr)
+      ::munmap((void *) _data, _size);
+
+    if (_fd >= 0)
+      ::close(_fd);
+
+    _data = nullptr;
+    _fd = -1;
+    _size = 0;
+  }
+
+  void MappedFile::move(MappedFile &&other) noexcept {
+    if (this == &other) return;
+    release();
+
+    _data = ::std::exchange(other._data, nullptr);
+    _size = ::std::exchange(other._size, 0);
+    _fd = ::std::exchange(other._fd, -1);
+  }
+
+  void MappedFile::advise_sequential() const noexcept {
+    if (_data != nullptr)
+      ::madvise((void *) _data, _size, MADV_SEQUENTIAL);
+  }
+#endif
+
+  MappedFile::MappedFile(MappedFile &&other) noexcept
+    : _data(nullptr), _size(0),
+#ifdef _WIN32
+      _file_handle(nullptr), _map_handle(nullptr) {
+#else
+      _fd(-1) {
+#endif
+    this->move(::std::move(other));
+  }
+
+  MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    this->move(::std::move(other));
+    return *this;
+  }
+
+  MappedFile::~MappedFile() {
+    release();
+  }
+
+  const char *MappedFile::begin() const { return _data; }
+
+  const char *MappedFile::end() const { return _data + _size; }
+
+  size_t MappedFile::size() const { return _size; }
+};
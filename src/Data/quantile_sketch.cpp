@@ -0,0 +1,146 @@
+#include "CNum/Data/QuantileSketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace CNum::Data {
+  /// @brief How much smaller each level is than the one above it
+  constexpr double level_decay = 2.0 / 3.0;
+
+  QuantileSketch::QuantileSketch(size_t k, uint64_t seed)
+    : _k(::std::max<size_t>(k, 8)),
+      _n(0),
+      _size(0),
+      _capacity(0),
+      _levels(1),
+      _rng(seed) {
+    update_capacity();
+  }
+
+  size_t QuantileSketch::capacity(size_t level) const {
+    size_t depth = _levels.size() - 1 - level;
+    return ::std::max<size_t>(2, ::std::ceil(_k * ::std::pow(level_decay, depth)));
+  }
+
+  void QuantileSketch::update_capacity() {
+    _capacity = 0;
+    for (size_t h = 0; h < _levels.size(); h++)
+      _capacity += capacity(h);
+  }
+
+  void QuantileSketch::compress() {
+    while (_size >= _capacity) {
+      // the total is over capacity so at least one level is
+      size_t h{ 0 };
+      while (_levels[h].size() < capacity(h))
+	h++;
+
+      if (h + 1 == _levels.size()) {
+	_levels.emplace_back();
+	update_capacity();
+      }
+
+      auto &level = _levels[h];
+      auto &next_level = _levels[h + 1];
+      ::std::sort(level.begin(), level.end());
+
+      // an odd value out stays on this level
+      double leftover = level.back();
+      bool odd = level.size() % 2 == 1;
+      size_t n_pairs = level.size() / 2;
+      size_t offset = _rng() & 1;
+
+      for (size_t i = 0; i < n_pairs; i++)
+	next_level.push_back(level[2 * i + offset]);
+
+      level.clear();
+      if (odd)
+	level.push_back(leftover);
+
+      _size -= n_pairs;
+    }
+  }
+
+  void QuantileSketch::insert(double val, size_t count) {
+    if (is_missing(val) || count == 0)
+      return;
+
+    // a value on level h stands for 2^h values, so the copies are split by the bits
+    // of count
+    for (size_t h = 0; (count >> h) > 0; h++) {
+      if (((count >> h) & 1) == 0)
+	continue;
+
+      if (h >= _levels.size()) {
+	_levels.resize(h + 1);
+	update_capacity();
+      }
+
+      _levels[h].push_back(val);
+      _size++;
+    }
+
+    _n += count;
+
+    if (_size >= _capacity)
+      compress();
+  }
+
+  void QuantileSketch::insert(const double *vals, size_t n, size_t stride) {
+    for (size_t i = 0; i < n; i++)
+      insert(vals[i * stride]);
+  }
+
+  void QuantileSketch::merge(const QuantileSketch &other) {
+    if (other._levels.size() > _levels.size()) {
+      _levels.resize(other._levels.size());
+      update_capacity();
+    }
+
+    for (size_t h = 0; h < other._levels.size(); h++)
+      _levels[h].insert(_levels[h].end(), other._levels[h].begin(), other._levels[h].end());
+
+    _n += other._n;
+    _size += other._size;
+
+    if (_size >= _capacity)
+      compress();
+  }
+
+  size_t QuantileSketch::count() const { return _n; }
+
+  ::std::vector<double> QuantileSketch::quantiles(const ::std::vector<double> &qs) const {
+    if (_n == 0)
+      return {};
+
+    // every value on level h stands for 2^h inserted values
+    ::std::vector< ::std::pair<double, uint64_t> > items;
+    items.reserve(_size);
+    for (size_t h = 0; h < _levels.size(); h++) {
+      for (double val: _levels[h])
+	items.push_back({ val, uint64_t{ 1 } << h });
+    }
+
+    ::std::sort(items.begin(), items.end(), [] (const auto &a, const auto &b) {
+      return a.first < b.first;
+    });
+
+    ::std::vector<uint64_t> cumulative(items.size());
+    uint64_t sum{ 0 };
+    for (size_t i = 0; i < items.size(); i++) {
+      sum += items[i].second;
+      cumulative[i] = sum;
+    }
+
+    ::std::vector<double> res;
+    res.reserve(qs.size());
+    for (double q: qs) {
+      double target = q * sum;
+      size_t i = ::std::upper_bound(cumulative.begin(), cumulative.end(), target) - cumulative.begin();
+      res.push_back(items[::std::min(i, items.size() - 1)].first);
+    }
+
+    return res;
+  }
+};
@@ -0,0 +1,270 @@
+#include "CNum/Model/Tree/SplitScan.h"
+
+#include <limits>
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SPLIT_SCAN_AVX
+#include <immintrin.h>
+#endif
+
+namespace CNum::Model::Tree {
+  /// @brief The number of thresholds whose prefix sums and gains are held at once
+  constexpr int scan_chunk = 256;
+
+  /// @brief The gain of a threshold that fails a constraint (never the best)
+  constexpr double masked_gain = ::std::numeric_limits<double>::lowest();
+
+  ScanCandidate scan_bins_reference(const GradientPair *bins,
+				    int n_bins,
+				    GradientPair sums,
+				    const GradientPair *missing,
+				    double weight_decay,
+				    double reg_lambda,
+				    double gamma) {
+    ScanCandidate best{ gamma, -1, false, { 0.0, 0.0 } };
+    double gm = missing != nullptr ? missing->g : 0.0;
+    double hm = missing != nullptr ? missing->h : 0.0;
+
+    double gl{ 0.0 }, hl{ 0.0 };
+    double c1{ 0.0 }, c2{ 0.0 };
+
+    // want to make splits between bins so we skip last (n_bins - 1)
+    for (int j = 0; j < n_bins - 1; j++) {
+      // an empty bin gives the same split as the bin before it
+      if (bins[j].g == 0.0 && bins[j].h == 0.0)
+	continue;
+
+      // kahan sum for numerical stability
+      double y = bins[j].g - c1;
+      double t = gl + y;
+      c1 = (t - gl) - y;
+      gl = t;
+
+      y = bins[j].h - c2;
+      t = hl + y;
+      c2 = (t - hl) - y;
+      hl = t;
+
+      // try sending the missing values right, then left (if there are any)
+      for (int missing_left = 0; missing_left <= (missing != nullptr); missing_left++) {
+	double gl_dir = missing_left ? gl + gm : gl;
+	double hl_dir = missing_left ? hl + hm : hl;
+	double gr = sums.g - gl_dir;
+	double hr = sums.h - hl_dir;
+
+	if (hl_dir < weight_decay || hr < weight_decay)
+	  continue;
+
+	double gain = .5 * (
+			    ((gl_dir * gl_dir) / (hl_dir + reg_lambda)) +
+			    ((gr * gr) / (hr + reg_lambda)) -
+			    ((sums.g * sums.g) / (sums.h + reg_lambda))
+			    );
+
+	if (gain > best.gain)
+	  best = { gain, j, static_cast<bool>(missing_left), { gl_dir, hl_dir } };
+      }
+    }
+
+    return best;
+  }
+
+  /// @brief Kahan-compensated prefix sums carried from chunk to chunk
+  struct PrefixState {
+    double gl;
+    double hl;
+    double c1;
+    double c2;
+  };
+
+  /// @brief Write the prefix sums of a chunk of bins and whether each bin is a threshold
+  static void prefix_chunk(const GradientPair *bins,
+			   int n,
+			   PrefixState &state,
+			   double *gl,
+			   double *hl,
+			   double *valid) {
+    // the sums are kept in locals so the dependence chain does not go through memory
+    double g{ state.gl }, h{ state.hl };
+    double c1{ state.c1 }, c2{ state.c2 };
+
+    for (int k = 0; k < n; k++) {
+      bool empty = bins[k].g == 0.0 && bins[k].h == 0.0;
+      valid[k] = empty ? 0.0 : 1.0;
+
+      if (!empty) {
+	double y = bins[k].g - c1;
+	double t = g + y;
+	c1 = (t - g) - y;
+	g = t;
+
+	y = bins[k].h - c2;
+	t = h + y;
+	c2 = (t - h) - y;
+	h = t;
+      }
+
+      gl[k] = g;
+      hl[k] = h;
+    }
+
+    state = { g, h, c1, c2 };
+  }
+
+#ifdef SPLIT_SCAN_AVX
+  /// @brief Evaluate the gains of 4 thresholds per iteration with AVX
+  /// @param max_gain The highest of the gains evaluated (updated in place)
+  /// @return The number of thresholds that were evaluated
+  __attribute__((target("avx")))
+  static int gains_avx(const double *gl,
+		       const double *hl,
+		       const double *valid,
+		       int n,
+		       GradientPair sums,
+		       const GradientPair *missing,
+		       double parent,
+		       double weight_decay,
+		       double reg_lambda,
+		       double gamma,
+		       double *gains,
+		       double &max_gain) {
+    const __m256d gs = _mm256_set1_pd(sums.g);
+    const __m256d hs = _mm256_set1_pd(sums.h);
+    const __m256d lambda = _mm256_set1_pd(reg_lambda);
+    const __m256d decay = _mm256_set1_pd(weight_decay);
+    const __m256d gam = _mm256_set1_pd(gamma);
+    const __m256d par = _mm256_set1_pd(parent);
+    const __m256d half = _mm256_set1_pd(.5);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d masked = _mm256_set1_pd(masked_gain);
+    __m256d max_v = _mm256_set1_pd(max_gain);
+    int k{ 0 };
+
+    for (; k + 4 <= n; k += 4) {
+      __m256d gl_dir = _mm256_loadu_pd(gl + k);
+      __m256d hl_dir = _mm256_loadu_pd(hl + k);
+
+      if (missing != nullptr) {
+	gl_dir = _mm256_add_pd(gl_dir, _mm256_set1_pd(missing->g));
+	hl_dir = _mm256_add_pd(hl_dir, _mm256_set1_pd(missing->h));
+      }
+
+      __m256d gr = _mm256_sub_pd(gs, gl_dir);
+      __m256d hr = _mm256_sub_pd(hs, hl_dir);
+
+      __m256d left = _mm256_div_pd(_mm256_mul_pd(gl_dir, gl_dir), _mm256_add_pd(hl_dir, lambda));
+      __m256d right = _mm256_div_pd(_mm256_mul_pd(gr, gr), _mm256_add_pd(hr, lambda));
+      __m256d gain = _mm256_mul_pd(half, _mm256_sub_pd(_mm256_add_pd(left, right), par));
+
+      __m256d ok = _mm256_cmp_pd(_mm256_loadu_pd(valid + k), zero, _CMP_GT_OQ);
+      ok = _mm256_and_pd(ok, _mm256_cmp_pd(hl_dir, decay, _CMP_GE_OQ));
+      ok = _mm256_and_pd(ok, _mm256_cmp_pd(hr, decay, _CMP_GE_OQ));
+      ok = _mm256_and_pd(ok, _mm256_cmp_pd(gain, gam, _CMP_GT_OQ));
+
+      gain = _mm256_blendv_pd(masked, gain, ok);
+      _mm256_storeu_pd(gains + k, gain);
+      max_v = _mm256_max_pd(max_v, gain);
+    }
+
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, max_v);
+    max_gain = ::std::max({ lanes[0], lanes[1], lanes[2], lanes[3] });
+
+    return k;
+  }
+
+  /// @brief Whether or not the CPU supports AVX (checked once)
+  static bool cpu_has_avx() {
+    static const bool has_avx = __builtin_cpu_supports("avx");
+    return has_avx;
+  }
+#endif
+
+  /// @brief Evaluate the gains of a chunk of thresholds (masked_gain where a
+  /// constraint fails)
+  /// @param missing The sums of the missing values if they go left (nullptr if they
+  /// go right)
+  /// @return The highest of the gains
+  static double masked_gains(const double *gl,
+			   const double *hl,
+			   const double *valid,
+			   int n,
+			   GradientPair sums,
+			   const GradientPair *missing,
+			   double parent,
+			   double weight_decay,
+			   double reg_lambda,
+			   double gamma,
+			   double *gains) {
+    double max_gain{ masked_gain };
+    int k{ 0 };
+
+#ifdef SPLIT_SCAN_AVX
+    if (cpu_has_avx())
+      k = gains_avx(gl, hl, valid, n, sums, missing, parent, weight_decay, reg_lambda, gamma, gains, max_gain);
+#endif
+
+    // portable path, branchless so the compiler can vectorize it
+    for (; k < n; k++) {
+      double gl_dir = missing != nullptr ? gl[k] + missing->g : gl[k];
+      double hl_dir = missing != nullptr ? hl[k] + missing->h : hl[k];
+      double gr = sums.g - gl_dir;
+      double hr = sums.h - hl_dir;
+
+      double gain = .5 * (((gl_dir * gl_dir) / (hl_dir + reg_lambda)) + ((gr * gr) / (hr + reg_lambda)) - parent);
+      bool ok = valid[k] > 0.0 && hl_dir >= weight_decay && hr >= weight_decay && gain > gamma;
+      gains[k] = ok ? gain : masked_gain;
+      max_gain = ::std::max(max_gain, gains[k]);
+    }
+
+    return max_gain;
+  }
+
+  ScanCandidate scan_bins(const GradientPair *bins,
+			  int n_bins,
+			  GradientPair sums,
+			  const GradientPair *missing,
+			  double weight_decay,
+			  double reg_lambda,
+			  double gamma) {
+    ScanCandidate best{ gamma, -1, false, { 0.0, 0.0 } };
+    double parent = (sums.g * sums.g) / (sums.h + reg_lambda);
+    int n_dirs = missing != nullptr ? 2 : 1;
+
+    PrefixState state{ 0.0, 0.0, 0.0, 0.0 };
+    double gl[scan_chunk];
+    double hl[scan_chunk];
+    double valid[scan_chunk];
+    double gains[2][scan_chunk];
+
+    // want to make splits between bins so we skip last (n_bins - 1)
+    for (int start = 0; start < n_bins - 1; start += scan_chunk) {
+      int n = ::std::min(scan_chunk, n_bins - 1 - start);
+
+      // the prefix sums are a dependence chain, the gains are independent
+      prefix_chunk(bins + start, n, state, gl, hl, valid);
+      double max_gain{ masked_gain };
+      for (int dir = 0; dir < n_dirs; dir++)
+	max_gain = ::std::max(max_gain, masked_gains(gl, hl, valid, n, sums, dir ? missing : nullptr, parent,
+						     weight_decay, reg_lambda, gamma, gains[dir]));
+
+      if (max_gain <= best.gain)
+	continue;
+
+      // the first threshold with the highest gain wins (in the order of the reference)
+      int k{ 0 }, dir{ 0 };
+      while (gains[dir][k] != max_gain) {
+	if (++dir == n_dirs) {
+	  dir = 0;
+	  k++;
+	}
+      }
+
+      GradientPair left = dir ? GradientPair{ gl[k] + missing->g, hl[k] + missing->h } : GradientPair{ gl[k], hl[k] };
+      best = { max_gain, start + k, static_cast<bool>(dir), left };
+    }
+
+    return best;
+  }
+};
@@ -1,5 +1,9 @@
 #include "CNum/Model/Tree/TreeBooster.h"
 #include "CNum/Model/Tree/Tree.h"
+#include "XoshiroCpp.hpp"
+
+#include <cmath>
+#include <algorithm>
 
   // -----------
   // Tree
@@ -36,6 +40,12 @@ namespace CNum::Model::Tree {
     this->_reg_lambda = other._reg_lambda;
     this->_gamma = other._gamma;
     this->_weight_decay = other._weight_decay;
+    this->_grow_policy = other._grow_policy;
+    this->_max_leaves = other._max_leaves;
+    this->_colsample_bytree = other._colsample_bytree;
+    this->_colsample_bylevel = other._colsample_bylevel;
+    this->_colsample_bynode = other._colsample_bynode;
+    this->_colsample_seed = other._colsample_seed;
   }
   
   
@@ -54,6 +64,7 @@ namespace CNum::Model::Tree {
     TreeBoosterNode *cp_node = new TreeBoosterNode();
     cp_node->_split = node->_split;
     cp_node->_value = node->_value;
+    cp_node->_rows = node->_rows;
     
     cp_node->_left = copy_tree(node->_left);
     cp_node->_right = copy_tree(node->_right);
@@ -116,12 +127,107 @@ namespace CNum::Model::Tree {
     _root = root;
   }
 
+  void TreeBooster::set_quantized_gradients(const QuantizedGradients &quantized) {
+    _quantized = quantized;
+  }
+
+  void TreeBooster::set_grow_policy(GrowPolicy grow_policy) {
+    _grow_policy = grow_policy;
+  }
+
+  void TreeBooster::set_max_leaves(int max_leaves) {
+    _max_leaves = max_leaves;
+  }
+
+  void TreeBooster::set_colsample(double bytree, double bylevel, double bynode, uint64_t seed) {
+    _colsample_bytree = bytree;
+    _colsample_bylevel = bylevel;
+    _colsample_bynode = bynode;
+    _colsample_seed = seed;
+  }
+
+  // -------------------
+  // Column sampling
+  // -------------------
+
+  /// @brief Mix a value into a seed (a splitmix64 step)
+  static uint64_t mix_seed(uint64_t seed, uint64_t value) {
+    return ::XoshiroCpp::SplitMix64{ seed ^ (value * 0x9e3779b97f4a7c15ULL) }();
+  }
+
+  /// @brief Keep a fraction of the flagged features (at least 1) and unflag the rest
+  ///
+  /// The kept features are drawn with a partial Fisher-Yates shuffle
+  static void sample_features(uint8_t *flags, size_t n_features, double rate, uint64_t seed) {
+    if (rate >= 1.0)
+      return;
+
+    ::std::vector<size_t> candidates;
+    for (size_t f = 0; f < n_features; f++) {
+      if (flags[f])
+	candidates.push_back(f);
+    }
+
+    size_t n_keep = ::std::max(size_t{ 1 }, static_cast<size_t>(::std::round(rate * candidates.size())));
+    if (n_keep >= candidates.size())
+      return;
+
+    ::XoshiroCpp::Xoshiro256PlusPlus rng(seed);
+    for (size_t i = 0; i < n_keep; i++) {
+      size_t j = i + rng() % (candidates.size() - i);
+      ::std::swap(candidates[i], candidates[j]);
+    }
+
+    ::std::fill(flags, flags + n_features, 0);
+    for (size_t i = 0; i < n_keep; i++)
+      flags[candidates[i]] = 1;
+  }
+
+  void TreeBooster::sample_tree_columns(const ::std::vector<size_t> &feature_histograms, size_t n_histograms) {
+    _tree_features.clear();
+    _tree_histograms.clear();
+    if (_colsample_bytree >= 1.0 && _colsample_bylevel >= 1.0 && _colsample_bynode >= 1.0)
+      return;
+
+    _tree_features.assign(feature_histograms.size(), 1);
+    sample_features(_tree_features.data(), _tree_features.size(), _colsample_bytree, _colsample_seed);
+
+    _tree_histograms.assign(n_histograms, 0);
+    for (size_t f = 0; f < feature_histograms.size(); f++) {
+      if (_tree_features[f])
+	_tree_histograms[feature_histograms[f]] = 1;
+    }
+  }
+
+  const ColumnSample *TreeBooster::node_columns(int depth,
+						const DataPartition &partition,
+						::std::vector<uint8_t> &features,
+						ColumnSample &columns) const {
+    if (_tree_features.empty())
+      return nullptr;
+
+    columns.histograms = _tree_histograms.data();
+    if (_colsample_bylevel >= 1.0 && _colsample_bynode >= 1.0) {
+      columns.features = _tree_features.data();
+      return &columns;
+    }
+
+    uint64_t level_seed = mix_seed(_colsample_seed, static_cast<uint64_t>(depth) + 1);
+    features = _tree_features;
+    sample_features(features.data(), features.size(), _colsample_bylevel, level_seed);
+    sample_features(features.data(), features.size(), _colsample_bynode,
+		    mix_seed(mix_seed(level_seed, partition.start), partition.end));
+
+    columns.features = features.data();
+    return &columns;
+  }
+
   // -------------
   // Inference
   // -------------
 
   
-  Matrix<double> TreeBooster::predict(Matrix<double> &data) {
+  Matrix<double> TreeBooster::predict(const Matrix<double> &data) {
     int n_samples = data.get_rows();
     auto pred_ptr = ::std::make_unique<double[]>(data.get_rows());
 
@@ -133,20 +239,201 @@ namespace CNum::Model::Tree {
     return Matrix<double>(data.get_rows(), 1, ::std::move(pred_ptr));
   }
 
+
+  Matrix<double> TreeBooster::predict(const SparseMatrix<double> &data) {
+    if (data.get_format() != CSR)
+      return predict(data.to_format(CSR));
+
+    size_t n_samples = data.get_rows();
+    auto pred_ptr = ::std::make_unique<double[]>(n_samples);
+
+    for (size_t i = 0; i < n_samples; i++)
+      pred_ptr[i] = predict_sample(_root, data.get_row_view(i));
+
+    return Matrix<double>(n_samples, 1, ::std::move(pred_ptr));
+  }
+
+  /// @brief Write the values of a subtree's leaves for their rows (in-order)
+  /// @param pos The position of the subtree's first row (moved past its last)
+  static void write_leaf_values(const TreeBoosterNode *node, double *values, size_t &pos) {
+    if (node->_right == nullptr || node->_left == nullptr || node->_split.feature == -1) {
+      ::std::fill(values + pos, values + pos + node->_rows, node->_value);
+      pos += node->_rows;
+      return;
+    }
+
+    write_leaf_values(node->_left, values, pos);
+    write_leaf_values(node->_right, values, pos);
+  }
+
+  void TreeBooster::leaf_values(double *values) const {
+    size_t pos{ 0 };
+    write_leaf_values(_root, values, pos);
+  }
+
+  /**
+   * @struct BinNode
+   * @brief A tree node flattened for inference on bins
+   *
+   * feature is -1 for leaves. table is the offset of the node's go-left flag of every
+   * bin of its feature, and zero_left is the flag of the bin of 0.0 (the bin of the
+   * features sparse rows do not store)
+   */
+  struct BinNode {
+    int feature;
+    uint32_t left;
+    uint32_t right;
+    double value;
+    size_t table;
+    bool zero_left;
+  };
+
+  /// @brief Flatten a subtree into nodes (preorder) and go-left tables
+  /// @param depth The depth of the deepest leaf (updated in place)
+  /// @return The index of the subtree's root
+  static uint32_t flatten_tree(const TreeBoosterNode *node,
+			       const CNum::Data::Shelf *shelves,
+			       ::std::vector<BinNode> &nodes,
+			       ::std::vector<uint8_t> &tables,
+			       int &depth,
+			       int node_depth = 0) {
+    uint32_t idx = nodes.size();
+    depth = ::std::max(depth, node_depth);
+    nodes.push_back({ -1, 0, 0, node->_value, 0, false });
+
+    if (node->_right == nullptr || node->_left == nullptr || node->_split.feature == -1)
+      return idx;
+
+    const auto &shelf = shelves[node->_split.feature];
+    auto left = TreeBooster::left_bins(node->_split, shelf);
+
+    nodes[idx].feature = node->_split.feature;
+    nodes[idx].table = tables.size();
+    nodes[idx].zero_left = left[shelf.bin_of(0.0)];
+    tables.insert(tables.end(), left.begin(), left.end());
+
+    uint32_t l = flatten_tree(node->_left, shelves, nodes, tables, depth, node_depth + 1);
+    uint32_t r = flatten_tree(node->_right, shelves, nodes, tables, depth, node_depth + 1);
+    nodes[idx].left = l;
+    nodes[idx].right = r;
+
+    return idx;
+  }
+
+  /// @brief Inference on rows of binned data
+  ///
+  /// The rows of a block step down one level together so their lookups are
+  /// independent of each other (a row that reached a leaf stays on it)
+  template <typename MatrixT>
+  static void predict_bins_impl(const MatrixT &X,
+				const ::std::vector<BinNode> &nodes,
+				const ::std::vector<uint8_t> &tables,
+				int depth,
+				const size_t *rows,
+				size_t start,
+				size_t end,
+				double *preds) {
+    constexpr size_t step_rows = 256;
+    uint32_t at[step_rows];
+
+    for (size_t block = start; block < end; block += step_rows) {
+      size_t n = ::std::min(step_rows, end - block);
+      ::std::fill(at, at + n, 0);
+
+      for (int level = 0; level < depth; level++) {
+	for (size_t k = 0; k < n; k++) {
+	  const BinNode &node = nodes[at[k]];
+	  if (node.feature == -1)
+	    continue;
+
+	  size_t row = rows[block + k];
+	  bool left;
+	  if constexpr (::std::is_same_v<MatrixT, SparseMatrix<uint8_t> >) {
+	    auto view = X.get_row_view(row);
+	    const size_t *it = ::std::lower_bound(view.idx, view.idx + view.nnz, static_cast<size_t>(node.feature));
+	    left = it != view.idx + view.nnz && *it == static_cast<size_t>(node.feature)
+	      ? tables[node.table + view.vals[it - view.idx]]
+	      : node.zero_left;
+	  } else if constexpr (::std::is_same_v<MatrixT, CNum::Data::BundledBins>) {
+	    left = tables[node.table + X.get(node.feature, row)];
+	  } else {
+	    left = tables[node.table + X.begin()[node.feature * X.get_cols() + row]];
+	  }
+
+	  at[k] = left ? node.left : node.right;
+	}
+      }
+
+      for (size_t k = 0; k < n; k++)
+	preds[block + k] = nodes[at[k]].value;
+    }
+  }
+
+  void TreeBooster::predict_bins(const DataMatrix &X,
+				 std::shared_ptr<CNum::Data::Shelf[]> shelves,
+				 const size_t *rows,
+				 size_t n_rows,
+				 double *preds) {
+    constexpr size_t min_block_rows = size_t{ 1 } << 14;
+
+    ::std::visit([&, this] (auto *x) {
+      using MatrixT = ::std::remove_cv_t< ::std::remove_pointer_t<decltype(x)> >;
+
+      // greedy trees split on the raw values
+      if constexpr (::std::is_same_v<MatrixT, Matrix<double> >) {
+	for (size_t i = 0; i < n_rows; i++)
+	  preds[i] = predict_sample(_root, x->get_row_view(rows[i]));
+      } else {
+	::std::vector<BinNode> nodes;
+	::std::vector<uint8_t> tables;
+	int depth{ 0 };
+	flatten_tree(_root, shelves.get(), nodes, tables, depth);
+
+	auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+	size_t n_blocks = ::std::clamp(n_rows / min_block_rows, size_t{ 1 }, 2 * static_cast<size_t>(tp->get_num_threads()));
+	size_t block_rows = (n_rows + n_blocks - 1) / n_blocks;
+
+	auto predict_block = [&] (size_t b) {
+	  size_t start = b * block_rows;
+	  predict_bins_impl(*x, nodes, tables, depth, rows, start, ::std::min(n_rows, start + block_rows), preds);
+	};
+
+	::std::vector< ::std::future<void> > blocks;
+	for (size_t b = 1; b < n_blocks; b++)
+	  blocks.push_back(tp->submit< void >([&, b] (arena_t *arena) { predict_block(b); }));
+
+	predict_block(0);
+	for (auto &t: blocks)
+	  t.get();
+      }
+    }, X);
+  }
+
   /// @brief Inference (make predictions) on a single sample
   /// @param node A node in the TreeBooster
   /// @param sample The sample to make predictions on
   /// @return The prediction
-  double TreeBooster::predict_sample(TreeBoosterNode *node, std::span<double> &sample) {
+  template <typename SampleT>
+  double TreeBooster::predict_sample(TreeBoosterNode *node, const SampleT &sample) {
     if (node->_right == nullptr || node->_left == nullptr || node->_split.feature == -1)
       return node->_value;
 
-    if (sample[node->_split.feature] <= node->_split.threshold)
+    double val;
+    if constexpr (::std::is_same_v<SampleT, SparseVectorView<double> >)
+      val = sample.get(node->_split.feature);
+    else
+      val = sample[node->_split.feature];
+
+    if (!node->_split.cat_bitset.empty())
+      return predict_sample(category_in(node->_split, val) ? node->_left : node->_right, sample);
+
+    if (CNum::Data::is_missing(val))
+      return predict_sample(node->_split.default_left ? node->_left : node->_right, sample);
+
+    if (val < node->_split.threshold)
       return predict_sample(node->_left, sample);
-    else if (sample[node->_split.feature] > node->_split.threshold)
-      return predict_sample(node->_right, sample);
 
-    return node->_value;
+    return predict_sample(node->_right, sample);
   }
 
   // -----------
@@ -154,90 +441,310 @@ namespace CNum::Model::Tree {
   // -----------
 
   
-  arena_view_t TreeBooster::init_hist_view(size_t n_data_cols) {
-    arena_view_t hist_view = arena_malloc(_arena, sizeof(Histogram) * n_data_cols, sizeof(Histogram));
+  arena_view_t TreeBooster::init_hist_view(const std::vector<size_t> &hist_bins, arena_t *arena) {
+    if (arena == nullptr)
+      arena = _arena;
+
+    size_t n_histograms = hist_bins.size();
+    arena_view_t hist_view = arena_malloc(arena, sizeof(Histogram) * n_histograms, sizeof(Histogram));
+
+    // one block for every histogram, each only has as many bins as its feature (or
+    // bundle) uses
+    size_t total_bins = ::std::reduce(hist_bins.begin(), hist_bins.end(), size_t{ 0 });
+    arena_view_t block = arena_malloc(arena, sizeof(GradientPair) * total_bins, sizeof(GradientPair));
 
     Histogram *histograms = (Histogram *) hist_view.ptr;
-    for (int i = 0; i < n_data_cols; i++) {
-      arena_view_t g_bin_view = arena_malloc(_arena, sizeof(double) * N_BINS, sizeof(double));
-      arena_view_t h_bin_view = arena_malloc(_arena, sizeof(double) * N_BINS, sizeof(double));
-      
-      histograms[i] = { g_bin_view, h_bin_view };
+    GradientPair *bins = (GradientPair *) block.ptr;
+    for (size_t i = 0; i < n_histograms; i++) {
+      histograms[i] = { { bins, hist_bins[i], sizeof(GradientPair) } };
+      bins += hist_bins[i];
     }
     
     return hist_view;
   }
 
+
+  ::std::vector<uint8_t> TreeBooster::left_bins(const Split &split, const CNum::Data::Shelf &shelf) {
+    ::std::vector<uint8_t> left(shelf.num_bins, false);
+
+    if (shelf.is_categorical) {
+      // the last bin (unseen categories and missing values) always goes right
+      for (size_t b = 0; b + 1 < shelf.num_bins; b++)
+	left[b] = category_in(split, shelf.ranges[b]);
+
+      return left;
+    }
+
+    // the missing bin is the last bin so it only goes left by default
+    for (int b = 0; b <= split.bin; b++)
+      left[b] = true;
+
+    if (split.default_left && shelf.has_missing)
+      left[shelf.missing_bin()] = true;
+
+    return left;
+  }
+
   
-  size_t TreeBooster::partition_data(const Matrix<int> &X,
-				     double *g,
-				     double *h,
-				     size_t feat,
-				     uint8_t bin,
-				     const DataPartition &partition) {
+  /// @brief The fewest rows a partition is split into parallel blocks for
+  constexpr size_t parallel_partition_rows = size_t{ 1 } << 16;
+
+  /// @brief The fewest rows of a parallel partition's block
+  constexpr size_t partition_block_rows = size_t{ 1 } << 14;
+
+  /// @brief Rows moved by a partition (the right side of a serial partition, or every
+  /// row of a parallel one)
+  struct PartitionScratch {
+    ::std::vector<size_t> indeces;
+    ::std::vector<GradientPair> gh;
+    ::std::vector<QuantizedPair> q;
+
+    void resize(size_t n, bool quantized) {
+      indeces.resize(n);
+      gh.resize(n);
+      if (quantized)
+	q.resize(n);
+    }
+  };
+
+  /// @brief Stable partition of the rows in [start, end) of the idx array and the
+  /// gradient pairs from their go-left flags
+  ///
+  /// Left rows are compacted in place and right rows are written to the scratch
+  /// (appended at the end), both unconditionally so the loop has no data-dependent
+  /// branches
+  /// @return The index of the boundary between the left and right rows
+  static size_t stable_partition_serial(size_t *indeces,
+					GradientPair *gh,
+					QuantizedPair *q,
+					const uint8_t *flags,
+					size_t start,
+					size_t end,
+					PartitionScratch &scratch) {
+    scratch.resize(end - start, q != nullptr);
+    size_t l{ start }, r{ 0 };
+
+    for (size_t k = start; k < end; k++) {
+      size_t idx = indeces[k];
+      GradientPair pair = gh[k];
+      size_t f = flags[k - start];
+
+      indeces[l] = idx;
+      gh[l] = pair;
+      scratch.indeces[r] = idx;
+      scratch.gh[r] = pair;
+
+      if (q != nullptr) {
+	QuantizedPair qp = q[k];
+	q[l] = qp;
+	scratch.q[r] = qp;
+      }
+
+      l += f;
+      r += 1 - f;
+    }
+
+    ::std::copy(scratch.indeces.begin(), scratch.indeces.begin() + r, indeces + l);
+    ::std::copy(scratch.gh.begin(), scratch.gh.begin() + r, gh + l);
+    if (q != nullptr)
+      ::std::copy(scratch.q.begin(), scratch.q.begin() + r, q + l);
+
+    return l;
+  }
+
+  /// @brief Stable partition of the idx array and the gradient pairs
+  ///
+  /// The go-left flag of every row is computed first. Large nodes are split into row
+  /// blocks that count their left rows, the counts are prefix summed into each block's
+  /// destinations, and the blocks scatter their rows in parallel. Small nodes (and
+  /// serial partitions) compact the rows in place. The rows keep their order on both
+  /// sides, so the result does not depend on the path or the number of blocks
+  /// @param q The quantized gradient pairs moved along with gh (can be nullptr)
+  /// @param goes_left Whether or not a sample (by its index in the dataset) goes left
+  /// @param parallel Whether or not large nodes can use the ThreadPool
+  template <typename GoesLeft>
+  static size_t partition_indeces(GradientPair *gh,
+				  QuantizedPair *q,
+				  const DataPartition &partition,
+				  GoesLeft goes_left,
+				  bool parallel) {
     size_t *indeces = (size_t *) partition.global_idx_array->ptr;
-    size_t *l_idx_ptr = indeces + partition.start;
-    size_t *r_idx_ptr = indeces + partition.end - 1;
+    size_t n_rows = partition.end - partition.start;
 
-    double *l_g_ptr = g + partition.start;
-    double *r_g_ptr = g + partition.end - 1;
+    auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+    size_t n_workers = tp->get_num_threads();
 
-    double *l_h_ptr = h + partition.start;
-    double *r_h_ptr = h + partition.end - 1;
+    if (!parallel || n_workers < 2 || n_rows < parallel_partition_rows) {
+      // scoped to the call so no thread keeps a buffer the size of its largest node
+      ::std::vector<uint8_t> flags(n_rows);
+      PartitionScratch scratch;
 
-    while (l_idx_ptr <= r_idx_ptr) {
-      while (l_idx_ptr <= r_idx_ptr && X.get(feat, *l_idx_ptr) <= bin) {
-        l_idx_ptr++;
-	l_g_ptr++;
-	l_h_ptr++;
-      }
+      for (size_t k = 0; k < n_rows; k++)
+	flags[k] = goes_left(indeces[partition.start + k]);
+
+      return stable_partition_serial(indeces, gh, q, flags.data(), partition.start, partition.end, scratch);
+    }
 
-      while (l_idx_ptr <= r_idx_ptr && X.get(feat, *r_idx_ptr) > bin) {
-        r_idx_ptr--;
-	r_g_ptr--;
-	r_h_ptr--;
+    size_t n_blocks = ::std::min(2 * n_workers, n_rows / partition_block_rows);
+    size_t block_rows = (n_rows + n_blocks - 1) / n_blocks;
+    n_blocks = (n_rows + block_rows - 1) / block_rows;
+
+    ::std::vector<uint8_t> flags(n_rows);
+    ::std::vector<size_t> left_counts(n_blocks);
+    PartitionScratch moved;
+    moved.resize(n_rows, q != nullptr);
+
+    auto for_each_block = [&] (auto fn) {
+      ::std::vector< ::std::future<void> > tasks;
+      tasks.reserve(n_blocks);
+      for (size_t b = 0; b < n_blocks; b++) {
+	size_t start = b * block_rows;
+	size_t end = ::std::min(n_rows, start + block_rows);
+	tasks.push_back(tp->submit< void >([&fn, b, start, end] (arena_t *arena) { fn(b, start, end); }));
       }
 
-      if (l_idx_ptr <= r_idx_ptr) {
-        size_t idx_temp = *l_idx_ptr;
-	*l_idx_ptr = *r_idx_ptr;
-	*r_idx_ptr = idx_temp;
+      // every block has to finish before an error is rethrown, they use the buffers
+      for (auto &t: tasks)
+	t.wait();
 
-	double gh_temp = *l_g_ptr;
-	*l_g_ptr = *r_g_ptr;
-	*r_g_ptr = gh_temp;
+      for (auto &t: tasks)
+	t.get();
+    };
 
-	gh_temp = *l_h_ptr;
-	*l_h_ptr = *r_h_ptr;
-	*r_h_ptr = gh_temp;
+    for_each_block([&] (size_t b, size_t start, size_t end) {
+      size_t count{ 0 };
+      for (size_t k = start; k < end; k++) {
+	flags[k] = goes_left(indeces[partition.start + k]);
+	count += flags[k];
       }
+
+      left_counts[b] = count;
+    });
+
+    // each block's left rows start after the left rows of the blocks before it, and
+    // its right rows after every left row and the right rows before it
+    size_t n_left = ::std::reduce(left_counts.begin(), left_counts.end(), size_t{ 0 });
+    ::std::vector<size_t> left_starts(n_blocks), right_starts(n_blocks);
+    size_t l{ 0 }, r{ n_left };
+    for (size_t b = 0; b < n_blocks; b++) {
+      left_starts[b] = l;
+      right_starts[b] = r;
+      l += left_counts[b];
+      r += ::std::min(n_rows, (b + 1) * block_rows) - b * block_rows - left_counts[b];
     }
 
-    return partition.start + (l_idx_ptr - (indeces + partition.start));
+    for_each_block([&] (size_t b, size_t start, size_t end) {
+      size_t l = left_starts[b];
+      size_t r = right_starts[b];
+
+      for (size_t k = start; k < end; k++) {
+	size_t dst = flags[k] ? l++ : r++;
+	moved.indeces[dst] = indeces[partition.start + k];
+	moved.gh[dst] = gh[partition.start + k];
+	if (q != nullptr)
+	  moved.q[dst] = q[partition.start + k];
+      }
+    });
+
+    for_each_block([&] (size_t b, size_t start, size_t end) {
+      ::std::copy(moved.indeces.begin() + start, moved.indeces.begin() + end, indeces + partition.start + start);
+      ::std::copy(moved.gh.begin() + start, moved.gh.begin() + end, gh + partition.start + start);
+      if (q != nullptr)
+	::std::copy(moved.q.begin() + start, moved.q.begin() + end, q + partition.start + start);
+    });
+
+    return partition.start + n_left;
+  }
+
+
+  /// @brief Partition on a feature of feature-major bins
+  template <typename BinT>
+  static size_t partition_dense(const Matrix<BinT> &X,
+				GradientPair *gh,
+				const Split &split,
+				const CNum::Data::Shelf &shelf,
+				const DataPartition &partition,
+				QuantizedPair *q,
+				bool parallel) {
+    auto left = TreeBooster::left_bins(split, shelf);
+    auto row = X.get_row_view(split.feature);
+
+    return partition_indeces(gh, q, partition, [&] (size_t idx) { return left[row[idx]]; }, parallel);
+  }
+
+  size_t TreeBooster::partition_data(const Matrix<uint8_t> &X,
+				     GradientPair *gh,
+				     const Split &split,
+				     const CNum::Data::Shelf &shelf,
+				     const DataPartition &partition,
+				     QuantizedPair *q,
+				     bool parallel) {
+    return partition_dense(X, gh, split, shelf, partition, q, parallel);
+  }
+
+  size_t TreeBooster::partition_data(const Matrix<uint16_t> &X,
+				     GradientPair *gh,
+				     const Split &split,
+				     const CNum::Data::Shelf &shelf,
+				     const DataPartition &partition,
+				     QuantizedPair *q,
+				     bool parallel) {
+    return partition_dense(X, gh, split, shelf, partition, q, parallel);
+  }
+
+
+  size_t TreeBooster::partition_data(const SparseMatrix<uint8_t> &X,
+				     GradientPair *gh,
+				     const Split &split,
+				     const CNum::Data::Shelf &shelf,
+				     const DataPartition &partition,
+				     QuantizedPair *q,
+				     bool parallel) {
+    auto left = left_bins(split, shelf);
+    size_t feat = split.feature;
+    bool zero_left = left[shelf.bin_of(0.0)];
+
+    return partition_indeces(gh, q, partition, [&] (size_t idx) {
+      auto row = X.get_row_view(idx);
+      const size_t *it = ::std::lower_bound(row.idx, row.idx + row.nnz, feat);
+      return it != row.idx + row.nnz && *it == feat ? left[row.vals[it - row.idx]] : zero_left;
+    }, parallel);
+  }
+
+  size_t TreeBooster::partition_data(const CNum::Data::BundledBins &X,
+				     GradientPair *gh,
+				     const Split &split,
+				     const CNum::Data::Shelf &shelf,
+				     const DataPartition &partition,
+				     QuantizedPair *q,
+				     bool parallel) {
+    auto left = left_bins(split, shelf);
+
+    return partition_indeces(gh, q, partition, [&] (size_t idx) { return left[X.get(split.feature, idx)]; }, parallel);
   }
 
   void TreeBooster::histogram_subtraction(const arena_view_t &parent_hist_view,
 					  arena_view_t &small_hist_view,
 					  arena_view_t &large_hist_view) {
-    Histogram *parent_histograms = (Histogram *) parent_hist_view.ptr;
-    Histogram *small_histograms = (Histogram *) small_hist_view.ptr;
-    Histogram *large_histograms = (Histogram *) large_hist_view.ptr;
+    if (small_hist_view.range == 0)
+      return;
     
-    for (int i = 0; i < small_hist_view.range; i++) {
-      double *parent_hist_g = (double *) parent_histograms[i].g_bin.ptr;
-      double *parent_hist_h = (double *) parent_histograms[i].h_bin.ptr;
-      double *large_hist_g = (double *) large_histograms[i].g_bin.ptr;
-      double *large_hist_h = (double *) large_histograms[i].h_bin.ptr;
-      double *small_hist_g = (double *) small_histograms[i].g_bin.ptr;
-      double *small_hist_h = (double *) small_histograms[i].h_bin.ptr;
+    // the histograms of a node are one contiguous block so this is a single pass
+    const Histogram *small_histograms = (const Histogram *) small_hist_view.ptr;
+    const Histogram &last = small_histograms[small_hist_view.range - 1];
+    const GradientPair *small_bins = (const GradientPair *) small_histograms[0].bins.ptr;
+    size_t total_bins = ((const GradientPair *) last.bins.ptr + last.bins.range) - small_bins;
       
-      for (int j = 0; j < N_BINS; j++) {
-	large_hist_g[j] = parent_hist_g[j] - small_hist_g[j];
-        large_hist_h[j] = parent_hist_h[j] - small_hist_h[j];
-      }
+    const GradientPair *parent_bins = (const GradientPair *) ((const Histogram *) parent_hist_view.ptr)[0].bins.ptr;
+    GradientPair *large_bins = (GradientPair *) ((Histogram *) large_hist_view.ptr)[0].bins.ptr;
+
+    for (size_t j = 0; j < total_bins; j++) {
+      large_bins[j].g = parent_bins[j].g - small_bins[j].g;
+      large_bins[j].h = parent_bins[j].h - small_bins[j].h;
     }
   }
 
+
   
   ::std::string TreeBooster::to_json() {
     return _root->to_json_string();
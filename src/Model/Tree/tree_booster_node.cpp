@@ -5,17 +5,17 @@ using namespace CNum::DataStructs;
 namespace CNum::Model::Tree {
   TreeBoosterNode::TreeBoosterNode(TreeBoosterNode *left,
 				   TreeBoosterNode *right)
-    : _left(left), _right(right) {
+    : _rows(0), _left(left), _right(right) {
 
     _split.best_gain = 0.0;
     _split.feature = -1;
+    _split.default_left = false;
   }
 
   TreeBoosterNode::~TreeBoosterNode() {}
 
   Split TreeBoosterNode::find_best_split_greedy(Matrix<double> &X,
-					        const double *g,
-						const double *h,
+						const GradientPair *gh,
 						double weight_decay,
 						double reg_lambda,
 						double gamma) {
@@ -24,110 +24,816 @@ namespace CNum::Model::Tree {
     return {};
   }
 
+
+  /// @brief The fewest row-feature visits worth a task
+  constexpr size_t min_task_work = 16384;
   
-  Split TreeBoosterNode::find_best_split_hist(const Matrix<int> &X,
+  /// @brief Build the histograms of the features in [start, end) from feature-major bins
+  ///
+  /// Histograms that are not flagged in active are skipped (every histogram is built
+  /// if active is nullptr). Instantiated for one-byte and two-byte bins, and for gradient pairs (AccT =
+  /// GradientPair) and quantized pairs (AccT = IntPair)
+  template <typename AccT, typename BinT, typename PairT>
+  static void build_histograms(const Matrix<BinT> &X,
+			       const CNum::Data::Shelf *shelves,
+			       const PairT *gh,
+			       const size_t *indeces,
+			       const DataPartition &partition,
+			       const arena_view_t &hist_view,
+			       size_t start,
+			       size_t end,
+			       const uint8_t *active) {
+    for (size_t i = start; i < end; i++) {
+      if (active != nullptr && !active[i])
+	continue;
+
+      AccT *bins = (AccT *) ((Histogram *) hist_view.ptr)[i].bins.ptr;
+
+      auto row = X.get_row_view(i);
+      int missing_bin = shelves[i].missing_bin();
+
+      if (missing_bin < 0) {
+	for (size_t j = partition.start; j < partition.end; j++) {
+	  int b = row[indeces[j]];
+
+	  bins[b].g += gh[j].g;
+	  bins[b].h += gh[j].h;
+	}
+      } else {
+	// only present values are added, the missing bin is what is left of the totals
+	for (size_t j = partition.start; j < partition.end; j++) {
+	  int b = row[indeces[j]];
+	  if (b == missing_bin)
+	    continue;
+
+	  bins[b].g += gh[j].g;
+	  bins[b].h += gh[j].h;
+	}
+      }
+    }
+  }
+
+  /// @brief Build the histograms of the features in [start, end) from CSR bins
+  ///
+  /// Only the stored entries of each row are visited, the implicit zeros are added by
+  /// finish_histograms
+  template <typename AccT, typename PairT>
+  static void build_histograms(const SparseMatrix<uint8_t> &X,
+			       const CNum::Data::Shelf *shelves,
+			       const PairT *gh,
+			       const size_t *indeces,
+			       const DataPartition &partition,
+			       const arena_view_t &hist_view,
+			       size_t start,
+			       size_t end,
+			       const uint8_t *active) {
+    Histogram *histograms = (Histogram *) hist_view.ptr;
+
+    for (size_t j = partition.start; j < partition.end; j++) {
+      auto row = X.get_row_view(indeces[j]);
+      const size_t *it = ::std::lower_bound(row.idx, row.idx + row.nnz, start);
+
+      for (; it != row.idx + row.nnz && *it < end; it++) {
+	if (active != nullptr && !active[*it])
+	  continue;
+
+	int b = row.vals[it - row.idx];
+
+	AccT &bin = ((AccT *) histograms[*it].bins.ptr)[b];
+	bin.g += gh[j].g;
+	bin.h += gh[j].h;
+      }
+    }
+  }
+
+  /// @brief Build the histograms of the bundles in [start, end) from bundled bins
+  ///
+  /// Every entry is added (including missing values) since the bundles are unbundled
+  /// into per-feature histograms before they are scanned
+  template <typename AccT, typename PairT>
+  static void build_histograms(const CNum::Data::BundledBins &X,
+			       const CNum::Data::Shelf *shelves,
+			       const PairT *gh,
+			       const size_t *indeces,
+			       const DataPartition &partition,
+			       const arena_view_t &hist_view,
+			       size_t start,
+			       size_t end,
+			       const uint8_t *active) {
+    for (size_t i = start; i < end; i++) {
+      if (active != nullptr && !active[i])
+	continue;
+
+      AccT *bins = (AccT *) ((Histogram *) hist_view.ptr)[i].bins.ptr;
+
+      auto row = X.get_bins().get_row_view(i);
+      for (size_t j = partition.start; j < partition.end; j++) {
+	int b = row[indeces[j]];
+
+	bins[b].g += gh[j].g;
+	bins[b].h += gh[j].h;
+      }
+    }
+  }
+
+  /// @brief Finish the histograms in [start, end) once every row block was added
+  ///
+  /// Feature-major and bundled bins visit every row so there is nothing left to add
+  template <typename MatrixT>
+  static void finish_histograms(const MatrixT &X,
+				const CNum::Data::Shelf *shelves,
+				const arena_view_t &hist_view,
+				size_t start,
+				size_t end,
+				double gs,
+				double hs,
+				const uint8_t *active) {}
+
+  /// @brief Add the statistics of the implicit zeros of CSR bins (what is left of
+  /// the node totals) to the bin of 0.0
+  static void finish_histograms(const SparseMatrix<uint8_t> &X,
+				const CNum::Data::Shelf *shelves,
+				const arena_view_t &hist_view,
+				size_t start,
+				size_t end,
+				double gs,
+				double hs,
+				const uint8_t *active) {
+    Histogram *histograms = (Histogram *) hist_view.ptr;
+
+    for (size_t i = start; i < end; i++) {
+      if (active != nullptr && !active[i])
+	continue;
+
+      GradientPair *bins = (GradientPair *) histograms[i].bins.ptr;
+      int zero_bin = shelves[i].bin_of(0.0);
+      int n_bins = shelves[i].num_bins;
+
+      double g_stored{ 0.0 }, h_stored{ 0.0 };
+      for (int b = 0; b < n_bins; b++) {
+	g_stored += bins[b].g;
+	h_stored += bins[b].h;
+      }
+
+      bins[zero_bin].g += gs - g_stored;
+      bins[zero_bin].h += hs - h_stored;
+    }
+  }
+
+  /// @brief Lay out zeroed histograms shaped like hist_view in heap memory
+  /// @tparam AccT The type of the bins (GradientPair or IntPair)
+  /// @param hist_view The histograms to copy the shape of
+  /// @param histograms Where the histogram views are stored
+  /// @param storage Where the bins are stored
+  /// @return A view of the histograms
+  template <typename AccT>
+  static arena_view_t block_hist_view(const arena_view_t &hist_view,
+				      ::std::vector<Histogram> &histograms,
+				      ::std::vector<AccT> &storage) {
+    const Histogram *shape = (const Histogram *) hist_view.ptr;
+    size_t total_bins{ 0 };
+    for (size_t i = 0; i < hist_view.range; i++)
+      total_bins += shape[i].bins.range;
+
+    histograms.resize(hist_view.range);
+    storage.assign(total_bins, AccT{});
+
+    AccT *bins = storage.data();
+    for (size_t i = 0; i < hist_view.range; i++) {
+      histograms[i].bins = { bins, shape[i].bins.range, sizeof(AccT) };
+      bins += shape[i].bins.range;
+    }
+
+    return { histograms.data(), histograms.size(), sizeof(Histogram) };
+  }
+
+  /// @brief Add the histograms in [start, end) of a row block to the node's histograms
+  static void add_histograms(const arena_view_t &hist_view,
+			     const arena_view_t &block_view,
+			     size_t start,
+			     size_t end,
+			     const uint8_t *active) {
+    Histogram *histograms = (Histogram *) hist_view.ptr;
+    const Histogram *block_histograms = (const Histogram *) block_view.ptr;
+
+    for (size_t i = start; i < end; i++) {
+      if (active != nullptr && !active[i])
+	continue;
+
+      GradientPair *bins = (GradientPair *) histograms[i].bins.ptr;
+      const GradientPair *block_bins = (const GradientPair *) block_histograms[i].bins.ptr;
+
+      for (size_t j = 0; j < histograms[i].bins.range; j++) {
+	bins[j].g += block_bins[j].g;
+	bins[j].h += block_bins[j].h;
+      }
+    }
+  }
+
+  /// @brief Write the scaled sums of the integer histograms in [start, end) of every
+  /// row block to the node's histograms
+  ///
+  /// Integer sums do not depend on the order they are added in
+  static void dequantize_histograms(const arena_view_t &hist_view,
+				    const ::std::vector<arena_view_t> &int_views,
+				    size_t start,
+				    size_t end,
+				    GradientPair scale,
+				    const uint8_t *active) {
+    Histogram *histograms = (Histogram *) hist_view.ptr;
+
+    for (size_t i = start; i < end; i++) {
+      if (active != nullptr && !active[i])
+	continue;
+
+      GradientPair *bins = (GradientPair *) histograms[i].bins.ptr;
+
+      for (size_t j = 0; j < histograms[i].bins.range; j++) {
+	int64_t g{ 0 }, h{ 0 };
+	for (auto &view: int_views) {
+	  const IntPair &bin = ((const IntPair *) ((const Histogram *) view.ptr)[i].bins.ptr)[j];
+	  g += bin.g;
+	  h += bin.h;
+	}
+
+	bins[j] = { g * scale.g, h * scale.h };
+      }
+    }
+  }
+
+  /// @brief Replace best with s if s is the better split
+  static void keep_better_split(Split &best, const Split &s) {
+    // ties go to the lowest feature so the split does not depend on the task layout
+    if (s.best_gain > best.best_gain ||
+	(s.feature != -1 && s.best_gain == best.best_gain && s.feature < best.feature))
+      best = s;
+  }
+
+  /// @brief Call fn(feature, bins) for the feature of a histogram
+  template <typename MatrixT, typename Fn>
+  static void visit_histograms(const MatrixT &X,
+			       const CNum::Data::Shelf *shelves,
+			       const arena_view_t &hist_view,
+			       size_t i,
+			       double gs,
+			       double hs,
+			       Fn &&fn) {
+    fn(i, (const GradientPair *) ((Histogram *) hist_view.ptr)[i].bins.ptr);
+  }
+
+  /// @brief Call fn(feature, bins) for every feature of a bundle's histogram
+  template <typename Fn>
+  static void visit_histograms(const CNum::Data::BundledBins &X,
+			       const CNum::Data::Shelf *shelves,
+			       const arena_view_t &hist_view,
+			       size_t i,
+			       double gs,
+			       double hs,
+			       Fn &&fn) {
+    const GradientPair *bundle_bins = (const GradientPair *) ((Histogram *) hist_view.ptr)[i].bins.ptr;
+    GradientPair bins[N_BINS];
+
+    for (size_t feature: X.get_bundle_features(i)) {
+      X.unbundle(feature, bundle_bins, gs, hs, bins, shelves[feature].num_bins);
+      fn(feature, bins);
+    }
+  }
+
+  void TreeBoosterNode::scan_histogram(const CNum::Data::Shelf &shelf,
+				       size_t feature,
+				       const GradientPair *bins,
+				       double gs,
+				       double hs,
+				       double weight_decay,
+				       double reg_lambda,
+				       double gamma,
+				       Split &s) {
+    if (shelf.is_categorical) {
+      scan_categorical(shelf, feature, bins, gs, hs, weight_decay, reg_lambda, gamma, s);
+      return;
+    }
+
+    int missing_bin = shelf.missing_bin();
+    int n_bins = missing_bin < 0 ? shelf.num_bins : missing_bin;
+    GradientPair missing{ gs, hs };
+    if (missing_bin >= 0) {
+      for (int b = 0; b < n_bins; b++) {
+	missing.g -= bins[b].g;
+	missing.h -= bins[b].h;
+      }
+    }
+
+    ScanCandidate best = scan_bins(bins, n_bins, { gs, hs }, missing_bin >= 0 ? &missing : nullptr,
+				   weight_decay, reg_lambda, gamma);
+
+    // ties go to the lowest feature so the split does not depend on the feature order
+    bool better = best.gain > s.best_gain || (best.gain == s.best_gain && static_cast<int>(feature) < s.feature);
+    if (best.bin < 0 || !better)
+      return;
+
+    double gr = gs - best.left.g;
+    double hr = hs - best.left.h;
+
+    s.best_gain = best.gain;
+    s.feature = feature;
+    s.threshold = shelf.ranges[best.bin];
+    s.bin = best.bin;
+    s.default_left = best.missing_left;
+    s.cat_bitset.clear();
+    s.cat_values.clear();
+
+    s.values.first = -best.left.g / (best.left.h + reg_lambda);
+    s.values.second = -gr / (hr + reg_lambda);
+  }
+
+  void TreeBoosterNode::scan_categorical(const CNum::Data::Shelf &shelf,
+					 size_t feature,
+					 const GradientPair *bins,
+					 double gs,
+					 double hs,
+					 double weight_decay,
+					 double reg_lambda,
+					 double gamma,
+					 Split &s) {
+    if (shelf.num_bins < 2)
+      return;
+
+    // the last bin (unseen categories and missing values) always goes right
+    size_t n_categories = shelf.num_bins - 1;
+    ::std::vector<uint16_t> order(n_categories);
+    size_t n_present{ 0 };
+
+    for (size_t b = 0; b < n_categories; b++) {
+      if (bins[b].h > 0)
+	order[n_present++] = b;
+    }
+
+    // ordering the categories by their leaf value makes the best partition of them
+    // one of the prefixes of the ordering (Fisher), both ends are tried
+    ::std::stable_sort(order.begin(), order.begin() + n_present, [&] (uint16_t a, uint16_t b) {
+      return bins[a].g / (bins[a].h + reg_lambda) < bins[b].g / (bins[b].h + reg_lambda);
+    });
+
+    bool found{ false };
+    int best_dir{ 0 };
+    size_t best_len{ 0 };
+
+    for (int dir = 0; dir < 2; dir++) {
+      double gl{ 0.0 }, hl{ 0.0 };
+
+      for (size_t len = 1; len <= n_present; len++) {
+	uint16_t b = dir == 0 ? order[len - 1] : order[n_present - len];
+	gl += bins[b].g;
+	hl += bins[b].h;
+
+	// the right side has to hold something
+	if (len == n_present && bins[n_categories].h <= 0)
+	  break;
+
+	double gr = gs - gl;
+	double hr = hs - hl;
+
+	if (hl < weight_decay || hr < weight_decay)
+	  continue;
+
+	double gain = TreeBoosterNode::get_gain(gs, hs, gl, hl, gr, hr, reg_lambda, gamma);
+	bool better = gain > s.best_gain || (gain == s.best_gain && static_cast<int>(feature) < s.feature);
+	if (gain > gamma && better) {
+	  s.best_gain = gain;
+	  s.feature = feature;
+	  s.threshold = 0.0;
+	  s.bin = -1;
+	  s.default_left = false;
+
+	  s.values.first = -gl / (hl + reg_lambda);
+	  s.values.second = -gr / (hr + reg_lambda);
+
+	  found = true;
+	  best_dir = dir;
+	  best_len = len;
+	}
+      }
+    }
+
+    if (!found)
+      return;
+
+    // the bitset is indexed by bin, the split keeps the bins' categories to map values
+    // to them
+    s.cat_values.assign(shelf.ranges.get(), shelf.ranges.get() + shelf.num_bins - 1);
+    s.cat_bitset.assign((shelf.num_bins - 1 + 31) / 32, 0);
+    for (size_t i = 0; i < best_len; i++) {
+      uint16_t b = best_dir == 0 ? order[i] : order[n_present - 1 - i];
+      s.cat_bitset[b / 32] |= uint32_t{ 1 } << (b % 32);
+    }
+  }
+
+  Split TreeBoosterNode::find_best_split_hist(const Matrix<uint8_t> &X,
 					      std::shared_ptr<CNum::Data::Shelf[]> shelves,
-					      const double *g,
-					      const double *h,
+					      const GradientPair *gh,
 					      bool histogram_cache,
 					      const arena_view_t &hist_view,
 					      DataPartition &partition,
 					      double weight_decay,
 					      double reg_lambda,
-					      double gamma) {
-    constexpr uint8_t n_threads = 32;
-    size_t n_features = X.get_rows();
-    size_t features_per_thread = (n_features + n_threads - 1) / n_threads;
-    
-    auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
-    ::std::vector< ::std::future<Split> > futures;
-    futures.reserve(n_threads);
+					      double gamma,
+					      const QuantizedGradients *quantized,
+					      bool parallel,
+					      const ColumnSample *columns) {
+    return find_best_split_hist_impl(X, shelves, gh, histogram_cache, hist_view, partition,
+				     weight_decay, reg_lambda, gamma, quantized, parallel, columns);
+  }
+
+  Split TreeBoosterNode::find_best_split_hist(const Matrix<uint16_t> &X,
+					      std::shared_ptr<CNum::Data::Shelf[]> shelves,
+					      const GradientPair *gh,
+					      bool histogram_cache,
+					      const arena_view_t &hist_view,
+					      DataPartition &partition,
+					      double weight_decay,
+					      double reg_lambda,
+					      double gamma,
+					      const QuantizedGradients *quantized,
+					      bool parallel,
+					      const ColumnSample *columns) {
+    return find_best_split_hist_impl(X, shelves, gh, histogram_cache, hist_view, partition,
+				     weight_decay, reg_lambda, gamma, quantized, parallel, columns);
+  }
+
+  Split TreeBoosterNode::find_best_split_hist(const SparseMatrix<uint8_t> &X,
+					      std::shared_ptr<CNum::Data::Shelf[]> shelves,
+					      const GradientPair *gh,
+					      bool histogram_cache,
+					      const arena_view_t &hist_view,
+					      DataPartition &partition,
+					      double weight_decay,
+					      double reg_lambda,
+					      double gamma,
+					      const QuantizedGradients *quantized,
+					      bool parallel,
+					      const ColumnSample *columns) {
+    return find_best_split_hist_impl(X, shelves, gh, histogram_cache, hist_view, partition,
+				     weight_decay, reg_lambda, gamma, quantized, parallel, columns);
+  }
+
+  Split TreeBoosterNode::find_best_split_hist(const CNum::Data::BundledBins &X,
+					      std::shared_ptr<CNum::Data::Shelf[]> shelves,
+					      const GradientPair *gh,
+					      bool histogram_cache,
+					      const arena_view_t &hist_view,
+					      DataPartition &partition,
+					      double weight_decay,
+					      double reg_lambda,
+					      double gamma,
+					      const QuantizedGradients *quantized,
+					      bool parallel,
+					      const ColumnSample *columns) {
+    return find_best_split_hist_impl(X, shelves, gh, histogram_cache, hist_view, partition,
+				     weight_decay, reg_lambda, gamma, quantized, parallel, columns);
+  }
+
+  template <typename MatrixT>
+  Split TreeBoosterNode::find_best_split_hist_impl(const MatrixT &X,
+						   std::shared_ptr<CNum::Data::Shelf[]> shelves,
+						   const GradientPair *gh,
+						   bool histogram_cache,
+						   const arena_view_t &hist_view,
+						   DataPartition &partition,
+						   double weight_decay,
+						   double reg_lambda,
+						   double gamma,
+						   const QuantizedGradients *quantized,
+						   bool parallel,
+						   const ColumnSample *columns) {
+    // the row blocks only depend on the node's row count so the histogram sums (and
+    // the trees) are the same whatever the size of the pool
+    constexpr size_t rows_per_block = 16384;
+    constexpr size_t max_blocks = 16;
 
+    size_t n_histograms = histogram_count(X);
+    size_t n_rows = partition.end - partition.start;
     size_t *indeces = (size_t *) partition.global_idx_array->ptr;
 
-    double gs = ::std::reduce(g + partition.start, g + partition.end);
-    double hs = ::std::reduce(h + partition.start, h + partition.end);
+    GradientPair sums = sum_gradients(gh, partition);
+    double gs = sums.g;
+    double hs = sums.h;
+
+    // only the sampled columns are built and scanned
+    const uint8_t *active = columns != nullptr ? columns->histograms : nullptr;
+    const uint8_t *scanned = columns != nullptr ? columns->features : nullptr;
     
-    for (uint8_t thread_num = 0; thread_num < n_threads; thread_num++) {
-      futures.push_back(tp->submit< Split >([&, thread_num] (arena_t *arena) {
-	size_t start = thread_num * features_per_thread;
-	size_t end = ::std::min(n_features, start + features_per_thread);
+    auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+    size_t n_workers = tp->get_num_threads();
+
+    // large nodes are split into row blocks (row-parallel) and features into groups
+    // (feature-parallel), with enough blocks x groups to keep the pool busy
+    size_t n_blocks = histogram_cache ? 1 : ::std::clamp((n_rows + rows_per_block - 1) / rows_per_block,
+							  size_t{ 1 },
+							  max_blocks);
+    size_t max_tasks = ::std::max(size_t{ 1 }, n_rows * n_histograms / min_task_work);
+    size_t n_groups = ::std::min({ n_histograms, parallel ? (2 * n_workers + n_blocks - 1) / n_blocks : 1, max_tasks });
+    if (n_groups == 0)
+      return { -1, 0.0, 0.0, 0, { 0.0, 0.0 }, false };
 
-	Split s{ -1, 0.0, 0.0, 0, { 0.0, 0.0 } };
+    size_t histograms_per_group = (n_histograms + n_groups - 1) / n_groups;
+    n_groups = (n_histograms + histograms_per_group - 1) / histograms_per_group;
+    size_t block_rows = (n_rows + n_blocks - 1) / n_blocks;
 	
-	for (int i = start; i < end; i++) {
-	  Histogram hist = ((Histogram *) hist_view.ptr)[i];
-	  double *g_bin = (double *) hist.g_bin.ptr;
-	  double *h_bin = (double *) hist.h_bin.ptr;
+    auto block_partition = [&] (size_t b) -> DataPartition {
+      size_t start = partition.start + b * block_rows;
+      return { partition.global_idx_array, start, ::std::min(partition.end, start + block_rows) };
+    };
 
-	  auto row = X.get_row_view(i);
+    // quantized pairs are summed in 32-bit integers so a block's sums have to fit
+    bool quantize = quantized != nullptr && !histogram_cache &&
+      block_rows * static_cast<size_t>(quantized->levels) < static_cast<size_t>(::std::numeric_limits<int32_t>::max());
 
-	  // if we are using a cached histogram we do not need to build the histogram
-	  if (!histogram_cache) {
-	    for (int j = partition.start; j < partition.end; j++) {	    
-	      int b = row[indeces[j]];
+    // the first block is built in the node's histograms and the others in their own,
+    // which are added to it in block order. Quantized pairs are built in integer
+    // histograms for every block
+    ::std::vector< ::std::vector<Histogram> > block_histograms(n_blocks);
+    ::std::vector< ::std::vector<GradientPair> > block_storage(n_blocks);
+    ::std::vector< ::std::vector<IntPair> > int_storage(quantize ? n_blocks : 0);
+    ::std::vector<arena_view_t> block_views(n_blocks, hist_view);
 
-	      g_bin[b] += g[j];
-	      h_bin[b] += h[j];
-	    }
-	  }
+    for (size_t b = 0; b < n_blocks; b++) {
+      if (quantize)
+	block_views[b] = block_hist_view(hist_view, block_histograms[b], int_storage[b]);
+      else if (b > 0)
+	block_views[b] = block_hist_view(hist_view, block_histograms[b], block_storage[b]);
+    }
 
-	  double gl{ 0.0 }, hl{ 0.0 };
-	  double c1{ 0.0 }, c2{ 0.0 };
-	
-	  // want to make splits between bins so we skip last (N_BINS - 1)
-	  for (int j = 0; j < N_BINS - 1; j++) {
-	    // kahan sum for numerical stability
-	    double y = g_bin[j] - c1;
-	    double t = gl + y;
-	    c1 = (t - gl) - y;
-	    gl = t;
-
-	    y = h_bin[j] - c2;
-	    t = hl + y;
-	    c2 = (t - hl) - y;
-	    hl = t;
-        
-	    double gr = gs - gl;
-	    double hr = hs - hl;
-
-	    // want to make splits between bins so we skip first
-	    if (j == 0) 
-	      continue;
-
-	    if (hl < weight_decay || hr < weight_decay)
-	      continue;
-
-	    double gain = TreeBoosterNode::get_gain(gs, hs, gl, hl, gr, hr, reg_lambda, gamma);
-	    if (gain < gamma) {
-	      continue;
-	    }
-	
-	    if (gain > gamma && gain > s.best_gain) {
-	      s.best_gain = gain;
-	      s.feature = i;
-	      s.threshold = shelves[i].ranges[j];
-	      s.bin = j;
-
-	      s.values.first = -gl / (hl + reg_lambda);
-	      s.values.second = -gr / (hr + reg_lambda);
-	    
-	    }
-	  }
+    auto build_block = [&] (size_t b, size_t start, size_t end) {
+      if (quantize)
+	build_histograms<IntPair>(X, shelves.get(), quantized->pairs, indeces, block_partition(b), block_views[b], start, end, active);
+      else
+	build_histograms<GradientPair>(X, shelves.get(), gh, indeces, block_partition(b), block_views[b], start, end, active);
+    };
+
+    // serial searches still build the row blocks so the sums are the same
+    if (n_blocks > 1 && !parallel) {
+      for (size_t b = 0; b < n_blocks; b++)
+	build_block(b, 0, n_histograms);
+    } else if (n_blocks > 1) {
+      ::std::vector< ::std::future<void> > builds;
+      builds.reserve(n_blocks * n_groups);
+
+      for (size_t b = 0; b < n_blocks; b++) {
+	for (size_t group = 0; group < n_groups; group++) {
+	  builds.push_back(tp->submit< void >([&, b, group] (arena_t *arena) {
+	    size_t start = group * histograms_per_group;
+	    size_t end = ::std::min(n_histograms, start + histograms_per_group);
+	    build_block(b, start, end);
+	  }));
 	}
-	return s;
-      }));
+      }
+
+      // every block has to finish before an error is rethrown, they write to this
+      // function's block histograms
+      for (auto &t: builds)
+	t.wait();
+
+      for (auto &t: builds)
+	t.get();
     }
 
+    auto scan_group = [&] (size_t group) -> Split {
+      size_t start = group * histograms_per_group;
+      size_t end = ::std::min(n_histograms, start + histograms_per_group);
+      Split s{ -1, 0.0, 0.0, 0, { 0.0, 0.0 }, false };
+
+      // if we are using a cached histogram we do not need to build the histograms
+      if (!histogram_cache) {
+	if (n_blocks == 1)
+	  build_block(0, start, end);
+
+	if (quantize) {
+	  dequantize_histograms(hist_view, block_views, start, end, quantized->scale, active);
+	} else {
+	  for (size_t b = 1; b < n_blocks; b++)
+	    add_histograms(hist_view, block_views[b], start, end, active);
+	}
+
+	finish_histograms(X, shelves.get(), hist_view, start, end, gs, hs, active);
+      }
+
+      for (size_t i = start; i < end; i++) {
+	if (active != nullptr && !active[i])
+	  continue;
+
+	visit_histograms(X, shelves.get(), hist_view, i, gs, hs, [&] (size_t feature, const GradientPair *bins) {
+	  if (scanned != nullptr && !scanned[feature])
+	    return;
+
+	  scan_histogram(shelves[feature], feature, bins, gs, hs, weight_decay, reg_lambda, gamma, s);
+	});
+      }
+      return s;
+    };
+
+    // small nodes are not worth a task submission
+    if (n_groups == 1)
+      return scan_group(0);
+
+    ::std::vector< ::std::future<Split> > futures;
+    futures.reserve(n_groups);
+    for (size_t group = 0; group < n_groups; group++)
+      futures.push_back(tp->submit< Split >([&, group] (arena_t *arena) { return scan_group(group); }));
+
     return TreeBoosterNode::split_comparison(futures);
   }
 
+  ::std::vector<Split> TreeBoosterNode::find_best_splits_hist(const Matrix<uint8_t> &X,
+							    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+							    const GradientPair *gh,
+							    const ::std::vector<arena_view_t> &hist_views,
+							    const ::std::vector<DataPartition> &partitions,
+							    double weight_decay,
+							    double reg_lambda,
+							    double gamma,
+							    const QuantizedGradients *quantized,
+							    const ColumnSample *columns) {
+    return find_best_splits_hist_impl(X, shelves, gh, hist_views, partitions,
+				      weight_decay, reg_lambda, gamma, quantized, columns);
+  }
+
+  ::std::vector<Split> TreeBoosterNode::find_best_splits_hist(const Matrix<uint16_t> &X,
+							    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+							    const GradientPair *gh,
+							    const ::std::vector<arena_view_t> &hist_views,
+							    const ::std::vector<DataPartition> &partitions,
+							    double weight_decay,
+							    double reg_lambda,
+							    double gamma,
+							    const QuantizedGradients *quantized,
+							    const ColumnSample *columns) {
+    return find_best_splits_hist_impl(X, shelves, gh, hist_views, partitions,
+				      weight_decay, reg_lambda, gamma, quantized, columns);
+  }
+
+  ::std::vector<Split> TreeBoosterNode::find_best_splits_hist(const SparseMatrix<uint8_t> &X,
+							    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+							    const GradientPair *gh,
+							    const ::std::vector<arena_view_t> &hist_views,
+							    const ::std::vector<DataPartition> &partitions,
+							    double weight_decay,
+							    double reg_lambda,
+							    double gamma,
+							    const QuantizedGradients *quantized,
+							    const ColumnSample *columns) {
+    return find_best_splits_hist_impl(X, shelves, gh, hist_views, partitions,
+				      weight_decay, reg_lambda, gamma, quantized, columns);
+  }
+
+  ::std::vector<Split> TreeBoosterNode::find_best_splits_hist(const CNum::Data::BundledBins &X,
+							    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+							    const GradientPair *gh,
+							    const ::std::vector<arena_view_t> &hist_views,
+							    const ::std::vector<DataPartition> &partitions,
+							    double weight_decay,
+							    double reg_lambda,
+							    double gamma,
+							    const QuantizedGradients *quantized,
+							    const ColumnSample *columns) {
+    return find_best_splits_hist_impl(X, shelves, gh, hist_views, partitions,
+				      weight_decay, reg_lambda, gamma, quantized, columns);
+  }
+
+  template <typename MatrixT>
+  ::std::vector<Split> TreeBoosterNode::find_best_splits_hist_impl(const MatrixT &X,
+								 std::shared_ptr<CNum::Data::Shelf[]> shelves,
+								 const GradientPair *gh,
+								 const ::std::vector<arena_view_t> &hist_views,
+								 const ::std::vector<DataPartition> &partitions,
+								 double weight_decay,
+								 double reg_lambda,
+								 double gamma,
+								 const QuantizedGradients *quantized,
+								 const ColumnSample *columns) {
+    size_t n_nodes = partitions.size();
+    ::std::vector<Split> splits(n_nodes, Split{ -1, 0.0, 0.0, 0, { 0.0, 0.0 }, false });
+    if (n_nodes == 0)
+      return splits;
+
+    size_t n_histograms = histogram_count(X);
+    size_t *indeces = (size_t *) partitions[0].global_idx_array->ptr;
+
+    size_t n_rows{ 0 }, max_rows{ 0 };
+    ::std::vector<GradientPair> sums(n_nodes);
+    for (size_t node = 0; node < n_nodes; node++) {
+      size_t rows = partitions[node].end - partitions[node].start;
+      n_rows += rows;
+      max_rows = ::std::max(max_rows, rows);
+      sums[node] = sum_gradients(gh, partitions[node]);
+    }
+
+    auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+    size_t n_workers = tp->get_num_threads();
+
+    size_t max_tasks = ::std::max(size_t{ 1 }, n_rows * n_histograms / min_task_work);
+    size_t n_groups = ::std::min({ n_histograms, 2 * n_workers, max_tasks });
+    if (n_groups == 0)
+      return splits;
+
+    size_t histograms_per_group = (n_histograms + n_groups - 1) / n_groups;
+    n_groups = (n_histograms + histograms_per_group - 1) / histograms_per_group;
+
+    // each node is built in one block, so its quantized sums have to fit in 32 bits
+    bool quantize = quantized != nullptr &&
+      max_rows * static_cast<size_t>(quantized->levels) < static_cast<size_t>(::std::numeric_limits<int32_t>::max());
+
+    ::std::vector< ::std::vector<Histogram> > int_histograms(quantize ? n_nodes : 0);
+    ::std::vector< ::std::vector<IntPair> > int_storage(quantize ? n_nodes : 0);
+    ::std::vector<arena_view_t> int_views(quantize ? n_nodes : 0);
+    for (size_t node = 0; node < int_views.size(); node++)
+      int_views[node] = block_hist_view(hist_views[node], int_histograms[node], int_storage[node]);
+
+    // the nodes of a level share the tree's sampled histograms
+    auto active = [&] (size_t node) -> const uint8_t * {
+      return columns != nullptr ? columns[node].histograms : nullptr;
+    };
+
+    auto build = [&] (size_t node, size_t start, size_t end) {
+      if (quantize)
+	build_histograms<IntPair>(X, shelves.get(), quantized->pairs, indeces, partitions[node], int_views[node], start, end, active(node));
+      else
+	build_histograms<GradientPair>(X, shelves.get(), gh, indeces, partitions[node], hist_views[node], start, end, active(node));
+    };
+
+    auto scan_group = [&] (size_t group) -> ::std::vector<Split> {
+      size_t start = group * histograms_per_group;
+      size_t end = ::std::min(n_histograms, start + histograms_per_group);
+
+      // feature-major bins are streamed a feature at a time for every node, sparse
+      // bins are row-major so they are streamed a node at a time
+      if constexpr (::std::is_same_v<MatrixT, SparseMatrix<uint8_t> >) {
+	for (size_t node = 0; node < n_nodes; node++)
+	  build(node, start, end);
+      } else {
+	for (size_t i = start; i < end; i++) {
+	  for (size_t node = 0; node < n_nodes; node++)
+	    build(node, i, i + 1);
+	}
+      }
+
+      ::std::vector<Split> group_splits(n_nodes, Split{ -1, 0.0, 0.0, 0, { 0.0, 0.0 }, false });
+      for (size_t node = 0; node < n_nodes; node++) {
+	double gs = sums[node].g;
+	double hs = sums[node].h;
+
+	if (quantize)
+	  dequantize_histograms(hist_views[node], { int_views[node] }, start, end, quantized->scale, active(node));
+
+	finish_histograms(X, shelves.get(), hist_views[node], start, end, gs, hs, active(node));
+
+	const uint8_t *scanned = columns != nullptr ? columns[node].features : nullptr;
+	for (size_t i = start; i < end; i++) {
+	  if (active(node) != nullptr && !active(node)[i])
+	    continue;
+
+	  visit_histograms(X, shelves.get(), hist_views[node], i, gs, hs, [&] (size_t feature, const GradientPair *bins) {
+	    if (scanned != nullptr && !scanned[feature])
+	      return;
+
+	    scan_histogram(shelves[feature], feature, bins, gs, hs, weight_decay, reg_lambda, gamma, group_splits[node]);
+	  });
+	}
+      }
+
+      return group_splits;
+    };
+
+    if (n_groups == 1)
+      return scan_group(0);
+
+    ::std::vector< ::std::future< ::std::vector<Split> > > futures;
+    futures.reserve(n_groups);
+    for (size_t group = 0; group < n_groups; group++)
+      futures.push_back(tp->submit< ::std::vector<Split> >([&, group] (arena_t *arena) { return scan_group(group); }));
+
+    // every group has to finish before an error is rethrown, they use the histograms
+    for (auto &f: futures)
+      f.wait();
+
+    for (auto &f: futures) {
+      auto group_splits = f.get();
+      for (size_t node = 0; node < n_nodes; node++)
+	keep_better_split(splits[node], group_splits[node]);
+    }
+
+    return splits;
+  }
+
   Split TreeBoosterNode::split_comparison(::std::vector< ::std::future<Split> > &splits) {
-    Split best_split{ -1, 0, 0 };
+    Split best_split{ -1, 0, 0, 0, { 0.0, 0.0 }, false };
+
+    // every group has to finish before an error is rethrown, they use the caller's
+    // histograms
+    for (auto &future: splits)
+      future.wait();
+
     for (auto &future: splits) {
-      Split s = future.get();
-      if (s.best_gain > best_split.best_gain)
-	best_split = s;
+      keep_better_split(best_split, future.get());
     }
 
     return best_split;
@@ -144,7 +850,23 @@ namespace CNum::Model::Tree {
   ::std::string TreeBoosterNode::to_json_string() {
     ::std::string json_str("{\"split\": {");
     json_str += "\"feature\":" + ::std::to_string(_split.feature) + ",";
-    json_str += "\"threshold\":" + ::std::to_string(_split.threshold) + "},";
+    json_str += "\"threshold\":" + ::std::to_string(_split.threshold) + ",";
+    json_str += "\"default_left\":" + ::std::string(_split.default_left ? "true" : "false");
+
+    if (!_split.cat_bitset.empty()) {
+      json_str += ",\"categories\":[";
+      for (uint32_t word: _split.cat_bitset)
+	json_str += ::std::to_string(word) + ",";
+
+      json_str.back() = ']';
+      json_str += ",\"category_values\":[";
+      for (double c: _split.cat_values)
+	json_str += ::std::to_string(static_cast<int64_t>(c)) + ",";
+
+      json_str.back() = ']';
+    }
+
+    json_str += "},";
     json_str += "\"value\":" + ::std::to_string(_value) + ",";
     json_str += "\"left\":" + (_left != nullptr ? _left->to_json_string() + "," : "{},");
     json_str += "\"right\":" + (_right != nullptr ? _right->to_json_string() : "{}");
@@ -1,8 +1,25 @@
 #include "CNum/Model/Tree/XGTreeBooster.h"
 
+#include <queue>
+
 using namespace CNum::DataStructs;
 
 namespace CNum::Model::Tree {
+
+  /// @brief The number of bins of a feature's histogram
+  template <typename MatrixT>
+  static size_t histogram_bins(const MatrixT &X, const CNum::Data::Shelf *shelves, size_t i) {
+    return shelves[i].num_bins;
+  }
+
+  /// @brief The number of bins of a bundle's histogram
+  static size_t histogram_bins(const CNum::Data::BundledBins &X, const CNum::Data::Shelf *shelves, size_t i) {
+    return X.get_bundle_bins(i);
+  }
+
+  /// @brief The fewest row-histogram visits per worker of a node whose split search
+  /// is spread over the ThreadPool (smaller nodes build their subtrees as tasks)
+  constexpr size_t parallel_node_work = size_t{ 1 } << 15;
   
   XGTreeBooster::XGTreeBooster(arena_t *a,
 			       int md,
@@ -18,35 +35,82 @@ namespace CNum::Model::Tree {
 
   
   void XGTreeBooster::fit_node_greedy(const Matrix<double> &X,
-				      double *g,
-				      double *h,
+				      GradientPair *gh,
 				      TreeBoosterNode *node,
 				      int depth) {
     // Exact greedy method coming soon
   }
 
   
-  void XGTreeBooster::fit_node_hist(const Matrix<int> &X,
+  void XGTreeBooster::fit_node_hist(const Matrix<uint8_t> &X,
+				    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+				    GradientPair *gh,
+				    DataPartition &partition,
+				    const arena_view_t &parent_hist_view,
+				    TreeBoosterNode *node,
+				    int depth) {
+    fit_node_hist_impl(X, shelves, gh, partition, parent_hist_view, node, depth, _arena, nullptr);
+  }
+
+
+  void XGTreeBooster::fit_node_hist(const Matrix<uint16_t> &X,
 				    std::shared_ptr<CNum::Data::Shelf[]> shelves,
-				    double *g,
-				    double *h,
+				    GradientPair *gh,
 				    DataPartition &partition,
 				    const arena_view_t &parent_hist_view,
 				    TreeBoosterNode *node,
 				    int depth) {
+    fit_node_hist_impl(X, shelves, gh, partition, parent_hist_view, node, depth, _arena, nullptr);
+  }
+
+
+  void XGTreeBooster::fit_node_hist(const SparseMatrix<uint8_t> &X,
+				    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+				    GradientPair *gh,
+				    DataPartition &partition,
+				    const arena_view_t &parent_hist_view,
+				    TreeBoosterNode *node,
+				    int depth) {
+    fit_node_hist_impl(X, shelves, gh, partition, parent_hist_view, node, depth, _arena, nullptr);
+  }
+
+
+  void XGTreeBooster::fit_node_hist(const CNum::Data::BundledBins &X,
+				    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+				    GradientPair *gh,
+				    DataPartition &partition,
+				    const arena_view_t &parent_hist_view,
+				    TreeBoosterNode *node,
+				    int depth) {
+    fit_node_hist_impl(X, shelves, gh, partition, parent_hist_view, node, depth, _arena, nullptr);
+  }
+
+
+  template <typename MatrixT>
+  void XGTreeBooster::fit_node_hist_impl(const MatrixT &X,
+					 std::shared_ptr<CNum::Data::Shelf[]> shelves,
+					 GradientPair *gh,
+					 DataPartition &partition,
+					 const arena_view_t &parent_hist_view,
+					 TreeBoosterNode *node,
+					 int depth,
+					 arena_t *arena,
+					 ::std::vector< ::std::future<void> > *subtrees) {
     
     if (depth >= _max_depth || partition.end - partition.start < _min_samples || node->_split.feature == -1) {
       return;
     }
     
-    arena_view_t small_hist_view = TreeBooster::init_hist_view(X.get_rows());
+    arena_view_t small_hist_view = TreeBooster::init_hist_view(_hist_bins, arena);
     arena_view_t large_hist_view = parent_hist_view;
 
     // partition data based on split
-    size_t mid_point = TreeBooster::partition_data(X, g, h,
-						  node->_split.feature,
-						  node->_split.bin,
-						  partition);
+    size_t mid_point = TreeBooster::partition_data(X, gh,
+						  node->_split,
+						  shelves[node->_split.feature],
+						  partition,
+						  _quantized.pairs,
+						  subtrees != nullptr);
 
     if (mid_point == partition.start || mid_point == partition.end) { // if the left or right side has 0 samples
       return;
@@ -69,29 +133,42 @@ namespace CNum::Model::Tree {
     auto values = ::std::move(node->_split.values);
     left_subtree->_value = values.first;
     right_subtree->_value = values.second;
+    left_subtree->_rows = left_pos_ct;
+    right_subtree->_rows = right_pos_ct;
 
     enum split_dir small_side = left_pos_ct <= right_pos_ct ? LEFT : RIGHT;
+    DataPartition &small_partition = small_side == LEFT ? left_partition : right_partition;
+    DataPartition &large_partition = small_side == RIGHT ? left_partition : right_partition;
+
+    ::std::vector<uint8_t> small_features, large_features;
+    ColumnSample small_columns, large_columns;
     
-    auto split_small = TreeBoosterNode::find_best_split_hist(X, shelves, g, h,
+    auto split_small = TreeBoosterNode::find_best_split_hist(X, shelves, gh,
 							     false,
 							     small_hist_view,
-							     small_side == LEFT ? left_partition : right_partition,
+							     small_partition,
 							     TreeBooster::_weight_decay,
 							     TreeBooster::_reg_lambda,
-							     TreeBooster::_gamma);
+							     TreeBooster::_gamma,
+							     quantized(),
+							     subtrees != nullptr,
+							     node_columns(depth + 1, small_partition, small_features, small_columns));
 
     // histogram caching
     TreeBooster::histogram_subtraction(parent_hist_view,
 				       small_hist_view,
 				       large_hist_view);
 
-    auto split_large = TreeBoosterNode::find_best_split_hist(X, shelves, g, h,
+    auto split_large = TreeBoosterNode::find_best_split_hist(X, shelves, gh,
 							     true,
 							     large_hist_view,
-							     small_side == RIGHT ? left_partition : right_partition,
+							     large_partition,
 							     TreeBooster::_weight_decay,
 							     TreeBooster::_reg_lambda,
-							     TreeBooster::_gamma);
+							     TreeBooster::_gamma,
+							     quantized(),
+							     subtrees != nullptr,
+							     node_columns(depth + 1, large_partition, large_features, large_columns));
     
     if (small_side == LEFT) {
       left_subtree->_split = split_small;
@@ -101,73 +178,369 @@ namespace CNum::Model::Tree {
       right_subtree->_split = split_small;
     }
 
-    fit_node_hist(X, shelves, g, h,
-		  left_partition,
-		  small_side == LEFT ? small_hist_view : large_hist_view,
-		  left_subtree,
-		  depth + 1);
+    auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+    size_t min_parallel_work = parallel_node_work * tp->get_num_threads();
     
-    fit_node_hist(X, shelves, g, h,
-		  right_partition,
-		  small_side == RIGHT ? small_hist_view : large_hist_view,
-		  right_subtree,
-		  depth + 1);
+    auto fit_child = [&] (DataPartition child_partition, const arena_view_t &child_hist_view, TreeBoosterNode *child) {
+      size_t work = (child_partition.end - child_partition.start) * _hist_bins.size();
+      if (subtrees == nullptr || tp->get_num_threads() < 2 || work >= min_parallel_work) {
+	fit_node_hist_impl(X, shelves, gh, child_partition, child_hist_view, child, depth + 1, arena, subtrees);
+	return;
+      }
+
+      // the task's histograms go in the arena of the worker it runs on, which is
+      // cleared when the subtree is done
+      subtrees->push_back(tp->submit< void >([this, &X, shelves, gh, child_partition, child_hist_view, child, depth] (arena_t *task_arena) mutable {
+	try {
+	  fit_node_hist_impl(X, shelves, gh, child_partition, child_hist_view, child, depth + 1, task_arena, nullptr);
+	} catch (...) {
+	  arena_clear(task_arena);
+	  throw;
+	}
+
+	arena_clear(task_arena);
+      }));
+    };
+
+    fit_child(left_partition, small_side == LEFT ? small_hist_view : large_hist_view, left_subtree);
+    fit_child(right_partition, small_side == RIGHT ? small_hist_view : large_hist_view, right_subtree);
   
     node->_left = left_subtree;
     node->_right = right_subtree;
   }
 
+  template <typename MatrixT>
+  void XGTreeBooster::fit_level_wise(const MatrixT &X,
+				     std::shared_ptr<CNum::Data::Shelf[]> shelves,
+				     GradientPair *gh,
+				     DataPartition &root_partition,
+				     const arena_view_t &root_hist_view) {
+    struct LevelNode {
+      TreeBoosterNode *node;
+      DataPartition partition;
+      arena_view_t hist_view;
+    };
+
+    ::std::vector<LevelNode> level{ { _root, root_partition, root_hist_view } };
+
+    for (int depth = 0; depth < _max_depth && !level.empty(); depth++) {
+      ::std::vector<LevelNode> next_level;
+      ::std::vector<arena_view_t> small_views;
+      ::std::vector<DataPartition> small_partitions;
+      ::std::vector<LevelNode> large_children;
+      ::std::vector<arena_view_t> parent_views;
+
+      // the children of the last level are leaves, their values come from the split
+      bool search = depth + 1 < _max_depth;
+
+      for (auto &[node, partition, hist_view]: level) {
+	if (partition.end - partition.start < _min_samples || node->_split.feature == -1)
+	  continue;
+
+	size_t mid_point = TreeBooster::partition_data(X, gh,
+						      node->_split,
+						      shelves[node->_split.feature],
+						      partition,
+						      _quantized.pairs);
+
+	if (mid_point == partition.start || mid_point == partition.end)
+	  continue;
+
+	DataPartition left_partition{ partition.global_idx_array, partition.start, mid_point };
+	DataPartition right_partition{ partition.global_idx_array, mid_point, partition.end };
+
+	auto *left_subtree = new TreeBoosterNode();
+	auto *right_subtree = new TreeBoosterNode();
+
+	auto values = ::std::move(node->_split.values);
+	left_subtree->_value = values.first;
+	right_subtree->_value = values.second;
+	left_subtree->_rows = mid_point - partition.start;
+	right_subtree->_rows = partition.end - mid_point;
+
+	node->_left = left_subtree;
+	node->_right = right_subtree;
+
+	if (!search)
+	  continue;
+
+	bool left_small = left_partition.end - left_partition.start <= right_partition.end - right_partition.start;
+	arena_view_t small_hist_view = TreeBooster::init_hist_view(_hist_bins);
+
+	// the larger child's histograms replace the parent's
+	next_level.push_back({ left_small ? left_subtree : right_subtree,
+			       left_small ? left_partition : right_partition,
+			       small_hist_view });
+	large_children.push_back({ left_small ? right_subtree : left_subtree,
+				   left_small ? right_partition : left_partition,
+				   hist_view });
+	small_views.push_back(small_hist_view);
+	small_partitions.push_back(left_small ? left_partition : right_partition);
+      }
+
+      ::std::vector< ::std::vector<uint8_t> > small_features(small_partitions.size());
+      ::std::vector<ColumnSample> small_columns(small_partitions.size());
+      bool sampled{ false };
+      for (size_t i = 0; i < small_partitions.size(); i++)
+	sampled = node_columns(depth + 1, small_partitions[i], small_features[i], small_columns[i]) != nullptr;
+
+      auto small_splits = TreeBoosterNode::find_best_splits_hist(X, shelves, gh,
+								 small_views,
+								 small_partitions,
+								 TreeBooster::_weight_decay,
+								 TreeBooster::_reg_lambda,
+								 TreeBooster::_gamma,
+								 quantized(),
+								 sampled ? small_columns.data() : nullptr);
+
+      for (size_t i = 0; i < large_children.size(); i++) {
+	next_level[i].node->_split = small_splits[i];
+
+	// histogram caching
+	auto &large = large_children[i];
+	TreeBooster::histogram_subtraction(large.hist_view, small_views[i], large.hist_view);
+
+	::std::vector<uint8_t> large_features;
+	ColumnSample large_columns;
+	large.node->_split = TreeBoosterNode::find_best_split_hist(X, shelves, gh,
+								   true,
+								   large.hist_view,
+								   large.partition,
+								   TreeBooster::_weight_decay,
+								   TreeBooster::_reg_lambda,
+								   TreeBooster::_gamma,
+								   quantized(),
+								   true,
+								   node_columns(depth + 1, large.partition, large_features, large_columns));
+      }
+
+      next_level.insert(next_level.end(), large_children.begin(), large_children.end());
+      level = ::std::move(next_level);
+    }
+  }
+
+  template <typename MatrixT>
+  void XGTreeBooster::fit_leaf_wise(const MatrixT &X,
+				    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+				    GradientPair *gh,
+				    DataPartition &root_partition,
+				    const arena_view_t &root_hist_view) {
+    struct Leaf {
+      TreeBoosterNode *node;
+      DataPartition partition;
+      arena_view_t hist_view;
+      int depth;
+      size_t order;
+    };
+
+    auto lower_priority = [] (const Leaf &a, const Leaf &b) {
+      if (a.node->_split.best_gain != b.node->_split.best_gain)
+	return a.node->_split.best_gain < b.node->_split.best_gain;
+      return a.order > b.order;
+    };
+
+    ::std::priority_queue<Leaf, ::std::vector<Leaf>, decltype(lower_priority)> pending(lower_priority);
+    size_t n_queued{ 0 };
+
+    auto push = [&] (TreeBoosterNode *node, const DataPartition &partition, const arena_view_t &hist_view, int depth) {
+      if (depth < _max_depth && partition.end - partition.start >= _min_samples && node->_split.feature != -1)
+	pending.push({ node, partition, hist_view, depth, n_queued++ });
+    };
+
+    push(_root, root_partition, root_hist_view, 0);
+    int n_leaves{ 1 };
+
+    while (!pending.empty() && (_max_leaves == 0 || n_leaves < _max_leaves)) {
+      Leaf leaf = pending.top();
+      pending.pop();
+
+      TreeBoosterNode *node = leaf.node;
+      DataPartition &partition = leaf.partition;
+
+      size_t mid_point = TreeBooster::partition_data(X, gh,
+						    node->_split,
+						    shelves[node->_split.feature],
+						    partition,
+						    _quantized.pairs);
+
+      if (mid_point == partition.start || mid_point == partition.end)
+	continue;
+
+      DataPartition left_partition{ partition.global_idx_array, partition.start, mid_point };
+      DataPartition right_partition{ partition.global_idx_array, mid_point, partition.end };
+
+      auto *left_subtree = new TreeBoosterNode();
+      auto *right_subtree = new TreeBoosterNode();
+
+      auto values = ::std::move(node->_split.values);
+      left_subtree->_value = values.first;
+      right_subtree->_value = values.second;
+      left_subtree->_rows = mid_point - partition.start;
+      right_subtree->_rows = partition.end - mid_point;
+
+      node->_left = left_subtree;
+      node->_right = right_subtree;
+      n_leaves++;
+
+      // children that can not be split do not need histograms
+      if (leaf.depth + 1 >= _max_depth || (_max_leaves != 0 && n_leaves >= _max_leaves))
+	continue;
+
+      bool left_small = left_partition.end - left_partition.start <= right_partition.end - right_partition.start;
+      TreeBoosterNode *small = left_small ? left_subtree : right_subtree;
+      TreeBoosterNode *large = left_small ? right_subtree : left_subtree;
+      DataPartition &small_partition = left_small ? left_partition : right_partition;
+      DataPartition &large_partition = left_small ? right_partition : left_partition;
+
+      arena_view_t small_hist_view = TreeBooster::init_hist_view(_hist_bins);
+      arena_view_t large_hist_view = leaf.hist_view;
+
+      ::std::vector<uint8_t> small_features, large_features;
+      ColumnSample small_columns, large_columns;
+
+      small->_split = TreeBoosterNode::find_best_split_hist(X, shelves, gh,
+							    false,
+							    small_hist_view,
+							    small_partition,
+							    TreeBooster::_weight_decay,
+							    TreeBooster::_reg_lambda,
+							    TreeBooster::_gamma,
+							    quantized(),
+							    true,
+							    node_columns(leaf.depth + 1, small_partition, small_features, small_columns));
+
+      // histogram caching
+      TreeBooster::histogram_subtraction(leaf.hist_view,
+					 small_hist_view,
+					 large_hist_view);
+
+      large->_split = TreeBoosterNode::find_best_split_hist(X, shelves, gh,
+							    true,
+							    large_hist_view,
+							    large_partition,
+							    TreeBooster::_weight_decay,
+							    TreeBooster::_reg_lambda,
+							    TreeBooster::_gamma,
+							    quantized(),
+							    true,
+							    node_columns(leaf.depth + 1, large_partition, large_features, large_columns));
+
+      push(left_subtree, left_partition, left_small ? small_hist_view : large_hist_view, leaf.depth + 1);
+      push(right_subtree, right_partition, left_small ? large_hist_view : small_hist_view, leaf.depth + 1);
+    }
+  }
+
   
   void XGTreeBooster::fit_prep(const Matrix<double> &X,
 			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
-			       double *g,
-			       double *h,
+			       GradientPair *gh,
+			       DataPartition &partition) {
+    fit_node_greedy(X, gh, _root);
+  }
+
+  void XGTreeBooster::fit_prep(const Matrix<uint8_t> &X,
+			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			       GradientPair *gh,
+			       DataPartition &partition) {
+    fit_prep_hist(X, shelves, gh, partition);
+  }
+
+  void XGTreeBooster::fit_prep(const Matrix<uint16_t> &X,
+			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			       GradientPair *gh,
 			       DataPartition &partition) {
-    fit_node_greedy(X, g, h, _root);
+    fit_prep_hist(X, shelves, gh, partition);
   }
 
-  void XGTreeBooster::fit_prep(const Matrix<int> &X,
+  void XGTreeBooster::fit_prep(const SparseMatrix<uint8_t> &X,
 			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
-			       double *g,
-			       double *h,
+			       GradientPair *gh,
 			       DataPartition &partition) {
-    arena_view_t hist_view = TreeBooster::init_hist_view(X.get_rows());
+    fit_prep_hist(X, shelves, gh, partition);
+  }
+
+  void XGTreeBooster::fit_prep(const CNum::Data::BundledBins &X,
+			       std::shared_ptr<CNum::Data::Shelf[]> shelves,
+			       GradientPair *gh,
+			       DataPartition &partition) {
+    fit_prep_hist(X, shelves, gh, partition);
+  }
+
+  template <typename MatrixT>
+  void XGTreeBooster::fit_prep_hist(const MatrixT &X,
+				    std::shared_ptr<CNum::Data::Shelf[]> shelves,
+				    GradientPair *gh,
+				    DataPartition &partition) {
+    _hist_bins.resize(histogram_count(X));
+    for (size_t i = 0; i < _hist_bins.size(); i++)
+      _hist_bins[i] = histogram_bins(X, shelves.get(), i);
+
+    ::std::vector<size_t> feature_histograms(feature_count(X));
+    for (size_t f = 0; f < feature_histograms.size(); f++)
+      feature_histograms[f] = histogram_of(X, f);
+
+    TreeBooster::sample_tree_columns(feature_histograms, _hist_bins.size());
+
+    arena_view_t hist_view = TreeBooster::init_hist_view(_hist_bins);
+
+    ::std::vector<uint8_t> root_features;
+    ColumnSample root_columns;
     
     auto split = TreeBoosterNode::find_best_split_hist(X,
 						       shelves,
-						       g,
-						       h,
+						       gh,
 						       false,
 						       hist_view,
 						       partition,
 						       TreeBooster::_weight_decay,
 						       TreeBooster::_reg_lambda,
-						       TreeBooster::_gamma);
+						       TreeBooster::_gamma,
+						       quantized(),
+						       true,
+						       node_columns(0, partition, root_features, root_columns));
 
-    double gs = ::std::reduce(g + partition.start, g + partition.end);
-    double hs = ::std::reduce(h + partition.start, h + partition.end);
+    GradientPair sums = sum_gradients(gh, partition);
 	
     _root->_split = split;
-    _root->_value = -gs / (hs + TreeBooster::_reg_lambda);
+    _root->_value = -sums.g / (sums.h + TreeBooster::_reg_lambda);
+    _root->_rows = partition.end - partition.start;
     
-    fit_node_hist(X,
-		  shelves,
-		  g,
-		  h,
-		  partition,
-		  hist_view,
-		  _root);
+    if (_grow_policy == LEVEL_WISE) {
+      fit_level_wise(X, shelves, gh, partition, hist_view);
+      return;
+    }
+
+    if (_grow_policy == LEAF_WISE) {
+      fit_leaf_wise(X, shelves, gh, partition, hist_view);
+      return;
+    }
+
+    ::std::vector< ::std::future<void> > subtrees;
+    fit_node_hist_impl(X,
+		       shelves,
+		       gh,
+		       partition,
+		       hist_view,
+		       _root,
+		       0,
+		       TreeBooster::_arena,
+		       &subtrees);
     
+    // every task has to finish before an error is rethrown, they use the data
+    for (auto &t: subtrees)
+      t.wait();
+
+    for (auto &t: subtrees)
+      t.get();
   }
 
-  void XGTreeBooster::fit(DataMatrix &X,
+  void XGTreeBooster::fit(const DataMatrix &X,
 			  std::shared_ptr<CNum::Data::Shelf[]> shelves,
-			  double *g,
-			  double *h,
+			  GradientPair *gh,
 			  DataPartition &partition) {
-    ::std::visit([&, this] (auto &x) {
+    ::std::visit([&, this] (auto *x) {
       _root = new TreeBoosterNode();
-      fit_prep(x, shelves, g, h, partition);
+      fit_prep(*x, shelves, gh, partition);
     }, X);
   }
 };
@@ -1,5 +1,15 @@
 #include "CNum/Model/Loss.h"
 
+#include <limits>
+#include <vector>
+#include <future>
+#include <array>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define LOSS_AVX2
+#include <immintrin.h>
+#endif
+
 using namespace CNum::DataStructs;
 
 namespace CNum::Model::Loss {
@@ -27,6 +37,14 @@ namespace CNum::Model::Loss {
     return 1.0;
   }
 
+  void MSE_gradients_hessians(const double *y,
+			      const double *y_pred,
+			      GradientPair *gh_out,
+			      size_t n) {
+    for (size_t i = 0; i < n; i++)
+      gh_out[i] = { y_pred[i] - y[i], 1.0 };
+  }
+
   // -------------
   // RMSE
   // -------------
@@ -72,13 +90,110 @@ namespace CNum::Model::Loss {
     return sigmoid_output * (1 - sigmoid_output);
   }
  
+#ifdef LOSS_AVX2
+  /// @brief The Taylor coefficients of exp (1 / d!)
+  static constexpr auto exp_coefficients = [] {
+    ::std::array<double, 13> c{ 1.0 };
+    for (int d = 1; d < 13; d++)
+      c[d] = c[d - 1] / d;
+
+    return c;
+  }();
+
+  /// @brief exp of 4 values with AVX2 and FMA
+  ///
+  /// x is split into k ln 2 + r with |r| <= ln 2 / 2, exp(r) is a degree 12 Taylor
+  /// polynomial (relative error below 1e-15) and 2^k is written into the exponent
+  /// bits. x is clamped to [-708, 709] so 2^k stays a normal number
+  __attribute__((target("avx2,fma")))
+  static inline __m256d exp_avx2(__m256d x) {
+    x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(-708.0)), _mm256_set1_pd(709.0));
+
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)),
+				_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    // ln 2 in two parts so k ln 2 is exact
+    __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(6.93145751953125e-1), x);
+    r = _mm256_fnmadd_pd(k, _mm256_set1_pd(1.42860682030941723212e-6), r);
+
+    __m256d poly = _mm256_set1_pd(exp_coefficients[12]);
+    for (int d = 11; d >= 0; d--)
+      poly = _mm256_fmadd_pd(poly, r, _mm256_set1_pd(exp_coefficients[d]));
+
+    __m256i bits = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+    bits = _mm256_slli_epi64(_mm256_add_epi64(bits, _mm256_set1_epi64x(1023)), 52);
+
+    return _mm256_mul_pd(poly, _mm256_castsi256_pd(bits));
+  }
+
+  /// @brief Calculate the log loss gradients and hessians of 4 rows per iteration with
+  /// AVX2 and FMA
+  /// @return The number of rows that were calculated
+  __attribute__((target("avx2,fma")))
+  static size_t binary_crossentropy_avx2(const double *y,
+					 const double *y_pred,
+					 GradientPair *gh_out,
+					 size_t n) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    size_t i{ 0 };
+
+    for (; i + 4 <= n; i += 4) {
+      __m256d e = exp_avx2(_mm256_sub_pd(_mm256_setzero_pd(), _mm256_loadu_pd(y_pred + i)));
+      __m256d sigmoid_output = _mm256_div_pd(one, _mm256_add_pd(one, e));
+      __m256d g = _mm256_sub_pd(sigmoid_output, _mm256_loadu_pd(y + i));
+      __m256d h = _mm256_mul_pd(sigmoid_output, _mm256_sub_pd(one, sigmoid_output));
+
+      // interleave into GradientPair values: g0 h0 g1 h1, g2 h2 g3 h3
+      __m256d lo = _mm256_unpacklo_pd(g, h);
+      __m256d hi = _mm256_unpackhi_pd(g, h);
+      _mm256_storeu_pd((double *) (gh_out + i), _mm256_permute2f128_pd(lo, hi, 0x20));
+      _mm256_storeu_pd((double *) (gh_out + i + 2), _mm256_permute2f128_pd(lo, hi, 0x31));
+    }
+
+    return i;
+  }
+
+  /// @brief Whether or not the CPU supports AVX2 and FMA (checked once)
+  static bool cpu_has_avx2_fma() {
+    static const bool has_avx2_fma = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return has_avx2_fma;
+  }
+#endif
+
+  void binary_crossentropy_gradients_hessians(const double *y,
+					      const double *y_pred,
+					      GradientPair *gh_out,
+					      size_t n) {
+    size_t i{ 0 };
+
+#ifdef LOSS_AVX2
+    if (cpu_has_avx2_fma())
+      i = binary_crossentropy_avx2(y, y_pred, gh_out, n);
+#endif
+
+    // portable path, calls exp once per row (not vectorized)
+    for (; i < n; i++) {
+      double sigmoid_output = 1.0 / (1 + ::std::exp(-y_pred[i]));
+      gh_out[i] = { sigmoid_output - y[i], sigmoid_output * (1 - sigmoid_output) };
+    }
+  }
+
   void get_gradients_hessians(const Matrix<double> &y,
 				    const Matrix<double> &y_pred,
-				    arena_view_t &g_out,
-				    arena_view_t &h_out,
+				    arena_view_t &gh_out,
 				    const arena_view_t &position_array,
 				    GHFunction &grad_func,
 				    GHFunction &hess_func) {
+    get_gradients_hessians(y, y_pred, gh_out, position_array, LossProfile{ nullptr, grad_func, hess_func });
+  }
+
+  void get_gradients_hessians(const Matrix<double> &y,
+			      const Matrix<double> &y_pred,
+			      arena_view_t &gh_out,
+			      const arena_view_t &position_array,
+			      const LossProfile &loss_profile) {
+    constexpr size_t gather_rows = 512;
+    constexpr size_t min_block_rows = size_t{ 1 } << 16;
+
     if (y.get_rows() != y_pred.get_rows()) {
       throw ::std::invalid_argument("GH error - Misaligned dims");
     }
@@ -87,14 +202,193 @@ namespace CNum::Model::Loss {
       throw ::std::invalid_argument("GH error - Only 1 dimensional matrices supported");
     }
     
-    double *g_out_ptr = (double *) g_out.ptr;
-    double *h_out_ptr = (double *) h_out.ptr;
+    if (!loss_profile.gh_kernel && (!loss_profile.gradient_func || !loss_profile.hessian_func)) {
+      throw ::std::invalid_argument("GH error - The loss profile has no gradient and hessian functions");
+    }
+
+    GradientPair *gh_out_ptr = (GradientPair *) gh_out.ptr;
+    const size_t *indeces = (const size_t *) position_array.ptr;
+    const double *y_ptr = y.begin();
+    const double *y_pred_ptr = y_pred.begin();
+    size_t n_rows = gh_out.range;
+
+    // the rows are gathered once into contiguous blocks the kernel streams through
+    auto gh_block = [&] (size_t start, size_t end) {
+      double y_block[gather_rows];
+      double y_pred_block[gather_rows];
+
+      for (size_t s = start; s < end; s += gather_rows) {
+	size_t n = ::std::min(gather_rows, end - s);
+	for (size_t k = 0; k < n; k++) {
+	  y_block[k] = y_ptr[indeces[s + k]];
+	  y_pred_block[k] = y_pred_ptr[indeces[s + k]];
+	}
+
+	if (loss_profile.gh_kernel) {
+	  loss_profile.gh_kernel(y_block, y_pred_block, gh_out_ptr + s, n);
+	} else {
+	  for (size_t k = 0; k < n; k++)
+	    gh_out_ptr[s + k] = { loss_profile.gradient_func(y_block[k], y_pred_block[k]),
+				  loss_profile.hessian_func(y_block[k], y_pred_block[k]) };
+	}
+      }
+    };
+
+    auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+    size_t n_blocks = ::std::clamp(n_rows / min_block_rows, size_t{ 1 }, 2 * static_cast<size_t>(tp->get_num_threads()));
+    size_t block_rows = (n_rows + n_blocks - 1) / n_blocks;
+
+    ::std::vector< ::std::future<void> > blocks;
+    for (size_t b = 1; b < n_blocks; b++)
+      blocks.push_back(tp->submit< void >([&, b] (arena_t *arena) {
+	gh_block(b * block_rows, ::std::min(n_rows, (b + 1) * block_rows));
+      }));
+
+    gh_block(0, ::std::min(n_rows, block_rows));
+    for (auto &t: blocks)
+      t.get();
+  }
+
+  /// @brief A uniform value in [0, 1) from a seed and a position (splitmix64)
+  static double rounding_noise(uint64_t seed, uint64_t i) {
+    uint64_t z = seed + (i + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+
+    return (z >> 11) * 0x1.0p-53;
+  }
+
+  GradientPair quantize_gradients(arena_view_t &gh_out,
+				  arena_view_t &q_out,
+				  int levels,
+				  uint64_t seed) {
+    if (levels < 1 || levels > 127) {
+      throw ::std::invalid_argument("Quantize error - levels must be between 1 and 127");
+    }
+
+    if (q_out.range < gh_out.range) {
+      throw ::std::invalid_argument("Quantize error - Output is smaller than the input");
+    }
+
+    GradientPair *gh = (GradientPair *) gh_out.ptr;
+    QuantizedPair *q = (QuantizedPair *) q_out.ptr;
+
+    double g_max{ 0.0 }, h_max{ 0.0 };
+    for (size_t i = 0; i < gh_out.range; i++) {
+      g_max = ::std::max(g_max, ::std::abs(gh[i].g));
+      h_max = ::std::max(h_max, ::std::abs(gh[i].h));
+    }
+
+    GradientPair scale{ g_max > 0 ? g_max / levels : 1.0, h_max > 0 ? h_max / levels : 1.0 };
+
+    for (size_t i = 0; i < gh_out.range; i++) {
+      double g = ::std::floor(gh[i].g / scale.g + rounding_noise(seed, 2 * i));
+      double h = ::std::floor(gh[i].h / scale.h + rounding_noise(seed, 2 * i + 1));
+
+      q[i].g = static_cast<int8_t>(::std::clamp(g, -static_cast<double>(levels), static_cast<double>(levels)));
+      q[i].h = static_cast<int8_t>(::std::clamp(h, -static_cast<double>(levels), static_cast<double>(levels)));
+      gh[i] = { q[i].g * scale.g, q[i].h * scale.h };
+    }
+
+    return scale;
+  }
+
+  size_t goss_sample(arena_view_t &gh_out,
+		     arena_view_t &position_array,
+		     double top_rate,
+		     double other_rate,
+		     uint64_t seed) {
+    constexpr size_t min_block_rows = size_t{ 1 } << 16;
+
+    if (top_rate < 0 || other_rate < 0 || top_rate + other_rate > 1) {
+      throw ::std::invalid_argument("GOSS error - The rates must be non-negative and sum to at most 1");
+    }
+
+    GradientPair *gh = (GradientPair *) gh_out.ptr;
     size_t *indeces = (size_t *) position_array.ptr;
+    size_t n_rows = gh_out.range;
+    size_t n_top = ::std::min(n_rows, static_cast<size_t>(::std::ceil(top_rate * n_rows)));
+    size_t n_other = ::std::min(n_rows - n_top, static_cast<size_t>(other_rate * n_rows));
+
+    // the smallest magnitude in the top: each block keeps its n_top largest, and the
+    // n_top-th largest of those is the n_top-th largest of all the rows
+    double threshold = ::std::numeric_limits<double>::infinity();
+    if (n_top > 0) {
+      auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+      size_t n_blocks = ::std::clamp(n_rows / min_block_rows, size_t{ 1 }, 2 * static_cast<size_t>(tp->get_num_threads()));
+      size_t block_rows = (n_rows + n_blocks - 1) / n_blocks;
+
+      ::std::vector< ::std::vector<double> > candidates(n_blocks);
+      auto select_block = [&] (size_t b) {
+	size_t start = b * block_rows;
+	size_t end = ::std::min(n_rows, start + block_rows);
+	auto &c = candidates[b];
+
+	c.resize(end - start);
+	for (size_t i = start; i < end; i++)
+	  c[i - start] = ::std::abs(gh[i].g);
+
+	if (c.size() > n_top) {
+	  ::std::nth_element(c.begin(), c.begin() + n_top, c.end(), ::std::greater<double>());
+	  c.resize(n_top);
+	}
+      };
+
+      ::std::vector< ::std::future<void> > blocks;
+      for (size_t b = 1; b < n_blocks; b++)
+	blocks.push_back(tp->submit< void >([&, b] (arena_t *arena) { select_block(b); }));
+
+      select_block(0);
+      for (auto &t: blocks)
+	t.get();
 
-    for (size_t i = 0; i < g_out.range; i++) {
-      g_out_ptr[i] = grad_func(y.get(indeces[i], 0), y_pred.get(indeces[i], 0));
-      h_out_ptr[i] = hess_func(y.get(indeces[i], 0), y_pred.get(indeces[i], 0));
+      ::std::vector<double> merged;
+      for (auto &c: candidates)
+	merged.insert(merged.end(), c.begin(), c.end());
+
+      ::std::nth_element(merged.begin(), merged.begin() + (n_top - 1), merged.end(), ::std::greater<double>());
+      threshold = merged[n_top - 1];
     }
+
+    size_t n_above{ 0 };
+    for (size_t i = 0; i < n_rows; i++)
+      n_above += ::std::abs(gh[i].g) > threshold;
+
+    // the rest are sampled with Knuth's selection sampling, which keeps exactly n_other
+    double amplify = n_other > 0 ? static_cast<double>(n_rows - n_top) / n_other : 1.0;
+    size_t ties = n_top - n_above;
+    size_t rest = n_rows - n_top;
+    size_t needed = n_other;
+    size_t n_kept{ 0 };
+
+    for (size_t i = 0; i < n_rows; i++) {
+      double mag = ::std::abs(gh[i].g);
+      bool top = mag > threshold;
+      if (!top && mag == threshold && ties > 0) {
+	top = true;
+	ties--;
+      }
+
+      if (!top) {
+	bool sampled = needed > 0 && rounding_noise(seed, indeces[i]) * rest < needed;
+	rest--;
+	if (!sampled)
+	  continue;
+
+	needed--;
+	gh[i].g *= amplify;
+	gh[i].h *= amplify;
+      }
+
+      gh[n_kept] = gh[i];
+      indeces[n_kept] = indeces[i];
+      n_kept++;
+    }
+
+    gh_out.range = n_kept;
+    position_array.range = n_kept;
+    return n_kept;
   }
 
   double get_loss(const Matrix<double> &y,
@@ -113,11 +407,12 @@ namespace CNum::Model::Loss {
 
   LossProfile get_loss_profile(::std::string loss) {
     if (loss == "MSE")
-      return { MSE_loss, MSE_gradient, MSE_hessian };
+      return { MSE_loss, MSE_gradient, MSE_hessian, MSE_gradients_hessians };
     else if (loss == "RMSE")
-      return { RMSE_loss, MSE_gradient, MSE_hessian };
+      return { RMSE_loss, MSE_gradient, MSE_hessian, MSE_gradients_hessians };
     else if (loss == "BCE")
-      return { binary_crossentropy_loss, binary_crossentropy_gradient, binary_crossentropy_hessian };
+      return { binary_crossentropy_loss, binary_crossentropy_gradient, binary_crossentropy_hessian,
+	       binary_crossentropy_gradients_hessians };
     else
       throw ::std::invalid_argument("Get loss profile error - Loss function \"" + loss + "\" not found");
   }
@@ -51,4 +51,8 @@ namespace CNum::Multithreading {
   int ThreadPool::get_worker_id() {
     return _worker_id;
   }
+
+  int ThreadPool::get_num_threads() const {
+    return _num_threads;
+  }
 };
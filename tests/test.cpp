@@ -6,6 +6,12 @@
 #include <future>
 #include <thread>
 #include <chrono>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <cstring>
+#include <set>
 
 using namespace ::std::chrono_literals;
 
@@ -77,6 +83,1060 @@ TEST(GBModelSuite, DeterminismTest) {
   }
 }
 
+TEST(GBModelSuite, DatasetTest) {
+  CNum::Data::Dataset dataset(gb_suite_x, gb_suite_y);
+  ASSERT_EQ(dataset.get_rows(), gb_suite_len);
+  ASSERT_EQ(dataset.get_bins().get_rows(), dataset.get_cols());
+  ASSERT_EQ(dataset.get_bins().get_cols(), gb_suite_len);
+
+  // same trees whether the model bins the data itself or uses the Dataset
+  GBModel<XGTreeBooster> from_matrix("MSE", 20 /* n_learners */, .1 /* learning rate */, 1.0 /* subsample */);
+  from_matrix.fit(gb_suite_x, gb_suite_y, false);
+  auto expected = from_matrix.predict(gb_suite_x);
+
+  // models sharing the Dataset while training concurrently
+  constexpr int n_models = 3;
+  ::std::vector< GBModel<XGTreeBooster> > models;
+  for (int i = 0; i < n_models; i++)
+    models.emplace_back("MSE", 20 /* n_learners */, .1 /* learning rate */, 1.0 /* subsample */);
+
+  ::std::vector< ::std::thread > threads;
+  for (auto &model: models)
+    threads.emplace_back([&model, &dataset] { model.fit(dataset, false); });
+
+  for (auto &t: threads)
+    t.join();
+
+  for (auto &model: models) {
+    auto preds = model.predict(dataset.X());
+    for (size_t i = 0; i < gb_suite_len; i++)
+      ASSERT_EQ(preds[i], expected[i]);
+  }
+}
+
+TEST(GBModelSuite, MissingValueTest) {
+  constexpr size_t len = 200;
+  auto x = ::std::make_unique<double[]>(len);
+  auto y = ::std::make_unique<double[]>(len);
+
+  // the label of a missing value is unlike the labels of either side of any split
+  for (size_t i = 0; i < len; i++) {
+    x[i] = i % 4 == 0 ? NAN : static_cast<double>(i);
+    y[i] = i % 4 == 0 ? 5.0 : (i < len / 2 ? 0.0 : 1.0);
+  }
+
+  Matrix<double> X(len, 1, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  auto shelves = CNum::Data::quantile_bin(X, 256);
+  ASSERT_TRUE(shelves[0].has_missing);
+  auto bins = CNum::Data::apply_quantile(X, shelves);
+  for (size_t i = 0; i < len; i++) {
+    if (i % 4 == 0)
+      ASSERT_EQ(bins[i], shelves[0].missing_bin());
+    else
+      ASSERT_LT(bins[i], shelves[0].missing_bin());
+  }
+
+  GBModel<XGTreeBooster> xgboost("MSE", 100 /* n_learners */, .1 /* learning rate */, 1.0 /* subsample */);
+  xgboost.fit(X, Y, false);
+  xgboost.save_model("missing_suite.cmod");
+  auto loaded = GBModel<XGTreeBooster>::load_model("missing_suite.cmod");
+
+  auto preds = xgboost.predict(X);
+  auto loaded_preds = loaded.predict(X);
+  for (size_t i = 0; i < len; i++) {
+    ASSERT_NEAR(preds[i], Y[i], 0.5);
+    if (i % 4 == 0)
+      ASSERT_NEAR(preds[i], loaded_preds[i], 1e-4);
+  }
+}
+
+TEST(GBModelSuite, SparseTest) {
+  constexpr size_t len = 300;
+  constexpr size_t n_features = 4;
+  ::std::vector< Triplet<double> > triplets;
+  auto y = ::std::make_unique<double[]>(len);
+
+  // each feature is stored for a fifth of the rows
+  for (size_t i = 0; i < len; i++) {
+    for (size_t f = 0; f < n_features; f++) {
+      if ((i + f) % 5 == 0)
+	triplets.push_back({ i, f, static_cast<double>(i % 7 + 1) });
+    }
+
+    double x0 = i % 5 == 0 ? i % 7 + 1 : 0.0;
+    double x2 = (i + 2) % 5 == 0 ? i % 7 + 1 : 0.0;
+    y[i] = (x0 > 3.0 ? 1.0 : 0.0) + (x2 != 0.0 ? 2.0 : 0.0);
+  }
+
+  auto X_sparse = SparseMatrix<double>::from_triplets(len, n_features, triplets);
+  Matrix<double> X = X_sparse.to_dense();
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  GBModel<XGTreeBooster> sparse_model("MSE", 100 /* n_learners */, .1 /* learning rate */, 1.0 /* subsample */);
+  sparse_model.fit(X_sparse, Y, false);
+
+  GBModel<XGTreeBooster> dense_model("MSE", 100 /* n_learners */, .1 /* learning rate */, 1.0 /* subsample */);
+  dense_model.fit(X, Y, false);
+
+  auto sparse_preds = sparse_model.predict(X_sparse);
+  auto csc_preds = sparse_model.predict(X_sparse.to_format(CSC));
+  auto dense_preds = sparse_model.predict(X);
+  auto reference = dense_model.predict(X);
+
+  for (size_t i = 0; i < len; i++) {
+    ASSERT_NEAR(sparse_preds[i], Y[i], 0.1);
+    ASSERT_NEAR(sparse_preds[i], reference[i], 0.1);
+    ASSERT_DOUBLE_EQ(sparse_preds[i], dense_preds[i]);
+    ASSERT_DOUBLE_EQ(sparse_preds[i], csc_preds[i]);
+  }
+}
+
+TEST(GBModelSuite, FeatureBundlingTest) {
+  constexpr size_t len = 400;
+  constexpr size_t n_categories = 8;
+  constexpr size_t n_features = n_categories + 1;
+  auto x = ::std::make_unique<double[]>(len * n_features);
+  auto y = ::std::make_unique<double[]>(len);
+
+  // one-hot columns (mutually exclusive) next to a dense column
+  for (size_t i = 0; i < len; i++) {
+    size_t category = (i * 7) % n_categories;
+    x[i * n_features + category] = 1.0;
+    x[i * n_features + n_categories] = static_cast<double>(i % 13);
+    y[i] = static_cast<double>(category) + (i % 13 > 6 ? 0.5 : 0.0);
+  }
+
+  Matrix<double> X(len, n_features, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  CNum::Data::Dataset dataset(X, Y);
+  const CNum::Data::BundledBins *bundled = dataset.get_bundled();
+  ASSERT_NE(bundled, nullptr);
+  ASSERT_EQ(bundled->get_bundles(), 2);
+
+  const auto &bins = dataset.get_bins();
+  for (size_t f = 0; f < n_features; f++) {
+    for (size_t i = 0; i < len; i++)
+      ASSERT_EQ(bundled->get(f, i), bins.get(f, i));
+  }
+
+  // the sparse path builds a histogram per feature
+  GBModel<XGTreeBooster> bundled_model("MSE", 50 /* n_learners */, .1 /* learning rate */, 1.0 /* subsample */);
+  bundled_model.fit(dataset, false);
+
+  GBModel<XGTreeBooster> sparse_model("MSE", 50 /* n_learners */, .1 /* learning rate */, 1.0 /* subsample */);
+  sparse_model.fit(SparseMatrix<double>::from_dense(X), Y, false);
+
+  auto bundled_preds = bundled_model.predict(X);
+  auto reference = sparse_model.predict(X);
+  for (size_t i = 0; i < len; i++)
+    ASSERT_NEAR(bundled_preds[i], reference[i], 1e-9);
+}
+
+TEST(GBModelSuite, CategoricalTest) {
+  constexpr size_t len = 600;
+  constexpr size_t n_categories = 20;
+  auto x = ::std::make_unique<double[]>(len * 2);
+  auto y = ::std::make_unique<double[]>(len);
+
+  // the label only depends on whether the category is in a scattered set
+  auto in_set = [] (size_t c) { return c == 2 || c == 3 || c == 7 || c == 11 || c == 15; };
+  for (size_t i = 0; i < len; i++) {
+    size_t category = (i * 7) % n_categories;
+    x[i * 2] = static_cast<double>(category);
+    x[i * 2 + 1] = static_cast<double>(i % 10);
+    y[i] = in_set(category) ? 1.0 : 0.0;
+  }
+
+  Matrix<double> X(len, 2, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  auto shelves = CNum::Data::quantile_bin(X, 256, { 0 });
+  ASSERT_TRUE(shelves[0].is_categorical);
+  ASSERT_FALSE(shelves[1].is_categorical);
+  ASSERT_EQ(shelves[0].num_bins, n_categories + 1);
+  ASSERT_EQ(shelves[0].bin_of(7.0), 7);
+  ASSERT_EQ(shelves[0].bin_of(25.0), n_categories);
+
+  // one split per tree is enough to separate the set
+  GBModel<XGTreeBooster> xgboost("MSE", 50 /* n_learners */, .2 /* learning rate */, 1.0 /* subsample */, 1 /* max depth */);
+  xgboost.set_categorical_features({ 0 });
+  xgboost.fit(X, Y, false);
+  xgboost.save_model("categorical_suite.cmod");
+  auto loaded = GBModel<XGTreeBooster>::load_model("categorical_suite.cmod");
+
+  auto preds = xgboost.predict(X);
+  auto loaded_preds = loaded.predict(X);
+  for (size_t i = 0; i < len; i++) {
+    ASSERT_NEAR(preds[i], Y[i], 0.05);
+    ASSERT_NEAR(preds[i], loaded_preds[i], 1e-4);
+  }
+
+  ASSERT_THROW(CNum::Data::quantile_bin(X * -1.0, 256, { 0 }), ::std::invalid_argument);
+
+  // non-integer and out of range categories go right like unseen ones, both when
+  // predicting from the raw values and from the bins
+  constexpr size_t n_odd = 6;
+  auto x_odd = ::std::make_unique<double[]>(n_odd * 2);
+  double odd[n_odd] = { 2.5, 7.25, 1e20, ::std::numeric_limits<double>::infinity(), 3.0, 4.0 };
+  for (size_t i = 0; i < n_odd; i++) {
+    x_odd[i * 2] = odd[i];
+    x_odd[i * 2 + 1] = 1.0;
+  }
+
+  Matrix<double> X_odd(n_odd, 2, ::std::move(x_odd));
+  auto bins = CNum::Data::apply_quantile(X, shelves, true);
+  auto odd_bins = CNum::Data::apply_quantile(X_odd, shelves, true);
+  CNum::Multithreading::ThreadPool::get_thread_pool()->submit< void >([&] (arena_t *arena) {
+    ::std::vector<size_t> indeces(len);
+    ::std::vector<GradientPair> gh(len);
+    for (size_t i = 0; i < len; i++) {
+      indeces[i] = i;
+      gh[i] = { -Y[i], 1.0 };
+    }
+
+    XGTreeBooster tree(arena, 1 /* max depth */);
+    arena_view_t idx_view{ indeces.data(), len, sizeof(size_t) };
+    DataPartition partition{ &idx_view, 0, len };
+    tree.fit(DataMatrix(&bins), shelves, gh.data(), partition);
+
+    auto raw = tree.predict(X_odd);
+    ::std::vector<size_t> rows(n_odd);
+    ::std::iota(rows.begin(), rows.end(), size_t{ 0 });
+    ::std::vector<double> preds(n_odd);
+    tree.predict_bins(DataMatrix(&odd_bins), shelves, rows.data(), n_odd, preds.data());
+
+    for (size_t i = 0; i < n_odd; i++)
+      ASSERT_EQ(preds[i], raw[i]);
+
+    // 3 is in the set and 4 is not, the others go the way of an unseen category
+    ASSERT_NE(raw[4], raw[5]);
+    for (size_t i = 0; i < 4; i++)
+      ASSERT_EQ(raw[i], raw[5]);
+
+    arena_clear(arena);
+  }).get();
+}
+
+TEST(GBModelSuite, CategoricalLargeIdTest) {
+  constexpr size_t len = 400;
+  const double ids[4] = { 3.0, 1'000'000'000.0, 17.0, 2'000'000'000.0 };
+  auto x = ::std::make_unique<double[]>(len);
+  auto y = ::std::make_unique<double[]>(len);
+
+  // the large ids go left, the splits only hold as many categories as there are bins
+  for (size_t i = 0; i < len; i++) {
+    x[i] = ids[i % 4];
+    y[i] = i % 2 ? 1.0 : 0.0;
+  }
+
+  Matrix<double> X(len, 1, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  GBModel<XGTreeBooster> xgboost("MSE", 30 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 1 /* max depth */);
+  xgboost.set_categorical_features({ 0 });
+  xgboost.fit(X, Y, false);
+  xgboost.save_model("categorical_large_id_suite.cmod");
+  auto loaded = GBModel<XGTreeBooster>::load_model("categorical_large_id_suite.cmod");
+
+  // a bitset indexed by category would take 2e9 / 32 words per split
+  ::std::ifstream saved("categorical_large_id_suite.cmod", ::std::ios::ate);
+  ASSERT_LT(static_cast<size_t>(saved.tellg()), 100000);
+
+  auto preds = xgboost.predict(X);
+  auto loaded_preds = loaded.predict(X);
+  for (size_t i = 0; i < len; i++) {
+    ASSERT_NEAR(preds[i], Y[i], 0.05);
+    ASSERT_NEAR(preds[i], loaded_preds[i], 1e-4);
+  }
+
+  // an id next to a large one is unseen and goes right in every tree, like a
+  // non-integer value
+  auto unseen = Matrix<double>::init_const(1, 1, 1'000'000'001.0);
+  auto non_integer = Matrix<double>::init_const(1, 1, 1'000'000'000.5);
+  ASSERT_EQ(xgboost.predict(unseen)[0], xgboost.predict(non_integer)[0]);
+  ASSERT_NE(xgboost.predict(unseen)[0], preds[1]);
+}
+
+TEST(GBModelSuite, BinResolutionTest) {
+  constexpr size_t len = 200;
+  auto x = ::std::make_unique<double[]>(len * 2);
+  auto y = ::std::make_unique<double[]>(len);
+
+  for (size_t i = 0; i < len; i++) {
+    x[i * 2] = static_cast<double>(i);
+    x[i * 2 + 1] = static_cast<double>((i * 7) % 13);
+    y[i] = ::std::sin(i / 20.0) + x[i * 2 + 1] / 13.0;
+  }
+
+  Matrix<double> X(len, 2, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  // every distinct value gets a bin at both resolutions, so the two-byte bins build
+  // the same trees as the one-byte bins
+  auto wide_shelves = CNum::Data::quantile_bin(X, 1024);
+  ASSERT_EQ(wide_shelves[0].num_bins, len);
+  auto wide_bins = CNum::Data::apply_quantile<uint16_t>(X, wide_shelves);
+  for (size_t i = 0; i < len; i++)
+    ASSERT_EQ(wide_bins.get(i, 0), i);
+
+  GBModel<XGTreeBooster> narrow("MSE", 50 /* n_learners */, .1 /* learning rate */, 1.0 /* subsample */);
+  GBModel<XGTreeBooster> wide("MSE", 50 /* n_learners */, .1 /* learning rate */, 1.0 /* subsample */);
+  wide.set_num_bins(1024);
+  narrow.fit(X, Y, false);
+  wide.fit(X, Y, false);
+
+  auto narrow_preds = narrow.predict(X);
+  auto wide_preds = wide.predict(X);
+  for (size_t i = 0; i < len; i++)
+    ASSERT_EQ(narrow_preds[i], wide_preds[i]);
+
+  // a coarse resolution still trains
+  GBModel<XGTreeBooster> coarse("MSE", 50 /* n_learners */, .1 /* learning rate */, 1.0 /* subsample */);
+  coarse.set_num_bins(16);
+  ASSERT_LE(CNum::Data::quantile_bin(X, 16)[0].num_bins, 16);
+  coarse.fit(X, Y, false);
+  auto coarse_preds = coarse.predict(X);
+  for (size_t i = 0; i < len; i++)
+    ASSERT_NEAR(coarse_preds[i], Y[i], 0.5);
+
+  ASSERT_THROW(coarse.set_num_bins(1), ::std::invalid_argument);
+  ASSERT_THROW(wide.fit(SparseMatrix<double>::from_dense(X), Y, false), ::std::invalid_argument);
+}
+
+TEST(GBModelSuite, RowBlockTest) {
+  // enough rows for the histograms to be built in several row blocks
+  constexpr size_t len = 40000;
+  constexpr size_t n_features = 3;
+  auto x = ::std::make_unique<double[]>(len * n_features);
+  auto y = ::std::make_unique<double[]>(len);
+
+  for (size_t i = 0; i < len; i++) {
+    x[i * n_features] = static_cast<double>((i * 7919) % 1000);
+    x[i * n_features + 1] = i % 3 == 0 ? 0.0 : static_cast<double>(i % 17);
+    x[i * n_features + 2] = i % 5 == 0 ? NAN : static_cast<double>(i % 11);
+    y[i] = (x[i * n_features] < 500.0 ? 0.0 : 2.0) + x[i * n_features + 1] / 17.0;
+  }
+
+  Matrix<double> X(len, n_features, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  ::std::array< Matrix<double>, 2 > preds;
+  for (auto &p: preds) {
+    GBModel<XGTreeBooster> xgboost("MSE", 20 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */);
+    xgboost.fit(X, Y, false);
+    p = xgboost.predict(X);
+  }
+
+  GBModel<XGTreeBooster> sparse_model("MSE", 20 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */);
+  sparse_model.fit(SparseMatrix<double>::from_dense(X), Y, false);
+  auto sparse_preds = sparse_model.predict(X);
+
+  for (size_t i = 0; i < len; i++) {
+    ASSERT_EQ(preds[0][i], preds[1][i]);
+    ASSERT_NEAR(preds[0][i], Y[i], 0.1);
+    ASSERT_NEAR(sparse_preds[i], preds[0][i], 1e-6);
+  }
+}
+
+TEST(GBModelSuite, QuantizedGradientTest) {
+  // quantized values stay in range and are unbiased
+  constexpr size_t n = 10000;
+  ::std::vector<GradientPair> gh(n);
+  ::std::vector<QuantizedPair> q(n);
+  double g_sum{ 0.0 };
+  for (size_t i = 0; i < n; i++) {
+    gh[i] = { ::std::sin(i * 0.37), 1.0 + (i % 7) / 7.0 };
+    g_sum += gh[i].g;
+  }
+
+  arena_view_t gh_view{ gh.data(), n, sizeof(GradientPair) };
+  arena_view_t q_view{ q.data(), n, sizeof(QuantizedPair) };
+  GradientPair scale = CNum::Model::Loss::quantize_gradients(gh_view, q_view, 15, 0);
+
+  double q_sum{ 0.0 };
+  for (size_t i = 0; i < n; i++) {
+    ASSERT_LE(::std::abs(q[i].g), 15);
+    ASSERT_LE(::std::abs(q[i].h), 15);
+    ASSERT_EQ(gh[i].g, q[i].g * scale.g);
+    q_sum += gh[i].g;
+  }
+
+  ASSERT_NEAR(q_sum / n, g_sum / n, 0.01);
+  ASSERT_THROW(CNum::Model::Loss::quantize_gradients(gh_view, q_view, 128, 0), ::std::invalid_argument);
+
+  constexpr size_t len = 2000;
+  auto x = ::std::make_unique<double[]>(len * 2);
+  auto y = ::std::make_unique<double[]>(len);
+
+  for (size_t i = 0; i < len; i++) {
+    x[i * 2] = static_cast<double>((i * 7919) % 1000);
+    x[i * 2 + 1] = static_cast<double>(i % 13);
+    y[i] = (x[i * 2] < 500.0 ? 0.0 : 2.0) + x[i * 2 + 1] / 13.0;
+  }
+
+  Matrix<double> X(len, 2, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  GBModel<XGTreeBooster> baseline("MSE", 30 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */);
+  baseline.fit(X, Y, false);
+  auto baseline_preds = baseline.predict(X);
+
+  // quantized fits are reproducible and close to the baseline
+  ::std::array< Matrix<double>, 2 > preds;
+  for (auto &p: preds) {
+    GBModel<XGTreeBooster> quantized("MSE", 30 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */);
+    quantized.set_quantized_gradients(127);
+    quantized.fit(X, Y, false);
+    p = quantized.predict(X);
+  }
+
+  double baseline_mse{ 0.0 }, quantized_mse{ 0.0 };
+  for (size_t i = 0; i < len; i++) {
+    ASSERT_EQ(preds[0][i], preds[1][i]);
+    baseline_mse += (baseline_preds[i] - Y[i]) * (baseline_preds[i] - Y[i]) / len;
+    quantized_mse += (preds[0][i] - Y[i]) * (preds[0][i] - Y[i]) / len;
+  }
+
+  ASSERT_LT(quantized_mse, baseline_mse + 0.01);
+
+  GBModel<XGTreeBooster> model("MSE", 30 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */);
+  ASSERT_THROW(model.set_quantized_gradients(128), ::std::invalid_argument);
+}
+
+TEST(GBModelSuite, DeepTreeTest) {
+  // deep trees build their small subtrees as tasks, the trees must not depend on the
+  // order the tasks run in
+  constexpr size_t len = 20000;
+  constexpr size_t n_features = 4;
+  auto x = ::std::make_unique<double[]>(len * n_features);
+  auto y = ::std::make_unique<double[]>(len);
+
+  ::std::mt19937_64 rng(11);
+  ::std::uniform_real_distribution<double> dist(0.0, 1.0);
+  for (size_t i = 0; i < len; i++) {
+    for (size_t j = 0; j < n_features; j++)
+      x[i * n_features + j] = dist(rng);
+
+    y[i] = ::std::sin(x[i * n_features] * 6.0) + x[i * n_features + 1] * x[i * n_features + 2];
+  }
+
+  Matrix<double> X(len, n_features, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  ::std::array< Matrix<double>, 2 > preds;
+  for (auto &p: preds) {
+    GBModel<XGTreeBooster> xgboost("MSE", 10 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 12 /* max depth */);
+    xgboost.fit(X, Y, false);
+    p = xgboost.predict(X);
+  }
+
+  double mse{ 0.0 };
+  for (size_t i = 0; i < len; i++) {
+    ASSERT_EQ(preds[0][i], preds[1][i]);
+    mse += (preds[0][i] - Y[i]) * (preds[0][i] - Y[i]) / len;
+  }
+
+  ASSERT_LT(mse, 0.01);
+}
+
+TEST(GBModelSuite, LevelWiseTest) {
+  // nodes below one row block are built the same way under either policy, so the
+  // level-wise trees match the depth-first trees exactly
+  constexpr size_t len = 10000;
+  constexpr size_t n_features = 4;
+  auto x = ::std::make_unique<double[]>(len * n_features);
+  auto y = ::std::make_unique<double[]>(len);
+
+  ::std::mt19937_64 rng(5);
+  ::std::uniform_real_distribution<double> dist(0.0, 1.0);
+  for (size_t i = 0; i < len; i++) {
+    for (size_t j = 0; j < n_features; j++)
+      x[i * n_features + j] = j == 3 && dist(rng) < 0.7 ? 0.0 : dist(rng);
+
+    y[i] = ::std::sin(x[i * n_features] * 6.0) + x[i * n_features + 1] * x[i * n_features + 3];
+  }
+
+  Matrix<double> X(len, n_features, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+  auto X_sparse = SparseMatrix<double>::from_dense(X);
+
+  for (int levels: { 0, 127 }) {
+    ::std::array< Matrix<double>, 2 > dense_preds, sparse_preds;
+    for (auto policy: { DEPTH_FIRST, LEVEL_WISE }) {
+      GBModel<XGTreeBooster> dense("MSE", 10 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 8 /* max depth */);
+      dense.set_quantized_gradients(levels);
+      dense.set_grow_policy(policy);
+      dense.fit(X, Y, false);
+      dense_preds[policy] = dense.predict(X);
+
+      GBModel<XGTreeBooster> sparse("MSE", 10 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 8 /* max depth */);
+      sparse.set_quantized_gradients(levels);
+      sparse.set_grow_policy(policy);
+      sparse.fit(X_sparse, Y, false);
+      sparse_preds[policy] = sparse.predict(X_sparse);
+    }
+
+    for (size_t i = 0; i < len; i++) {
+      ASSERT_EQ(dense_preds[DEPTH_FIRST][i], dense_preds[LEVEL_WISE][i]);
+      ASSERT_EQ(sparse_preds[DEPTH_FIRST][i], sparse_preds[LEVEL_WISE][i]);
+    }
+  }
+}
+
+TEST(GBModelSuite, LeafWiseTest) {
+  constexpr size_t len = 10000;
+  constexpr size_t n_features = 4;
+  constexpr int max_leaves = 16;
+  auto x = ::std::make_unique<double[]>(len * n_features);
+  auto y = ::std::make_unique<double[]>(len);
+
+  ::std::mt19937_64 rng(13);
+  ::std::uniform_real_distribution<double> dist(0.0, 1.0);
+  for (size_t i = 0; i < len; i++) {
+    for (size_t j = 0; j < n_features; j++)
+      x[i * n_features + j] = dist(rng);
+
+    // most of the signal is in a narrow region of the first feature
+    y[i] = (x[i * n_features] > 0.8 ? ::std::sin(x[i * n_features + 1] * 12.0) * 3.0 : 0.0) + x[i * n_features + 2] * 0.1;
+  }
+
+  Matrix<double> X(len, n_features, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  auto train_mse = [&] (GBModel<XGTreeBooster> &model) {
+    model.fit(X, Y, false);
+    auto preds = model.predict(X);
+
+    double mse{ 0.0 };
+    for (size_t i = 0; i < len; i++)
+      mse += (preds[i] - Y[i]) * (preds[i] - Y[i]) / len;
+
+    return mse;
+  };
+
+  // without a leaf budget the leaf-wise trees are the depth-first trees
+  GBModel<XGTreeBooster> depth_first("MSE", 10 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 6 /* max depth */);
+  GBModel<XGTreeBooster> unlimited("MSE", 10 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 6 /* max depth */);
+  unlimited.set_grow_policy(LEAF_WISE);
+  ASSERT_EQ(train_mse(depth_first), train_mse(unlimited));
+
+  // a leaf budget spent best-first beats a balanced tree with as many leaves
+  GBModel<XGTreeBooster> balanced("MSE", 20 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 4 /* max depth */);
+  GBModel<XGTreeBooster> leaf_wise("MSE", 20 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 12 /* max depth */);
+  leaf_wise.set_grow_policy(LEAF_WISE);
+  leaf_wise.set_max_leaves(max_leaves);
+  double balanced_mse = train_mse(balanced);
+  ASSERT_LT(train_mse(leaf_wise), balanced_mse);
+
+  // every learner stays within the budget (each leaf saves an empty left child)
+  leaf_wise.save_model("leaf_wise_suite.cmod");
+  ::std::ifstream in("leaf_wise_suite.cmod");
+  ::std::string saved((::std::istreambuf_iterator<char>(in)), ::std::istreambuf_iterator<char>());
+  size_t n_leaves{ 0 };
+  for (size_t pos = saved.find("\"left\":{}"); pos != ::std::string::npos; pos = saved.find("\"left\":{}", pos + 1))
+    n_leaves++;
+
+  ASSERT_GT(n_leaves, 0);
+  ASSERT_LE(n_leaves, 20 * max_leaves);
+
+  ASSERT_THROW(leaf_wise.set_max_leaves(1), ::std::invalid_argument);
+}
+
+TEST(GBModelSuite, PartitionTest) {
+  // large enough to be partitioned in parallel blocks
+  constexpr size_t len = 200000;
+  auto x = ::std::make_unique<double[]>(len);
+  for (size_t i = 0; i < len; i++)
+    x[i] = static_cast<double>((i * 7919) % 1000);
+
+  Matrix<double> X(len, 1, ::std::move(x));
+  auto shelves = CNum::Data::quantile_bin(X, 256);
+  auto bins = CNum::Data::apply_quantile(X, shelves, true);
+
+  Split split{ 0, 0.0, 0.0, 100, { 0.0, 0.0 }, false };
+  auto left = XGTreeBooster::left_bins(split, shelves[0]);
+
+  // the parallel and serial partitions are the same stable partition
+  for (bool parallel: { true, false }) {
+    ::std::vector<size_t> indeces(len);
+    ::std::vector<GradientPair> gh(len);
+    ::std::vector<QuantizedPair> q(len);
+    for (size_t i = 0; i < len; i++) {
+      indeces[i] = len - 1 - i;
+      gh[i] = { static_cast<double>(indeces[i]), 1.0 };
+      q[i] = { static_cast<int8_t>(indeces[i] % 100), 1 };
+    }
+
+    arena_view_t idx_view{ indeces.data(), len, sizeof(size_t) };
+    DataPartition partition{ &idx_view, 10, len - 10 };
+    size_t mid = XGTreeBooster::partition_data(bins, gh.data(), split, shelves[0], partition, q.data(), parallel);
+
+    ASSERT_EQ(indeces[0], len - 1);
+    ASSERT_EQ(indeces[len - 1], 0);
+    for (size_t k = partition.start; k < partition.end; k++) {
+      ASSERT_EQ(static_cast<bool>(left[bins.get_row_view(0)[indeces[k]]]), k < mid);
+      ASSERT_EQ(gh[k].g, static_cast<double>(indeces[k]));
+      ASSERT_EQ(q[k].g, static_cast<int8_t>(indeces[k] % 100));
+
+      // rows keep their order on each side
+      if (k + 1 < partition.end && k + 1 != mid)
+	ASSERT_GT(indeces[k], indeces[k + 1]);
+    }
+  }
+}
+
+TEST(GBModelSuite, LeafValuesTest) {
+  constexpr size_t len = 40000;
+  constexpr size_t n_features = 4;
+  auto x = ::std::make_unique<double[]>(len * n_features);
+  ::std::vector<GradientPair> targets(len);
+
+  ::std::mt19937_64 rng(29);
+  ::std::uniform_real_distribution<double> dist(0.0, 1.0);
+  for (size_t i = 0; i < len; i++) {
+    for (size_t j = 0; j < n_features; j++)
+      x[i * n_features + j] = dist(rng);
+
+    // missing values exercise the default directions
+    double y = ::std::sin(x[i * n_features] * 6.0) + x[i * n_features + 1] * x[i * n_features + 2];
+    if (i % 7 == 0)
+      x[i * n_features + 1] = ::std::numeric_limits<double>::quiet_NaN();
+
+    targets[i] = { -y, 1.0 };
+  }
+
+  Matrix<double> X(len, n_features, ::std::move(x));
+  auto shelves = CNum::Data::quantile_bin(X, 256);
+  auto bins = CNum::Data::apply_quantile(X, shelves, true);
+  auto *tp = CNum::Multithreading::ThreadPool::get_thread_pool();
+
+  // the fit's rows get their leaf's value and the other rows are predicted from their
+  // bins, both the same as predicting from the raw values
+  for (GrowPolicy policy: { DEPTH_FIRST, LEVEL_WISE, LEAF_WISE }) {
+    tp->submit< void >([&] (arena_t *arena) {
+      ::std::vector<size_t> indeces, others;
+      ::std::vector<GradientPair> gh;
+      for (size_t i = 0; i < len; i++) {
+	if (i % 3 == 0) {
+	  others.push_back(i);
+	} else {
+	  indeces.push_back(i);
+	  gh.push_back(targets[i]);
+	}
+      }
+
+      XGTreeBooster tree(arena, 8 /* max depth */);
+      tree.set_grow_policy(policy);
+      tree.set_max_leaves(policy == LEAF_WISE ? 40 : 0);
+
+      arena_view_t idx_view{ indeces.data(), indeces.size(), sizeof(size_t) };
+      DataPartition partition{ &idx_view, 0, indeces.size() };
+      tree.fit(DataMatrix(&bins), shelves, gh.data(), partition);
+      auto raw = tree.predict(X);
+
+      ::std::vector<double> values(indeces.size());
+      tree.leaf_values(values.data());
+      for (size_t k = 0; k < indeces.size(); k++)
+	ASSERT_EQ(values[k], raw[indeces[k]]);
+
+      ::std::vector<double> preds(others.size());
+      tree.predict_bins(DataMatrix(&bins), shelves, others.data(), others.size(), preds.data());
+      for (size_t k = 0; k < others.size(); k++)
+	ASSERT_EQ(preds[k], raw[others[k]]);
+
+      arena_clear(arena);
+    }).get();
+  }
+}
+
+TEST(GBModelSuite, CompactSubsampleTest) {
+  constexpr size_t len = 20000;
+  constexpr size_t n_features = 3;
+  auto x = ::std::make_unique<double[]>(len * n_features);
+  auto y = ::std::make_unique<double[]>(len);
+
+  ::std::mt19937_64 rng(17);
+  ::std::uniform_real_distribution<double> dist(0.0, 1.0);
+  for (size_t i = 0; i < len; i++) {
+    for (size_t j = 0; j < n_features; j++)
+      x[i * n_features + j] = dist(rng);
+
+    y[i] = ::std::sin(x[i * n_features] * 6.0) + x[i * n_features + 1];
+  }
+
+  Matrix<double> X(len, n_features, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  // a subsample in row order visits the rows in the same order either way, so the
+  // compact trees are the same as the trees trained on the whole dataset's bins
+  SubsampleFunction strided = [] (size_t *pos_ptr, size_t low, size_t high, size_t n_samples, const Matrix<double> y) {
+    for (size_t k = 0; k < n_samples; k++)
+      pos_ptr[k] = low + k * (high - low) / n_samples;
+  };
+
+  for (size_t num_bins: { 256, 1024 }) {
+    ::std::array< Matrix<double>, 2 > preds;
+    for (bool compact: { false, true }) {
+      GBModel<XGTreeBooster> xgboost("MSE", 20, .3, .3 /* subsample */, 5, 3, HIST, "", 0.0, 1.0, 0.0, strided);
+      xgboost.set_num_bins(num_bins);
+      xgboost.set_compact_subsample(compact);
+      xgboost.fit(X, Y, false);
+      preds[compact] = xgboost.predict(X);
+    }
+
+    for (size_t i = 0; i < len; i++)
+      ASSERT_EQ(preds[0][i], preds[1][i]);
+  }
+
+  // the rows are gathered feature by feature
+  auto shelves = CNum::Data::quantile_bin(X, 256);
+  auto bins = CNum::Data::apply_quantile(X, shelves, true);
+  ::std::vector<size_t> rows{ 3, 17, 17, 19999, 0 };
+  Matrix<uint8_t> gathered;
+  CNum::Data::gather_bins(bins, rows.data(), rows.size(), gathered);
+
+  ASSERT_EQ(gathered.get_rows(), n_features);
+  ASSERT_EQ(gathered.get_cols(), rows.size());
+  for (size_t f = 0; f < n_features; f++) {
+    for (size_t k = 0; k < rows.size(); k++)
+      ASSERT_EQ(gathered.get_row_view(f)[k], bins.get_row_view(f)[rows[k]]);
+  }
+}
+
+TEST(GBModelSuite, GradientKernelTest) {
+  // enough rows for the gradients to be computed in parallel blocks
+  constexpr size_t n = 200000;
+  auto y_data = ::std::make_unique<double[]>(n);
+  auto pred_data = ::std::make_unique<double[]>(n);
+  ::std::vector<size_t> rows(n);
+  for (size_t i = 0; i < n; i++) {
+    pred_data[i] = static_cast<double>((i * 7919) % 2001) / 100.0 - 10.0;
+    y_data[i] = (i * 31) % 3 == 0 ? 1.0 : 0.0;
+    rows[i] = (i * 104729) % n;
+  }
+
+  Matrix<double> y(n, 1, ::std::move(y_data));
+  Matrix<double> y_pred(n, 1, ::std::move(pred_data));
+  arena_view_t rows_view{ rows.data(), n, sizeof(size_t) };
+
+  auto gradients = [&] (const CNum::Model::Loss::LossProfile &profile) {
+    ::std::vector<GradientPair> gh(n);
+    arena_view_t gh_view{ gh.data(), n, sizeof(GradientPair) };
+    CNum::Model::Loss::get_gradients_hessians(y, y_pred, gh_view, rows_view, profile);
+    return gh;
+  };
+
+  // the batch kernels match the scalar functions on every row
+  for (auto loss: { "MSE", "BCE" }) {
+    auto profile = CNum::Model::Loss::get_loss_profile(loss);
+    auto batch = gradients(profile);
+    for (size_t i = 0; i < n; i++) {
+      double y_i = y.get(rows[i], 0), pred_i = y_pred.get(rows[i], 0);
+      ASSERT_NEAR(batch[i].g, profile.gradient_func(y_i, pred_i), 1e-12);
+      ASSERT_NEAR(batch[i].h, profile.hessian_func(y_i, pred_i), 1e-12);
+    }
+  }
+
+  // the log loss kernel stays accurate where the sigmoid saturates
+  const double extremes[8] = { -800.0, -40.0, -1e-3, 0.0, 1e-3, 3.7, 40.0, 800.0 };
+  const double labels[8] = { 0.0, 1.0, 0.0, 1.0, 1.0, 0.0, 1.0, 0.0 };
+  GradientPair extreme_gh[8];
+  CNum::Model::Loss::binary_crossentropy_gradients_hessians(labels, extremes, extreme_gh, 8);
+  for (size_t i = 0; i < 8; i++) {
+    double sigmoid_output = 1.0 / (1 + ::std::exp(-extremes[i]));
+    ASSERT_NEAR(extreme_gh[i].g, sigmoid_output - labels[i], 1e-15);
+    ASSERT_NEAR(extreme_gh[i].h, sigmoid_output * (1 - sigmoid_output), 1e-15);
+  }
+
+  // a custom loss without a kernel falls back to its gradient and hessian functions,
+  // and a custom kernel is used when one is given
+  CNum::Model::Loss::LossProfile custom{ CNum::Model::Loss::MSE_loss,
+					 [] (double t, double p) { return 2.0 * (p - t); },
+					 [] (double t, double p) { return 2.0; } };
+  auto scalar = gradients(custom);
+  custom.gh_kernel = [] (const double *t, const double *p, GradientPair *out, size_t m) {
+    for (size_t k = 0; k < m; k++)
+      out[k] = { 2.0 * (p[k] - t[k]), 2.0 };
+  };
+  auto batch = gradients(custom);
+
+  for (size_t i = 0; i < n; i++) {
+    ASSERT_EQ(scalar[i].g, 2.0 * (y_pred.get(rows[i], 0) - y.get(rows[i], 0)));
+    ASSERT_EQ(scalar[i].h, 2.0);
+    ASSERT_EQ(batch[i].g, scalar[i].g);
+    ASSERT_EQ(batch[i].h, scalar[i].h);
+  }
+
+  ASSERT_THROW(gradients(CNum::Model::Loss::LossProfile{ CNum::Model::Loss::MSE_loss }), ::std::invalid_argument);
+}
+
+TEST(GBModelSuite, GOSSTest) {
+  // many rows share magnitudes so the ties at the threshold are split by row
+  constexpr size_t n = 200000;
+  ::std::vector<GradientPair> gh(n);
+  ::std::vector<size_t> rows(n);
+  for (size_t i = 0; i < n; i++) {
+    gh[i] = { (i % 2 ? 1.0 : -1.0) * static_cast<double>((i * 7919) % 1000), 1.0 };
+    rows[i] = i;
+  }
+
+  auto original = gh;
+  ::std::array< ::std::vector<size_t>, 2 > kept;
+  for (auto &k: kept) {
+    auto gh_copy = original;
+    auto rows_copy = rows;
+    arena_view_t gh_view{ gh_copy.data(), n, sizeof(GradientPair) };
+    arena_view_t rows_view{ rows_copy.data(), n, sizeof(size_t) };
+
+    // every magnitude in [0, 1000) is on 200 rows, the top 40100 are the rows of 800
+    // and up and the first 100 rows of 799
+    size_t n_kept = CNum::Model::Loss::goss_sample(gh_view, rows_view, .2005, .1, 3);
+    ASSERT_EQ(n_kept, 40100 + 20000);
+    ASSERT_EQ(gh_view.range, n_kept);
+
+    double amplify = 159900.0 / 20000;
+    size_t n_top{ 0 }, n_tied{ 0 };
+    for (size_t i = 0; i < n_kept; i++) {
+      double mag = ::std::abs(original[rows_copy[i]].g);
+      if (i > 0)
+	ASSERT_LT(rows_copy[i - 1], rows_copy[i]);
+
+      if (mag >= 800.0 || (mag == 799.0 && n_tied++ < 100)) {
+	ASSERT_EQ(gh_copy[i].g, original[rows_copy[i]].g);
+	n_top++;
+      } else {
+	ASSERT_EQ(gh_copy[i].g, original[rows_copy[i]].g * amplify);
+	ASSERT_EQ(gh_copy[i].h, amplify);
+      }
+    }
+
+    ASSERT_EQ(n_top, 40100);
+    k.assign(rows_copy.begin(), rows_copy.begin() + n_kept);
+  }
+
+  ASSERT_EQ(kept[0], kept[1]);
+
+  constexpr size_t len = 20000;
+  auto x = ::std::make_unique<double[]>(len * 2);
+  auto y = ::std::make_unique<double[]>(len);
+
+  ::std::mt19937_64 rng(19);
+  ::std::uniform_real_distribution<double> dist(0.0, 1.0);
+  for (size_t i = 0; i < len; i++) {
+    x[i * 2] = dist(rng);
+    x[i * 2 + 1] = dist(rng);
+    y[i] = ::std::sin(x[i * 2] * 6.0) + x[i * 2 + 1];
+  }
+
+  Matrix<double> X(len, 2, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  GBModel<XGTreeBooster> xgboost("MSE", 50 /* n_learners */, .2 /* learning rate */, 1.0 /* subsample */);
+  xgboost.set_goss(.2, .1);
+  xgboost.set_compact_subsample(true);
+  xgboost.fit(X, Y, false);
+  auto preds = xgboost.predict(X);
+
+  double mse{ 0.0 };
+  for (size_t i = 0; i < len; i++)
+    mse += (preds[i] - Y[i]) * (preds[i] - Y[i]) / len;
+
+  ASSERT_LT(mse, 0.01);
+  ASSERT_THROW(xgboost.set_goss(.6, .5), ::std::invalid_argument);
+  ASSERT_THROW(xgboost.set_goss(-.1, .5), ::std::invalid_argument);
+}
+
+TEST(GBModelSuite, ColsampleTest) {
+  constexpr size_t len = 5000;
+  constexpr size_t n_features = 8;
+  auto x = ::std::make_unique<double[]>(len * n_features);
+  auto y = ::std::make_unique<double[]>(len);
+
+  ::std::mt19937_64 rng(23);
+  ::std::uniform_real_distribution<double> dist(0.0, 1.0);
+  for (size_t i = 0; i < len; i++) {
+    y[i] = 0.0;
+    for (size_t f = 0; f < n_features; f++) {
+      x[i * n_features + f] = dist(rng);
+      y[i] += (f + 1) * x[i * n_features + f];
+    }
+  }
+
+  Matrix<double> X(len, n_features, ::std::move(x));
+  Matrix<double> Y(len, 1, ::std::move(y));
+
+  auto fit_predict = [&] (GBModel<XGTreeBooster> &model) {
+    CNum::Utils::Rand::RandomGenerator::set_global_seed(42);
+    model.fit(X, Y, false);
+    return model.predict(X);
+  };
+
+  // rates of 1 sample every feature
+  GBModel<XGTreeBooster> plain("MSE", 10 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 5 /* max depth */);
+  GBModel<XGTreeBooster> full("MSE", 10 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 5 /* max depth */);
+  full.set_colsample(1.0, 1.0, 1.0);
+  auto plain_preds = fit_predict(plain);
+  auto full_preds = fit_predict(full);
+  for (size_t i = 0; i < len; i++)
+    ASSERT_EQ(plain_preds[i], full_preds[i]);
+
+  // a tree only splits on its sampled features
+  GBModel<XGTreeBooster> by_tree("MSE", 1 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 6 /* max depth */);
+  by_tree.set_colsample(.25);
+  fit_predict(by_tree);
+  by_tree.save_model("colsample_suite.cmod");
+
+  ::std::ifstream in("colsample_suite.cmod");
+  ::std::string saved((::std::istreambuf_iterator<char>(in)), ::std::istreambuf_iterator<char>());
+  ::std::set<int> split_features;
+  for (size_t pos = saved.find("\"feature\":"); pos != ::std::string::npos; pos = saved.find("\"feature\":", pos + 1)) {
+    int feature = ::std::stoi(saved.substr(pos + 10));
+    if (feature >= 0)
+      split_features.insert(feature);
+  }
+
+  ASSERT_FALSE(split_features.empty());
+  ASSERT_LE(split_features.size(), 2);
+
+  // the samples only depend on the seed, the depth, and the node, so the grow policies
+  // still give the same trees
+  GBModel<XGTreeBooster> depth_first("MSE", 10 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 5 /* max depth */);
+  GBModel<XGTreeBooster> level_wise("MSE", 10 /* n_learners */, .3 /* learning rate */, 1.0 /* subsample */, 5 /* max depth */);
+  depth_first.set_colsample(.75, .75, .5);
+  level_wise.set_colsample(.75, .75, .5);
+  level_wise.set_grow_policy(LEVEL_WISE);
+
+  auto depth_first_preds = fit_predict(depth_first);
+  auto level_wise_preds = fit_predict(level_wise);
+  auto repeat_preds = fit_predict(depth_first);
+
+  double mse{ 0.0 };
+  for (size_t i = 0; i < len; i++) {
+    ASSERT_EQ(depth_first_preds[i], level_wise_preds[i]);
+    ASSERT_EQ(depth_first_preds[i], repeat_preds[i]);
+    mse += (depth_first_preds[i] - Y[i]) * (depth_first_preds[i] - Y[i]) / len;
+  }
+
+  // the labels have a variance of about 17
+  ASSERT_LT(mse, 2.0);
+  ASSERT_THROW(depth_first.set_colsample(0.0), ::std::invalid_argument);
+  ASSERT_THROW(depth_first.set_colsample(1.0, 1.5), ::std::invalid_argument);
+}
+
+TEST(GBModelSuite, EarlyStoppingTest) {
+  constexpr size_t len = 4000;
+  constexpr size_t n_features = 3;
+
+  // noisy labels so deep trees start overfitting after a few learners
+  ::std::mt19937_64 rng(31);
+  ::std::uniform_real_distribution<double> dist(0.0, 1.0);
+  ::std::normal_distribution<double> noise(0.0, 0.5);
+  auto make_data = [&] () {
+    auto x = ::std::make_unique<double[]>(len * n_features);
+    auto y = ::std::make_unique<double[]>(len);
+    for (size_t i = 0; i < len; i++) {
+      for (size_t j = 0; j < n_features; j++)
+	x[i * n_features + j] = dist(rng);
+
+      y[i] = ::std::sin(x[i * n_features] * 6.0) + noise(rng);
+    }
+
+    return ::std::make_pair(Matrix<double>(len, n_features, ::std::move(x)), Matrix<double>(len, 1, ::std::move(y)));
+  };
+
+  auto [X, Y] = make_data();
+  auto [X_val, Y_val] = make_data();
+
+  auto eval_mse = [&] (GBModel<XGTreeBooster> &model) {
+    auto preds = model.predict(X_val);
+    double mse{ 0.0 };
+    for (size_t i = 0; i < len; i++)
+      mse += (preds[i] - Y_val[i]) * (preds[i] - Y_val[i]) / len;
+
+    return mse;
+  };
+
+  CNum::Utils::Rand::RandomGenerator::set_global_seed(8);
+  GBModel<XGTreeBooster> full("MSE", 100 /* n_learners */, .5 /* learning rate */, 1.0 /* subsample */, 8 /* max depth */);
+  full.fit(X, Y, false);
+  ASSERT_EQ(full.get_best_iteration(), -1);
+
+  CNum::Utils::Rand::RandomGenerator::set_global_seed(8);
+  GBModel<XGTreeBooster> stopped("MSE", 100 /* n_learners */, .5 /* learning rate */, 1.0 /* subsample */, 8 /* max depth */);
+  stopped.fit(X, Y, X_val, Y_val, 5, false);
+
+  int best = stopped.get_best_iteration();
+  ASSERT_GE(best, 0);
+  ASSERT_LT(best, 50);
+  ASSERT_LT(eval_mse(stopped), eval_mse(full));
+
+  // the model keeps the learners up to the best one, the same as a model with that
+  // many learners
+  CNum::Utils::Rand::RandomGenerator::set_global_seed(8);
+  GBModel<XGTreeBooster> truncated("MSE", best + 1, .5 /* learning rate */, 1.0 /* subsample */, 8 /* max depth */);
+  truncated.fit(X, Y, false);
+
+  auto stopped_preds = stopped.predict(X_val);
+  auto truncated_preds = truncated.predict(X_val);
+  for (size_t i = 0; i < len; i++)
+    ASSERT_EQ(stopped_preds[i], truncated_preds[i]);
+
+  stopped.save_model("early_stopping_suite.cmod");
+  auto loaded = GBModel<XGTreeBooster>::load_model("early_stopping_suite.cmod");
+  auto loaded_preds = loaded.predict(X_val);
+  for (size_t i = 0; i < len; i++)
+    ASSERT_NEAR(stopped_preds[i], loaded_preds[i], 1e-4);
+
+  ASSERT_THROW(stopped.fit(X, Y, X_val, Y_val, 0, false), ::std::invalid_argument);
+  ASSERT_THROW(stopped.fit(X, Y, Y_val, Y_val, 5, false), ::std::invalid_argument);
+}
+
+TEST(SplitScanSuite, ReferenceTest) {
+  ::std::mt19937_64 rng(7);
+  ::std::normal_distribution<double> g_dist(0.0, 1.0);
+  ::std::uniform_real_distribution<double> h_dist(0.0, 2.0);
+
+  // sizes around the vector width and the chunk size, with empty bins, missing values,
+  // and constraints that mask some of the thresholds
+  for (int n_bins: { 1, 2, 3, 5, 8, 17, 255, 256, 257, 600 }) {
+    for (int trial = 0; trial < 20; trial++) {
+      ::std::vector<GradientPair> bins(n_bins);
+      GradientPair sums{ 0.0, 0.0 };
+      for (auto &b: bins) {
+	b = rng() % 4 == 0 ? GradientPair{ 0.0, 0.0 } : GradientPair{ g_dist(rng), h_dist(rng) };
+	sums.g += b.g;
+	sums.h += b.h;
+      }
+
+      GradientPair missing{ g_dist(rng), h_dist(rng) };
+      const GradientPair *missing_ptr = trial % 2 ? &missing : nullptr;
+      if (missing_ptr != nullptr) {
+	sums.g += missing.g;
+	sums.h += missing.h;
+      }
+
+      double weight_decay = trial % 3 == 0 ? 0.0 : sums.h / 4;
+      double gamma = trial % 4 == 0 ? 0.0 : 0.5;
+
+      auto expected = scan_bins_reference(bins.data(), n_bins, sums, missing_ptr, weight_decay, 1.0, gamma);
+      auto actual = scan_bins(bins.data(), n_bins, sums, missing_ptr, weight_decay, 1.0, gamma);
+
+      ASSERT_EQ(actual.bin, expected.bin);
+      ASSERT_EQ(actual.missing_left, expected.missing_left);
+      ASSERT_EQ(::std::memcmp(&actual.gain, &expected.gain, sizeof(double)), 0);
+      ASSERT_EQ(::std::memcmp(&actual.left, &expected.left, sizeof(GradientPair)), 0);
+    }
+  }
+
+  // the first of equal gains wins
+  ::std::vector<GradientPair> bins{ { 1.0, 1.0 }, { -2.0, 2.0 }, { 1.0, 1.0 } };
+  auto tie = scan_bins(bins.data(), 3, { 0.0, 4.0 }, nullptr, 0.0, 1.0, 0.0);
+  ASSERT_EQ(tie.bin, 0);
+}
+
 TEST(BinaryMask, AllNegativeTest) {
   auto mask = mask_suite_1d == 0.0001;
   auto m2 = mask_suite_1d[mask];
@@ -160,6 +1220,243 @@ TEST(IndexMask, 2dMatrixTest) {
   }
 }
 
+TEST(DataSuite, ReadCSVTest) {
+  {
+    ::std::ofstream of("data_suite.csv");
+    of << "label,a,b\n"
+       << "1,0.5,-2\r\n"
+       << "\n"
+       << "0, 1e3 ,NA\n"
+       << "1,0.1234567890123,+7";
+  }
+
+  CNum::Data::CSVOptions options;
+  options.header_rows = 1;
+  options.label_col = 0;
+  options.chunk_bytes = 8; // force several chunks
+  auto [X, y] = CNum::Data::read_csv("data_suite.csv", options);
+
+  ASSERT_EQ(X.get_rows(), 3);
+  ASSERT_EQ(X.get_cols(), 2);
+  ASSERT_EQ(y.get_rows(), 3);
+
+  ASSERT_EQ(y[0], 1);
+  ASSERT_EQ(y[1], 0);
+  ASSERT_EQ(X.get(0, 0), 0.5);
+  ASSERT_EQ(X.get(0, 1), -2);
+  ASSERT_EQ(X.get(1, 0), 1000);
+  ASSERT_TRUE(::std::isnan(X.get(1, 1)));
+  ASSERT_EQ(X.get(2, 0), 0.1234567890123); // parsed as double, not float
+  ASSERT_EQ(X.get(2, 1), 7);
+
+  {
+    ::std::ofstream of("data_suite.csv");
+    of << "1,2,3\n4,5\n";
+  }
+
+  ASSERT_THROW(CNum::Data::get_data("data_suite.csv"), ::std::runtime_error);
+}
+
+TEST(DataSuite, DataReaderTest) {
+  CNum::Data::write_binary("data_suite.cbin", gb_suite_x, gb_suite_y);
+  auto [X, y] = CNum::Data::read_binary("data_suite.cbin");
+  ASSERT_EQ(X.get_rows(), gb_suite_len);
+  ASSERT_EQ(y[gb_suite_len - 1], gb_suite_y[gb_suite_len - 1]);
+
+  {
+    ::std::ofstream of("data_suite.csv");
+    for (size_t i = 0; i < gb_suite_len; i++)
+      of << gb_suite_x[i] << "," << gb_suite_y[i] << "\n";
+  }
+
+  constexpr size_t batch_rows = 30;
+  for (auto format: { CNum::Data::CSV, CNum::Data::BINARY }) {
+    CNum::Data::DataReader reader(format == CNum::Data::CSV ? "data_suite.csv" : "data_suite.cbin",
+				  batch_rows,
+				  format);
+    for (int pass = 0; pass < 2; pass++) {
+      size_t rows_seen{ 0 };
+      while (reader.next()) {
+	ASSERT_EQ(reader.batch_start(), rows_seen);
+	ASSERT_EQ(reader.X().get_rows(), ::std::min(batch_rows, gb_suite_len - rows_seen));
+
+	for (size_t i = 0; i < reader.X().get_rows(); i++) {
+	  ASSERT_EQ(reader.X().get(i, 0), gb_suite_x[rows_seen + i]);
+	  ASSERT_EQ(reader.y()[i], gb_suite_y[rows_seen + i]);
+	}
+	rows_seen += reader.X().get_rows();
+      }
+
+      ASSERT_EQ(rows_seen, gb_suite_len);
+      reader.rewind();
+    }
+  }
+
+  GBModel<XGTreeBooster> xgboost("MSE", 10 /* n_learners */);
+  xgboost.fit(gb_suite_x, gb_suite_y, false);
+
+  CNum::Data::DataReader reader("data_suite.cbin", batch_rows, CNum::Data::BINARY);
+  auto streamed_preds = xgboost.predict(reader);
+  auto preds = xgboost.predict(gb_suite_x);
+
+  ASSERT_EQ(streamed_preds.get_rows(), gb_suite_len);
+  for (size_t i = 0; i < gb_suite_len; i++) {
+    ASSERT_EQ(streamed_preds[i], preds[i]);
+  }
+}
+
+TEST(DataSuite, QuantileSketchTest) {
+  constexpr size_t n = 300000;
+  constexpr size_t n_parts = 3;
+  ::std::mt19937_64 rng(7);
+  ::std::lognormal_distribution<double> dist(0.0, 2.0);
+
+  ::std::vector<double> vals(n);
+  for (auto &v: vals)
+    v = dist(rng);
+
+  // one sketch vs sketches of parts of the data merged together
+  CNum::Data::QuantileSketch whole;
+  whole.insert(vals.data(), n);
+
+  CNum::Data::QuantileSketch merged(2048, 1);
+  for (size_t p = 0; p < n_parts; p++) {
+    CNum::Data::QuantileSketch part(2048, p + 2);
+    part.insert(vals.data() + p * (n / n_parts), n / n_parts);
+    merged.merge(part);
+  }
+
+  ASSERT_EQ(whole.count(), n);
+  ASSERT_EQ(merged.count(), n);
+
+  ::std::vector<double> sorted(vals);
+  ::std::sort(sorted.begin(), sorted.end());
+
+  ::std::vector<double> qs;
+  for (int q = 1; q < 256; q++)
+    qs.push_back(q / 256.0);
+
+  for (auto *sketch: { &whole, &merged }) {
+    auto boundaries = sketch->quantiles(qs);
+    ASSERT_EQ(boundaries.size(), qs.size());
+
+    for (size_t i = 0; i < qs.size(); i++) {
+      double rank = static_cast<double>(::std::lower_bound(sorted.begin(), sorted.end(), boundaries[i]) - sorted.begin()) / n;
+      ASSERT_NEAR(rank, qs[i], 0.005);
+    }
+  }
+
+  // exact below the sketch size, NaN is ignored
+  CNum::Data::QuantileSketch small;
+  for (double v: ::std::vector<double>{ 5.0, NAN, 1.0, 4.0, 2.0, 3.0 })
+    small.insert(v);
+
+  ASSERT_EQ(small.count(), 5);
+  auto exact = small.quantiles({ 0.0, 0.2, 0.5, 0.99, 1.0 });
+  ASSERT_EQ(exact, ::std::vector<double>({ 1.0, 2.0, 3.0, 5.0, 5.0 }));
+
+  // streamed and in-memory binning agree
+  CNum::Data::write_binary("sketch_suite.cbin", gb_suite_x, gb_suite_y);
+  CNum::Data::DataReader reader("sketch_suite.cbin", 30, CNum::Data::BINARY);
+  auto streamed_shelves = CNum::Data::quantile_bin(reader, 256);
+  auto shelves = CNum::Data::quantile_bin(gb_suite_x, 256);
+
+  ASSERT_EQ(streamed_shelves[0].num_bins, shelves[0].num_bins);
+  for (size_t i = 0; i < shelves[0].num_boundaries(); i++)
+    ASSERT_EQ(streamed_shelves[0].ranges[i], shelves[0].ranges[i]);
+
+  // a feature only gets as many bins as it has distinct values
+  auto low_cardinality = CNum::DataStructs::Matrix<double>::init_const(100, 1, 0.0);
+  for (size_t i = 0; i < 100; i += 2)
+    low_cardinality.begin()[i] = 1.0;
+
+  auto low_cardinality_shelves = CNum::Data::quantile_bin(low_cardinality, 256);
+  ASSERT_EQ(low_cardinality_shelves[0].num_bins, 2);
+  ASSERT_EQ(low_cardinality_shelves[0].ranges[0], 1.0);
+}
+
+TEST(BucketizeSuite, BinarySearchTest) {
+  // duplicate boundaries, +-inf and NaN values
+  ::std::vector<double> boundaries{ -2.0, -1.0, -1.0, 0.0, 0.5, 0.5, 0.5, 3.0, 10.0 };
+  ::std::vector<double> vals{ -5.0, -2.0, -1.5, -1.0, 0.0, 0.25, 0.5, 2.9, 3.0, 9.99, 10.0, 1e9,
+			      INFINITY, -INFINITY, NAN, 0.75, -1.0, 3.0, 0.5 };
+
+  CNum::Data::Bucketizer bucketizer(boundaries.data(), boundaries.size());
+  ASSERT_EQ(bucketizer.get_n_bins(), boundaries.size() + 1);
+
+  auto expected = [&] (double val) -> size_t {
+    if (::std::isnan(val))
+      return 0;
+    return ::std::upper_bound(boundaries.begin(), boundaries.end(), val) - boundaries.begin();
+  };
+
+  // strided input and output, sizes that cover the batch path and the tail
+  ::std::vector<double> strided(vals.size() * 3);
+  for (size_t i = 0; i < vals.size(); i++)
+    strided[i * 3] = vals[i];
+
+  ::std::vector<uint8_t> out(vals.size() * 2);
+  bucketizer.bucketize(strided.data(), vals.size(), 3, out.data(), 2);
+
+  for (size_t i = 0; i < vals.size(); i++) {
+    ASSERT_EQ(bucketizer.bucketize(vals[i]), expected(vals[i]));
+    ASSERT_EQ(out[i * 2], expected(vals[i]));
+  }
+
+  ::std::vector<int> contiguous(vals.size());
+  bucketizer.bucketize(vals.data(), vals.size(), 1, contiguous.data(), 1);
+  for (size_t i = 0; i < vals.size(); i++)
+    ASSERT_EQ(contiguous[i], expected(vals[i]));
+
+  // NaN values in a separate missing bin
+  CNum::Data::Bucketizer missing_bucketizer(boundaries.data(), boundaries.size(), 255);
+  missing_bucketizer.bucketize(vals.data(), vals.size(), 1, contiguous.data(), 1);
+  for (size_t i = 0; i < vals.size(); i++)
+    ASSERT_EQ(contiguous[i], ::std::isnan(vals[i]) ? 255 : expected(vals[i]));
+
+  auto shelves = CNum::Data::quantile_bin(gb_suite_x, 256);
+  auto binned = CNum::Data::apply_quantile(gb_suite_x, shelves);
+  for (size_t i = 0; i < gb_suite_len; i++) {
+    size_t b = ::std::upper_bound(shelves[0].ranges.get(),
+				  shelves[0].ranges.get() + shelves[0].num_boundaries(),
+				  gb_suite_x[i]) - shelves[0].ranges.get();
+    ASSERT_EQ(binned.get(i, 0), b);
+  }
+}
+
+TEST(SparseMatrixSuite, ConversionTest) {
+  // out of order with a duplicate (summed) entry
+  ::std::vector< Triplet<double> > triplets{ { 2, 1, 4.0 },
+					     { 0, 2, 1.0 },
+					     { 0, 0, 2.0 },
+					     { 2, 1, 1.0 },
+					     { 1, 2, 3.0 } };
+  auto csr = SparseMatrix<double>::from_triplets(3, 3, triplets);
+  ASSERT_EQ(csr.get_nnz(), 4);
+  ASSERT_EQ(csr.get(2, 1), 5.0);
+  ASSERT_EQ(csr.get(1, 1), 0.0);
+
+  auto dense = csr.to_dense();
+  auto csc = SparseMatrix<double>::from_dense(dense, CSC);
+  ASSERT_EQ(csc.get_nnz(), 4);
+  ASSERT_EQ(csc.get_col_view(2).nnz, 2);
+  ASSERT_THROW(csc.get_row_view(0), ::std::logic_error);
+
+  auto back = csc.to_format(CSR);
+  ASSERT_EQ(back.get_outer(), csr.get_outer());
+  ASSERT_EQ(back.get_inner(), csr.get_inner());
+  ASSERT_EQ(back.get_vals(), csr.get_vals());
+
+  auto v = Matrix<double>::init_const(3, 1, 2.0);
+  auto sparse_prod = csr * v;
+  auto csc_prod = csc * v;
+  ::std::vector<double> expected{ 6.0, 6.0, 10.0 };
+  for (size_t i = 0; i < 3; i++) {
+    ASSERT_EQ(sparse_prod[i], expected[i]);
+    ASSERT_EQ(csc_prod[i], expected[i]);
+  }
+}
+
 TEST(ThreadPoolSuite, SimpleThreadPoolTest) {
   ::std::atomic<int> ctr{ 0 };
   std::function< void(arena_t *) > task = [&ctr] (arena_t *arena) { ctr++; };